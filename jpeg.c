@@ -370,11 +370,12 @@ int jpeg_read_dri(const u8 *buf,
 	*offset += header_len;
 	offset_work += JPEG_MARKER_SIZE_LENGTH;
 
-	rheader->restart_interval = (buf[offset_work] << 8) |
-				    (buf[offset_work + 1]);
-	rheader->f_l_restart_count = JPEG_DRI_F_DEFAULT |
-				     JPEG_DRI_L_DEFAULT |
-				     JPEG_DRI_RCOUNT_DEFAULT;
+	/* restart header is sent as is, in network byte order */
+	rheader->restart_interval = htons((buf[offset_work] << 8) |
+					  (buf[offset_work + 1]));
+	rheader->f_l_restart_count = htons(JPEG_DRI_F_DEFAULT |
+					   JPEG_DRI_L_DEFAULT |
+					   JPEG_DRI_RCOUNT_DEFAULT);
 
 	return 0;
 }
@@ -547,7 +548,7 @@ u32 jpeg_make_header(enum MJPEG_TYPE type,
 	*p++ = w;			/* wudth lsb */
 	*p++ = JPEG_COMP_NUM;		/* number of components */
 	*p++ = JPEG_SOF_COMP_ID_Y + 1;		/* comp 0 */
-	if (type == MJPEG_TYPE_422)
+	if ((type & ~MJPEG_TYPE_RESTART_BIT) == MJPEG_TYPE_422)
 		*p++ = JPEG_SOF_COMP_SAMPLE_2X1; /* hsamp = 2, vsamp = 1 */
 	else
 		*p++ = JPEG_SOF_COMP_SAMPLE_2X2; /* hsamp = 2, vsamp = 2 */
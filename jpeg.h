@@ -62,6 +62,8 @@
 #ifndef __JPEG_H__
 #define __JPEG_H__
 
+#include <linux/string.h>
+
 #define JPEG_MARKER               (0xFF)
 #define JPEG_MARKER_SIZE_LENGTH   (2)
 
@@ -84,8 +86,8 @@
 #define JPEG_DQT_QUANT_SIZE8      (64)
 #define JPEG_DQT_QUANT_SIZE16     (128)
 #define JPEG_DRI_LENGTH           (4)
-#define JPEG_DRI_F_DEFAULT        (0x80)
-#define JPEG_DRI_L_DEFAULT        (0x40)
+#define JPEG_DRI_F_DEFAULT        (0x8000)
+#define JPEG_DRI_L_DEFAULT        (0x4000)
 #define JPEG_DRI_RCOUNT_DEFAULT   (0x3FFF)
 
 #define JPEG_GET_DQT_PREC(__data) (((__data) & 0xF0) >> 4)
@@ -144,19 +146,27 @@ struct mjpeg_component {
 	u8 qt;
 };
 
+/*
+ * Find the next marker with memchr() instead of a byte loop, entropy
+ * coded data is long and 0xFF is rare in it. On success *offset points
+ * just after the marker kind, otherwise it is set to len.
+ */
 static inline u8 jpeg_get_marker(const u8 *buf, size_t len, size_t *offset)
 {
-	u8 marker;
-
-	while ((buf[(*offset)++] != JPEG_MARKER) && (*offset < len))
-		;
+	const u8 *p;
 
 	if (*offset >= len)
 		return JPEG_MARKER_KIND_NIL;
 
-	marker = buf[(*offset)++];
+	p = memchr(buf + *offset, JPEG_MARKER, len - *offset);
+	if (!p || p + 1 >= buf + len) {
+		*offset = len;
+		return JPEG_MARKER_KIND_NIL;
+	}
+
+	*offset = p - buf + JPEG_MARKER_SIZE_LENGTH;
 
-	return marker;
+	return p[1];
 }
 
 static inline size_t jpeg_search_eoi(const u8 *buf, size_t len,
@@ -171,6 +181,44 @@ static inline size_t jpeg_search_eoi(const u8 *buf, size_t len,
 	return offset;
 }
 
+/*
+ * Find the end of SOS header and EOI in one walk. Marker segments are
+ * skipped by their length up to SOS only when buf starts a frame, then
+ * the entropy coded data is searched for EOI. header_len is 0 if SOS is
+ * not found and eoi_offset is len if EOI is not found.
+ */
+static inline void jpeg_scan_markers(const u8 *buf, size_t len,
+				     bool frame_start,
+				     struct mse_jpeg_markers *markers)
+{
+	size_t offset = 0;
+
+	markers->header_len = 0;
+
+	while (frame_start && offset < len && !markers->header_len) {
+		switch (jpeg_get_marker(buf, len, &offset)) {
+		case JPEG_MARKER_KIND_NIL:
+		case JPEG_MARKER_KIND_SOI:
+			break;
+
+		case JPEG_MARKER_KIND_EOI:
+			markers->eoi_offset = offset;
+			return;
+
+		case JPEG_MARKER_KIND_SOS:
+			offset += JPEG_GET_HEADER_SIZE(buf, offset);
+			markers->header_len = offset;
+			break;
+
+		default:
+			offset += JPEG_GET_HEADER_SIZE(buf, offset);
+			break;
+		}
+	}
+
+	markers->eoi_offset = jpeg_search_eoi(buf, len, min(offset, len));
+}
+
 int jpeg_read_sof(const u8 *buf,
 		  size_t len,
 		  size_t *offset,
@@ -83,6 +83,7 @@ struct mse_adapter_eavb {
 	int num_entry;
 	int entried, unentry;
 	int num_send;
+	int num_reaped;
 	struct ravb_streaming_kernel_if ravb;
 	enum AVB_DEVNAME device_id;
 	struct eavb_rxparam rxparam;
@@ -396,12 +397,33 @@ static int mse_adapter_eavb_set_streamid(int index, u8 streamid[8])
 	return 0;
 }
 
+static void mse_adapter_eavb_set_entry(struct eavb_entry *entry,
+				       struct mse_packet *packet)
+{
+	int i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(entry->vec) < MSE_PACKET_VEC_MAX + 1);
+
+	entry->vec[0].len = packet->len;
+
+	/* zero length vector terminates the entry */
+	for (i = 0; i < MSE_PACKET_VEC_MAX; i++) {
+		if (i < packet->num_vec) {
+			entry->vec[i + 1].base = packet->vec[i].paddr;
+			entry->vec[i + 1].len = packet->vec[i].len;
+		} else {
+			entry->vec[i + 1].len = 0;
+		}
+	}
+}
+
 static int mse_adapter_eavb_send_prepare(int index,
 					 struct mse_packet *packets,
 					 int num_packets)
 {
 	int i;
 	struct mse_adapter_eavb *eavb;
+	struct eavb_entry *entry;
 
 	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
 
@@ -429,12 +451,14 @@ static int mse_adapter_eavb_send_prepare(int index,
 		return -EINVAL;
 	}
 
-	eavb->entry = kcalloc(num_packets,
-			      sizeof(struct eavb_entry),
-			      GFP_KERNEL);
-	if (!eavb->entry)
+	entry = kcalloc(num_packets, sizeof(struct eavb_entry), GFP_KERNEL);
+	if (!entry)
 		return -ENOMEM;
 
+	/* packet buffer may be reallocated while stream is not started */
+	kfree(eavb->entry);
+	eavb->entry = entry;
+
 	for (i = 0; i < num_packets; i++) {
 		(eavb->entry + i)->seq_no = i;
 		(eavb->entry + i)->vec[0].base = packets[i].paddr;
@@ -444,6 +468,7 @@ static int mse_adapter_eavb_send_prepare(int index,
 	eavb->entried = 0;
 	eavb->unentry = 0;
 	eavb->num_send = 0;
+	eavb->num_reaped = 0;
 	eavb->num_entry = num_packets;
 
 	return 0;
@@ -503,18 +528,19 @@ static int mse_adapter_eavb_send(int index,
 		}
 		eavb->unentry = (eavb->unentry + rret) % eavb->num_entry;
 		eavb->num_send -= rret;
+		eavb->num_reaped += rret;
 	}
 
-	/* update packet size */
+	/* update packet size and payload vectors */
 	for (i = 0; i < num_packets; i++) {
-		ofs = (eavb->unentry + i) % eavb->num_entry;
-		(eavb->entry + ofs)->vec[0].len = packets[ofs].len;
+		ofs = (eavb->entried + i) % eavb->num_entry;
+		mse_adapter_eavb_set_entry(eavb->entry + ofs, &packets[ofs]);
 	}
 
-	/* enqueue */
-	if (eavb->unentry + num_packets <= eavb->num_entry) {
+	/* enqueue after entries in flight */
+	if (eavb->entried + num_packets <= eavb->num_entry) {
 		wret = eavb->ravb.write(eavb->ravb.handle,
-					eavb->entry + eavb->unentry,
+					eavb->entry + eavb->entried,
 					num_packets);
 		if (wret < 0) {
 			mse_err("write error %zd\n", wret);
@@ -522,8 +548,8 @@ static int mse_adapter_eavb_send(int index,
 		}
 	} else {
 		wret = eavb->ravb.write(eavb->ravb.handle,
-					eavb->entry + eavb->unentry,
-					eavb->num_entry - eavb->unentry);
+					eavb->entry + eavb->entried,
+					eavb->num_entry - eavb->entried);
 		if (wret < 0) {
 			mse_err("write error %zd\n", wret);
 			return wret;
@@ -531,7 +557,7 @@ static int mse_adapter_eavb_send(int index,
 		wret2 = eavb->ravb.write(
 				eavb->ravb.handle,
 				eavb->entry,
-				num_packets - eavb->num_entry + eavb->unentry);
+				num_packets - eavb->num_entry + eavb->entried);
 		if (wret2 >= 0)
 			wret += wret2;
 		else
@@ -547,27 +573,54 @@ static int mse_adapter_eavb_send(int index,
 	eavb->entried = (eavb->entried + wret) % eavb->num_entry;
 	eavb->num_send += wret;
 
-	/* dequeue */
-	if (wret > 0) {
-		rret = eavb->ravb.read(eavb->ravb.handle, eavb->read_entry,
-				       wret);
-		if (rret != wret) {
-			avb_print_entrynum(eavb);
+	/* entries in flight are dequeued by reap when completed */
+	mse_debug("read %zd write %zd\n", rret, wret);
 
-			if (rret < 0) {
-				mse_err("read error %zd\n", rret);
-				return rret;
-			}
-			mse_err("read is short %zd/%zd\n",
-				rret, wret);
+	return wret;
+}
+
+static int mse_adapter_eavb_reap(int index)
+{
+	int completed, num_reaped;
+	ssize_t rret;
+	struct mse_adapter_eavb *eavb;
+
+	eavb = mse_adapter_eavb_get_priv(index);
+	if (!eavb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (eavb->num_send > 0) {
+		completed = avb_check_completed(eavb);
+		if (completed < 0)
+			return completed;
+
+		completed = min(completed, eavb->num_send);
+	} else {
+		completed = 0;
+	}
+
+	/* dequeue, it does not block on completed entries */
+	if (completed > 0) {
+		rret = eavb->ravb.read(eavb->ravb.handle, eavb->read_entry,
+				       completed);
+		if (rret < 0) {
+			mse_err("read error %zd\n", rret);
+			return rret;
 		}
 		eavb->unentry = (eavb->unentry + rret) % eavb->num_entry;
 		eavb->num_send -= rret;
+		eavb->num_reaped += rret;
 	}
 
-	mse_debug("read %zd write %zd\n", rret, wret);
+	num_reaped = eavb->num_reaped;
+	eavb->num_reaped = 0;
 
-	return wret;
+	mse_debug("index=%d reaped=%d in flight=%d\n",
+		  index, num_reaped, eavb->num_send);
+
+	return num_reaped;
 }
 
 static int mse_adapter_eavb_receive_prepare(int index,
@@ -575,7 +628,7 @@ static int mse_adapter_eavb_receive_prepare(int index,
 					    int num_packets)
 {
 	struct mse_adapter_eavb *eavb;
-	int i;
+	int i, num_post;
 	ssize_t ret;
 
 	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
@@ -618,23 +671,24 @@ static int mse_adapter_eavb_receive_prepare(int index,
 		(eavb->entry + i)->vec[0].len = packets[i].len;
 	}
 
-	/* entry queue */
+	/* entry queue, packet buffer may be shallower than entry max */
+	num_post = min(num_packets, MSE_EAVB_ADAPTER_ENTRY_MAX);
 	eavb->entried = 0;
 	ret = eavb->ravb.write(eavb->ravb.handle,
 			       eavb->entry,
-			       MSE_EAVB_ADAPTER_ENTRY_MAX);
-	if (ret != MSE_EAVB_ADAPTER_ENTRY_MAX) {
+			       num_post);
+	if (ret != num_post) {
 		avb_print_entrynum(eavb);
 		if (ret < 0)
 			mse_err("write error %zd\n", ret);
 		else
 			mse_err("write is short %zd/%d\n",
-				ret, MSE_EAVB_ADAPTER_ENTRY_MAX);
+				ret, num_post);
 
 		return -EAGAIN;
 	}
 
-	eavb->unentry = MSE_EAVB_ADAPTER_ENTRY_MAX;
+	eavb->unentry = num_post;
 	eavb->num_entry = num_packets;
 
 	return 0;
@@ -770,10 +824,13 @@ static struct mse_adapter_network_ops mse_adapter_eavb_ops = {
 	.set_streamid = mse_adapter_eavb_set_streamid,
 	.send_prepare = mse_adapter_eavb_send_prepare,
 	.send = mse_adapter_eavb_send,
+	.reap = mse_adapter_eavb_reap,
 	.receive_prepare = mse_adapter_eavb_receive_prepare,
 	.receive = mse_adapter_eavb_receive,
 	.cancel = mse_adapter_eavb_cancel,
 	.get_link_speed = mse_adapter_eavb_get_link_speed,
+	.max_packets = MSE_EAVB_ADAPTER_PACKET_MAX,
+	.max_burst = MSE_EAVB_ADAPTER_ENTRY_MAX,
 };
 
 static int __init mse_adapter_eavb_init(void)
@@ -0,0 +1,632 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include "ravb_mse_kernel.h"
+
+#define MSE_LOOPBACK_ADAPTER_MAX (10)
+#define MSE_LOOPBACK_LINK_MAX    (4)
+
+/* frames in flight on a link, must be power of 2 */
+#define MSE_LOOPBACK_QUEUE_SIZE  (256)
+
+#define MSE_LOOPBACK_PACKET_LENGTH (1526)
+
+/* receive returns to MSE after this wait without packets */
+#define MSE_LOOPBACK_IDLE_WAIT_NS (100 * NSEC_PER_MSEC)
+
+/* device names are followed by link number, e.g. loop_tx0 and loop_rx0 */
+#define MSE_LOOPBACK_DEVNAME_TX "loop_tx"
+#define MSE_LOOPBACK_DEVNAME_RX "loop_rx"
+
+struct mse_loopback_frame {
+	u64 due_ns;
+	unsigned int len;
+	u8 data[MSE_LOOPBACK_PACKET_LENGTH];
+};
+
+struct mse_loopback_link {
+	int users;
+	bool rx_opened;
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	/* frames [head, tail) are queued */
+	struct mse_loopback_frame *queue;
+	unsigned int head;
+	unsigned int tail;
+	u64 last_due_ns;
+	u64 lost;
+	u64 overrun;
+};
+
+struct mse_adapter_loopback {
+	int index;
+	bool tx;
+	struct mse_loopback_link *link;
+	struct mse_packet *packets;
+	int num_entry;
+	int pos;
+	unsigned int cancel_count;
+};
+
+static int adapter_index;
+static struct mse_adapter_loopback loopback_table[MSE_LOOPBACK_ADAPTER_MAX];
+static struct mse_loopback_link link_table[MSE_LOOPBACK_LINK_MAX];
+DECLARE_BITMAP(loopback_table_map, MSE_LOOPBACK_ADAPTER_MAX);
+static DEFINE_MUTEX(loopback_lock);
+
+static int latency_us;
+module_param(latency_us, int, 0660);
+MODULE_PARM_DESC(latency_us, "delay from send to receive of packets in microseconds");
+
+static int jitter_us;
+module_param(jitter_us, int, 0660);
+MODULE_PARM_DESC(jitter_us, "random delay up to this added to latency_us in microseconds");
+
+static int loss_ppm;
+module_param(loss_ppm, int, 0660);
+MODULE_PARM_DESC(loss_ppm, "packets dropped per million sent packets");
+
+static int link_speed = 1000;
+module_param(link_speed, int, 0660);
+MODULE_PARM_DESC(link_speed, "link speed reported to MSE in Mbps");
+
+static struct mse_adapter_loopback *mse_adapter_loopback_get_priv(int index)
+{
+	if (index < 0 || index >= ARRAY_SIZE(loopback_table))
+		return NULL;
+
+	if (!test_bit(index, loopback_table_map))
+		return NULL;
+
+	return &loopback_table[index];
+}
+
+static int mse_adapter_loopback_parse_devname(const char *name, bool *tx)
+{
+	int link_id;
+	const char *num;
+
+	if (!strncmp(name, MSE_LOOPBACK_DEVNAME_TX,
+		     strlen(MSE_LOOPBACK_DEVNAME_TX))) {
+		*tx = true;
+		num = name + strlen(MSE_LOOPBACK_DEVNAME_TX);
+	} else if (!strncmp(name, MSE_LOOPBACK_DEVNAME_RX,
+			    strlen(MSE_LOOPBACK_DEVNAME_RX))) {
+		*tx = false;
+		num = name + strlen(MSE_LOOPBACK_DEVNAME_RX);
+	} else {
+		return -EINVAL;
+	}
+
+	if (kstrtoint(num, 10, &link_id) ||
+	    link_id < 0 || link_id >= MSE_LOOPBACK_LINK_MAX)
+		return -EINVAL;
+
+	return link_id;
+}
+
+static int mse_adapter_loopback_open(char *name)
+{
+	int index, link_id;
+	bool tx;
+	struct mse_adapter_loopback *lb;
+	struct mse_loopback_link *link;
+	char devname[MSE_NAME_LEN_MAX + 1];
+
+	if (!name) {
+		mse_err("invalid argument. name\n");
+		return -EINVAL;
+	}
+
+	mse_name_strlcpy(devname, name);
+	link_id = mse_adapter_loopback_parse_devname(devname, &tx);
+	if (link_id < 0) {
+		mse_err("error unknown dev=%s\n", devname);
+		return -EPERM;
+	}
+
+	mse_debug("dev=%s link=%d\n", devname, link_id);
+
+	mutex_lock(&loopback_lock);
+
+	link = &link_table[link_id];
+	if (!tx && link->rx_opened) {
+		mse_err("error dev=%s is already opened\n", devname);
+		index = -EBUSY;
+		goto out;
+	}
+
+	index = find_first_zero_bit(loopback_table_map,
+				    MSE_LOOPBACK_ADAPTER_MAX);
+	if (index >= MSE_LOOPBACK_ADAPTER_MAX) {
+		mse_err("failed to allocate loopback, dev=%s\n", devname);
+		index = -EPERM;
+		goto out;
+	}
+
+	if (!link->users) {
+		link->queue = vzalloc(sizeof(*link->queue) *
+				      MSE_LOOPBACK_QUEUE_SIZE);
+		if (!link->queue) {
+			index = -ENOMEM;
+			goto out;
+		}
+		link->lost = 0;
+		link->overrun = 0;
+	}
+
+	if (!tx) {
+		/* drop frames sent while nobody was receiving */
+		spin_lock(&link->lock);
+		link->head = link->tail;
+		spin_unlock(&link->lock);
+		link->rx_opened = true;
+	}
+
+	link->users++;
+
+	lb = &loopback_table[index];
+	memset(lb, 0, sizeof(*lb));
+	lb->index = index;
+	lb->tx = tx;
+	lb->link = link;
+	set_bit(index, loopback_table_map);
+
+out:
+	mutex_unlock(&loopback_lock);
+
+	return index;
+}
+
+static int mse_adapter_loopback_release(int index)
+{
+	struct mse_adapter_loopback *lb;
+	struct mse_loopback_link *link;
+
+	mse_debug("index=%d\n", index);
+
+	mutex_lock(&loopback_lock);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mutex_unlock(&loopback_lock);
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	link = lb->link;
+	if (!lb->tx)
+		link->rx_opened = false;
+
+	if (!--link->users) {
+		mse_info("link=%td lost=%llu overrun=%llu\n",
+			 link - link_table, link->lost, link->overrun);
+		vfree(link->queue);
+		link->queue = NULL;
+	}
+
+	clear_bit(index, loopback_table_map);
+
+	mutex_unlock(&loopback_lock);
+
+	return 0;
+}
+
+static int mse_adapter_loopback_set_cbs_param(int index,
+					      struct mse_cbsparam *cbs)
+{
+	struct mse_adapter_loopback *lb;
+
+	mse_debug("index=%d\n", index);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!lb->tx) {
+		mse_err("error: wrong loopback device, tx expected\n");
+		return -EPERM;
+	}
+
+	if (!cbs) {
+		mse_err("invalid argument. cbs\n");
+		return -EINVAL;
+	}
+
+	/* traffic shaping is not emulated */
+	return 0;
+}
+
+static int mse_adapter_loopback_set_streamid(int index, u8 streamid[8])
+{
+	struct mse_adapter_loopback *lb;
+
+	mse_debug("index=%d\n", index);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (lb->tx) {
+		mse_err("error: wrong loopback device, rx expected\n");
+		return -EPERM;
+	}
+
+	/* all streams of the link are received, MSE demultiplexes them */
+	return 0;
+}
+
+static int mse_adapter_loopback_prepare(int index,
+					struct mse_packet *packets,
+					int num_packets,
+					bool tx)
+{
+	struct mse_adapter_loopback *lb;
+
+	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (lb->tx != tx) {
+		mse_err("error: wrong loopback device, %s expected\n",
+			tx ? "tx" : "rx");
+		return -EPERM;
+	}
+
+	if (!packets) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (num_packets <= 0)
+		return -EINVAL;
+
+	lb->packets = packets;
+	lb->num_entry = num_packets;
+	lb->pos = 0;
+
+	return 0;
+}
+
+static int mse_adapter_loopback_send_prepare(int index,
+					     struct mse_packet *packets,
+					     int num_packets)
+{
+	return mse_adapter_loopback_prepare(index, packets, num_packets, true);
+}
+
+static int mse_adapter_loopback_receive_prepare(int index,
+						struct mse_packet *packets,
+						int num_packets)
+{
+	return mse_adapter_loopback_prepare(index, packets, num_packets,
+					    false);
+}
+
+static bool mse_adapter_loopback_is_lost(int loss)
+{
+	return loss > 0 && get_random_u32() % 1000000 < loss;
+}
+
+static int mse_adapter_loopback_send(int index,
+				     struct mse_packet *packets,
+				     int num_packets)
+{
+	struct mse_adapter_loopback *lb;
+	struct mse_loopback_link *link;
+	struct mse_loopback_frame *frame;
+	struct mse_packet *packet;
+	int i, latency, jitter, loss;
+	u64 now, due;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!lb->tx) {
+		mse_err("error: wrong loopback device, tx expected\n");
+		return -EPERM;
+	}
+
+	if (num_packets <= 0 || num_packets > lb->num_entry) {
+		mse_err("incorrect num_packets: %d\n", num_packets);
+		return -EINVAL;
+	}
+
+	link = lb->link;
+	latency = max(READ_ONCE(latency_us), 0);
+	jitter = max(READ_ONCE(jitter_us), 0);
+	loss = READ_ONCE(loss_ppm);
+	now = ktime_get_ns();
+
+	spin_lock(&link->lock);
+
+	for (i = 0; i < num_packets; i++) {
+		packet = &packets[(lb->pos + i) % lb->num_entry];
+
+		if (!READ_ONCE(link->rx_opened))
+			continue;
+
+		if (mse_adapter_loopback_is_lost(loss)) {
+			link->lost++;
+			continue;
+		}
+
+		if (link->tail - link->head >= MSE_LOOPBACK_QUEUE_SIZE) {
+			link->overrun++;
+			continue;
+		}
+
+		frame = &link->queue[link->tail % MSE_LOOPBACK_QUEUE_SIZE];
+		frame->len = min_t(unsigned int, packet->len,
+				   sizeof(frame->data));
+		memcpy(frame->data, packet->vaddr, frame->len);
+
+		due = now + (u64)latency * NSEC_PER_USEC;
+		if (jitter)
+			due += (u64)(get_random_u32() % (jitter + 1)) *
+			       NSEC_PER_USEC;
+
+		/* jitter does not reorder frames */
+		frame->due_ns = max(due, link->last_due_ns);
+		link->last_due_ns = frame->due_ns;
+		link->tail++;
+	}
+
+	spin_unlock(&link->lock);
+
+	lb->pos = (lb->pos + num_packets) % lb->num_entry;
+	wake_up_interruptible(&link->wait);
+
+	return num_packets;
+}
+
+/* copy due frames into packets, called with link lock held */
+static int mse_adapter_loopback_dequeue(struct mse_adapter_loopback *lb,
+					int num_packets,
+					u64 *wait_ns)
+{
+	struct mse_loopback_link *link = lb->link;
+	struct mse_loopback_frame *frame;
+	struct mse_packet *packet;
+	u64 now = ktime_get_ns();
+	int receive = 0;
+
+	*wait_ns = MSE_LOOPBACK_IDLE_WAIT_NS;
+
+	while (receive < num_packets && link->head != link->tail) {
+		frame = &link->queue[link->head % MSE_LOOPBACK_QUEUE_SIZE];
+		if (frame->due_ns > now) {
+			*wait_ns = frame->due_ns - now;
+			break;
+		}
+
+		packet = &lb->packets[(lb->pos + receive) % lb->num_entry];
+		memcpy(packet->vaddr, frame->data,
+		       min(frame->len, packet->len));
+		link->head++;
+		receive++;
+	}
+
+	lb->pos = (lb->pos + receive) % lb->num_entry;
+
+	return receive;
+}
+
+static int mse_adapter_loopback_receive(int index, int num_packets)
+{
+	struct mse_adapter_loopback *lb;
+	struct mse_loopback_link *link;
+	unsigned int cancel_count, tail;
+	u64 wait_ns;
+	int receive, ret;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (lb->tx) {
+		mse_err("error: wrong loopback device, rx expected\n");
+		return -EPERM;
+	}
+
+	if (num_packets <= 0 || num_packets > lb->num_entry) {
+		mse_err("incorrect num_packets: %d\n", num_packets);
+		return -EINVAL;
+	}
+
+	link = lb->link;
+	cancel_count = READ_ONCE(lb->cancel_count);
+
+	for (;;) {
+		spin_lock(&link->lock);
+		receive = mse_adapter_loopback_dequeue(lb, num_packets,
+						       &wait_ns);
+		tail = link->tail;
+		spin_unlock(&link->lock);
+
+		if (receive)
+			return receive;
+
+		if (READ_ONCE(lb->cancel_count) != cancel_count)
+			return -EINTR;
+
+		/* wait for new frames, due time of head frame or cancel */
+		ret = wait_event_interruptible_hrtimeout(
+			link->wait,
+			READ_ONCE(link->tail) != tail ||
+			READ_ONCE(lb->cancel_count) != cancel_count,
+			ns_to_ktime(wait_ns));
+		if (ret == -ERESTARTSYS)
+			return -EINTR;
+
+		if (ret == -ETIME && wait_ns == MSE_LOOPBACK_IDLE_WAIT_NS)
+			return 0;
+	}
+}
+
+static int mse_adapter_loopback_cancel(int index)
+{
+	struct mse_adapter_loopback *lb;
+
+	lb = mse_adapter_loopback_get_priv(index);
+	if (!lb) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	WRITE_ONCE(lb->cancel_count, lb->cancel_count + 1);
+	wake_up_interruptible(&lb->link->wait);
+
+	return 0;
+}
+
+static int mse_adapter_loopback_get_link_speed(int index)
+{
+	mse_debug("index=%d\n", index);
+
+	if (!mse_adapter_loopback_get_priv(index)) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	/* return speed as Mbps */
+	return READ_ONCE(link_speed);
+}
+
+static struct mse_adapter_network_ops mse_adapter_loopback_ops = {
+	.owner = THIS_MODULE,
+	.name = "loopback",
+	.type = MSE_TYPE_ADAPTER_NETWORK,
+	.open = mse_adapter_loopback_open,
+	.release = mse_adapter_loopback_release,
+	.set_cbs_param = mse_adapter_loopback_set_cbs_param,
+	.set_streamid = mse_adapter_loopback_set_streamid,
+	.send_prepare = mse_adapter_loopback_send_prepare,
+	.send = mse_adapter_loopback_send,
+	.receive_prepare = mse_adapter_loopback_receive_prepare,
+	.receive = mse_adapter_loopback_receive,
+	.cancel = mse_adapter_loopback_cancel,
+	.get_link_speed = mse_adapter_loopback_get_link_speed,
+	.rx_shared = true,
+	.cpu_copy = true,
+};
+
+static int __init mse_adapter_loopback_init(void)
+{
+	int i;
+
+	mse_debug("START\n");
+
+	for (i = 0; i < ARRAY_SIZE(link_table); i++) {
+		spin_lock_init(&link_table[i].lock);
+		init_waitqueue_head(&link_table[i].wait);
+	}
+
+	adapter_index = mse_register_adapter_network(&mse_adapter_loopback_ops);
+	if (adapter_index < 0) {
+		mse_err("cannot register\n");
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+static void __exit mse_adapter_loopback_exit(void)
+{
+	mse_debug("START\n");
+	mse_unregister_adapter_network(adapter_index);
+}
+
+module_init(mse_adapter_loopback_init);
+module_exit(mse_adapter_loopback_exit);
+
+MODULE_AUTHOR("Renesas Electronics Corporation");
+MODULE_DESCRIPTION("Renesas Media Streaming Engine");
+MODULE_LICENSE("Dual MIT/GPL");
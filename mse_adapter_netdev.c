@@ -0,0 +1,797 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/ethtool.h>
+#include <linux/rtnetlink.h>
+#include <linux/skbuff.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <asm/unaligned.h>
+#include "ravb_mse_kernel.h"
+
+#define MSE_NETDEV_ADAPTER_MAX (10)
+#define MSE_NETDEV_PORT_MAX    (4)
+
+/* offset of stream ID in AVTP header */
+#define MSE_NETDEV_STREAMID_OFFSET (4)
+
+/* receive returns to MSE after this wait without packets */
+#define MSE_NETDEV_IDLE_WAIT_MS (100)
+
+/* network device opened by adapter, shared by TX and RX handles */
+struct mse_netdev_port {
+	struct net_device __rcu *dev;
+	int users;
+	/* RX handles, the rx_handler is registered while not empty */
+	struct list_head rx_list;
+	int rx_users;
+};
+
+struct mse_adapter_netdev {
+	int index;
+	bool tx;
+	bool rx;
+	struct mse_netdev_port *port;
+	struct mse_packet *packets;
+	int num_entry;
+	int pos;
+	/* RX filter, stream ID is stored as it is in AVTP header */
+	u64 streamid;
+	bool streamid_valid;
+	struct list_head list;
+	struct sk_buff_head rxq;
+	wait_queue_head_t wait;
+	unsigned int cancel_count;
+	u64 dropped;
+	u64 overrun;
+};
+
+static int adapter_index;
+static struct mse_adapter_netdev netdev_table[MSE_NETDEV_ADAPTER_MAX];
+static struct mse_netdev_port port_table[MSE_NETDEV_PORT_MAX];
+/* tables are protected by rtnl_lock */
+DECLARE_BITMAP(netdev_table_map, MSE_NETDEV_ADAPTER_MAX);
+
+static int rx_queue_len = 256;
+module_param(rx_queue_len, int, 0660);
+MODULE_PARM_DESC(rx_queue_len, "max number of frames queued for receive per stream");
+
+static int launch_offset_us;
+module_param(launch_offset_us, int, 0660);
+MODULE_PARM_DESC(launch_offset_us, "launch time of frames from now in microseconds for etf qdisc, 0 is disabled");
+
+static int link_speed = 1000;
+module_param(link_speed, int, 0660);
+MODULE_PARM_DESC(link_speed, "link speed reported to MSE in Mbps if device does not report it");
+
+static struct mse_adapter_netdev *mse_adapter_netdev_get_priv(int index)
+{
+	if (index < 0 || index >= ARRAY_SIZE(netdev_table))
+		return NULL;
+
+	if (!test_bit(index, netdev_table_map))
+		return NULL;
+
+	return &netdev_table[index];
+}
+
+static struct mse_netdev_port *mse_adapter_netdev_get_port(
+	struct net_device *dev)
+{
+	struct mse_netdev_port *free_port = NULL;
+	int i;
+
+	ASSERT_RTNL();
+
+	for (i = 0; i < ARRAY_SIZE(port_table); i++) {
+		if (!port_table[i].users) {
+			if (!free_port)
+				free_port = &port_table[i];
+			continue;
+		}
+
+		if (rtnl_dereference(port_table[i].dev) == dev)
+			return &port_table[i];
+	}
+
+	if (free_port) {
+		dev_hold(dev);
+		rcu_assign_pointer(free_port->dev, dev);
+		INIT_LIST_HEAD(&free_port->rx_list);
+		free_port->rx_users = 0;
+	}
+
+	return free_port;
+}
+
+/* drop the device, called at last release or unregistration of device */
+static void mse_adapter_netdev_detach_port(struct mse_netdev_port *port)
+{
+	struct net_device *dev = rtnl_dereference(port->dev);
+
+	ASSERT_RTNL();
+
+	if (!dev)
+		return;
+
+	if (port->rx_users)
+		netdev_rx_handler_unregister(dev);
+
+	RCU_INIT_POINTER(port->dev, NULL);
+	synchronize_net();
+	dev_put(dev);
+}
+
+static rx_handler_result_t mse_adapter_netdev_rx_handler(struct sk_buff **pskb)
+{
+	struct sk_buff *skb = *pskb;
+	struct mse_netdev_port *port;
+	struct mse_adapter_netdev *nd;
+	u64 buf, *streamid;
+
+	/* VLAN tag is already taken out to skb by RX path */
+	if (skb->protocol != htons(ETH_P_TSN))
+		return RX_HANDLER_PASS;
+
+	streamid = skb_header_pointer(skb, MSE_NETDEV_STREAMID_OFFSET,
+				      sizeof(buf), &buf);
+	if (!streamid)
+		return RX_HANDLER_PASS;
+
+	port = rcu_dereference(skb->dev->rx_handler_data);
+
+	list_for_each_entry_rcu(nd, &port->rx_list, list) {
+		if (!READ_ONCE(nd->streamid_valid) ||
+		    READ_ONCE(nd->streamid) != get_unaligned(streamid))
+			continue;
+
+		/* skb is held in queue, do not share it with other taps */
+		skb = skb_share_check(skb, GFP_ATOMIC);
+		if (!skb)
+			return RX_HANDLER_CONSUMED;
+
+		spin_lock(&nd->rxq.lock);
+		if (skb_queue_len(&nd->rxq) >= READ_ONCE(rx_queue_len)) {
+			nd->overrun++;
+			spin_unlock(&nd->rxq.lock);
+			kfree_skb(skb);
+
+			return RX_HANDLER_CONSUMED;
+		}
+		__skb_queue_tail(&nd->rxq, skb);
+		spin_unlock(&nd->rxq.lock);
+
+		wake_up_interruptible(&nd->wait);
+
+		return RX_HANDLER_CONSUMED;
+	}
+
+	return RX_HANDLER_PASS;
+}
+
+static int mse_adapter_netdev_open(char *name)
+{
+	struct mse_adapter_netdev *nd;
+	struct mse_netdev_port *port;
+	struct net_device *dev;
+	int index;
+
+	if (!name) {
+		mse_err("invalid argument. name\n");
+		return -EINVAL;
+	}
+
+	mse_debug("dev=%s\n", name);
+
+	rtnl_lock();
+
+	dev = __dev_get_by_name(&init_net, name);
+	if (!dev) {
+		mse_err("error unknown dev=%s\n", name);
+		index = -ENODEV;
+		goto out;
+	}
+
+	index = find_first_zero_bit(netdev_table_map, MSE_NETDEV_ADAPTER_MAX);
+	if (index >= MSE_NETDEV_ADAPTER_MAX) {
+		mse_err("failed to allocate netdev, dev=%s\n", name);
+		index = -EPERM;
+		goto out;
+	}
+
+	port = mse_adapter_netdev_get_port(dev);
+	if (!port) {
+		mse_err("too many devices, dev=%s\n", name);
+		index = -EBUSY;
+		goto out;
+	}
+	port->users++;
+
+	nd = &netdev_table[index];
+	memset(nd, 0, sizeof(*nd));
+	nd->index = index;
+	nd->port = port;
+	INIT_LIST_HEAD(&nd->list);
+	skb_queue_head_init(&nd->rxq);
+	init_waitqueue_head(&nd->wait);
+	set_bit(index, netdev_table_map);
+
+out:
+	rtnl_unlock();
+
+	return index;
+}
+
+static int mse_adapter_netdev_release(int index)
+{
+	struct mse_adapter_netdev *nd;
+	struct mse_netdev_port *port;
+	struct net_device *dev;
+
+	mse_debug("index=%d\n", index);
+
+	rtnl_lock();
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		rtnl_unlock();
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	port = nd->port;
+	dev = rtnl_dereference(port->dev);
+
+	if (nd->rx) {
+		list_del_rcu(&nd->list);
+		if (!--port->rx_users && dev)
+			netdev_rx_handler_unregister(dev);
+		else
+			synchronize_net();
+		skb_queue_purge(&nd->rxq);
+	}
+
+	if (nd->dropped || nd->overrun)
+		mse_info("index=%d dropped=%llu overrun=%llu\n",
+			 index, nd->dropped, nd->overrun);
+
+	if (!--port->users)
+		mse_adapter_netdev_detach_port(port);
+
+	clear_bit(index, netdev_table_map);
+
+	rtnl_unlock();
+
+	return 0;
+}
+
+static int mse_adapter_netdev_set_cbs_param(int index,
+					    struct mse_cbsparam *cbs)
+{
+	struct mse_adapter_netdev *nd;
+
+	mse_debug("index=%d\n", index);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!cbs) {
+		mse_err("invalid argument. cbs\n");
+		return -EINVAL;
+	}
+
+	/* shaping is configured to mqprio and cbs qdisc by tc */
+	mse_debug("idle_slope=%u send_slope=%u\n",
+		  cbs->idle_slope, cbs->send_slope);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_set_streamid(int index, u8 streamid[8])
+{
+	struct mse_adapter_netdev *nd;
+
+	mse_debug("index=%d\n", index);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!streamid) {
+		mse_err("invalid argument. streamid\n");
+		return -EINVAL;
+	}
+
+	WRITE_ONCE(nd->streamid, get_unaligned((u64 *)streamid));
+	WRITE_ONCE(nd->streamid_valid, true);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_send_prepare(int index,
+					   struct mse_packet *packets,
+					   int num_packets)
+{
+	struct mse_adapter_netdev *nd;
+
+	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!packets || num_packets <= 0) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (nd->rx) {
+		mse_err("error: wrong netdev handle, tx expected\n");
+		return -EPERM;
+	}
+
+	nd->tx = true;
+	nd->packets = packets;
+	nd->num_entry = num_packets;
+	nd->pos = 0;
+
+	return 0;
+}
+
+static struct sk_buff *mse_adapter_netdev_build_skb(struct net_device *dev,
+						    struct mse_packet *packet)
+{
+	struct vlan_ethhdr *vhdr;
+	struct sk_buff *skb;
+	int offset;
+
+	if (packet->len < ETH_HLEN)
+		return NULL;
+
+	offset = LL_RESERVED_SPACE(dev);
+	skb = alloc_skb(offset + packet->len + dev->needed_tailroom,
+			GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	skb_reserve(skb, offset);
+	skb_put_data(skb, packet->vaddr, packet->len);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->dev = dev;
+	skb->protocol = eth_hdr(skb)->h_proto;
+
+	/* PCP of VLAN tag selects traffic class of mqprio */
+	if (skb->protocol == htons(ETH_P_8021Q) &&
+	    packet->len >= VLAN_ETH_HLEN) {
+		vhdr = (struct vlan_ethhdr *)skb->data;
+		skb->priority = (ntohs(vhdr->h_vlan_TCI) & VLAN_PRIO_MASK) >>
+				VLAN_PRIO_SHIFT;
+	}
+
+	return skb;
+}
+
+static int mse_adapter_netdev_send(int index,
+				   struct mse_packet *packets,
+				   int num_packets)
+{
+	struct mse_adapter_netdev *nd;
+	struct net_device *dev;
+	struct sk_buff *skb;
+	int i, offset_us;
+	ktime_t launch_time = 0;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!nd->tx) {
+		mse_err("error: wrong netdev handle, tx expected\n");
+		return -EPERM;
+	}
+
+	if (num_packets <= 0 || num_packets > nd->num_entry) {
+		mse_err("incorrect num_packets: %d\n", num_packets);
+		return -EINVAL;
+	}
+
+	rcu_read_lock();
+	dev = rcu_dereference(nd->port->dev);
+	if (dev)
+		dev_hold(dev);
+	rcu_read_unlock();
+
+	if (!dev)
+		return -ENODEV;
+
+	/* etf qdisc needs skip_sock_check, frames have no socket */
+	offset_us = READ_ONCE(launch_offset_us);
+	if (offset_us > 0)
+		launch_time = ktime_add_us(ktime_get_clocktai(), offset_us);
+
+	for (i = 0; i < num_packets; i++) {
+		skb = mse_adapter_netdev_build_skb(
+			dev, &packets[(nd->pos + i) % nd->num_entry]);
+		if (!skb) {
+			nd->dropped++;
+			continue;
+		}
+
+		skb->tstamp = launch_time;
+		if (net_xmit_eval(dev_queue_xmit(skb)))
+			nd->dropped++;
+	}
+
+	dev_put(dev);
+
+	nd->pos = (nd->pos + num_packets) % nd->num_entry;
+
+	return num_packets;
+}
+
+static int mse_adapter_netdev_receive_prepare(int index,
+					      struct mse_packet *packets,
+					      int num_packets)
+{
+	struct mse_adapter_netdev *nd;
+	struct mse_netdev_port *port;
+	struct net_device *dev;
+	int ret = 0;
+
+	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!packets || num_packets <= 0) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (nd->tx) {
+		mse_err("error: wrong netdev handle, rx expected\n");
+		return -EPERM;
+	}
+
+	nd->packets = packets;
+	nd->num_entry = num_packets;
+	nd->pos = 0;
+
+	rtnl_lock();
+
+	if (nd->rx)
+		goto out;
+
+	port = nd->port;
+	dev = rtnl_dereference(port->dev);
+	if (!dev) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (!port->rx_users) {
+		ret = netdev_rx_handler_register(dev,
+						 mse_adapter_netdev_rx_handler,
+						 port);
+		if (ret) {
+			mse_err("cannot register rx_handler to %s ret=%d\n",
+				dev->name, ret);
+			goto out;
+		}
+	}
+
+	port->rx_users++;
+	list_add_tail_rcu(&nd->list, &port->rx_list);
+	nd->rx = true;
+
+out:
+	rtnl_unlock();
+
+	return ret;
+}
+
+/*
+ * RX path removed VLAN tag and Ethernet header from skb, so they are
+ * put back in front of AVTP header as MSE expects.
+ */
+static void mse_adapter_netdev_copy_frame(struct sk_buff *skb,
+					  struct mse_packet *packet)
+{
+	struct vlan_ethhdr *vhdr = packet->vaddr;
+	struct ethhdr *eth = eth_hdr(skb);
+	u16 tci = 0;
+
+	if (skb_vlan_tag_present(skb))
+		tci = skb_vlan_tag_get(skb);
+
+	ether_addr_copy(vhdr->h_dest, eth->h_dest);
+	ether_addr_copy(vhdr->h_source, eth->h_source);
+	vhdr->h_vlan_proto = htons(ETH_P_8021Q);
+	vhdr->h_vlan_TCI = htons(tci);
+	vhdr->h_vlan_encapsulated_proto = htons(ETH_P_TSN);
+
+	skb_copy_bits(skb, 0, packet->vaddr + VLAN_ETH_HLEN,
+		      min_t(unsigned int, skb->len,
+			    packet->len - VLAN_ETH_HLEN));
+}
+
+static int mse_adapter_netdev_dequeue(struct mse_adapter_netdev *nd,
+				      int num_packets)
+{
+	struct sk_buff *skb;
+	int receive;
+
+	for (receive = 0; receive < num_packets; receive++) {
+		skb = skb_dequeue(&nd->rxq);
+		if (!skb)
+			break;
+
+		mse_adapter_netdev_copy_frame(
+			skb, &nd->packets[(nd->pos + receive) % nd->num_entry]);
+		consume_skb(skb);
+	}
+
+	nd->pos = (nd->pos + receive) % nd->num_entry;
+
+	return receive;
+}
+
+static int mse_adapter_netdev_receive(int index, int num_packets)
+{
+	struct mse_adapter_netdev *nd;
+	unsigned int cancel_count;
+	int receive;
+	long ret;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	if (!nd->rx) {
+		mse_err("error: wrong netdev handle, rx expected\n");
+		return -EPERM;
+	}
+
+	if (num_packets <= 0 || num_packets > nd->num_entry) {
+		mse_err("incorrect num_packets: %d\n", num_packets);
+		return -EINVAL;
+	}
+
+	cancel_count = READ_ONCE(nd->cancel_count);
+
+	for (;;) {
+		receive = mse_adapter_netdev_dequeue(nd, num_packets);
+		if (receive)
+			return receive;
+
+		if (READ_ONCE(nd->cancel_count) != cancel_count)
+			return -EINTR;
+
+		if (!rcu_access_pointer(nd->port->dev))
+			return -ENODEV;
+
+		ret = wait_event_interruptible_timeout(
+			nd->wait,
+			!skb_queue_empty_lockless(&nd->rxq) ||
+			READ_ONCE(nd->cancel_count) != cancel_count,
+			msecs_to_jiffies(MSE_NETDEV_IDLE_WAIT_MS));
+		if (ret < 0)
+			return -EINTR;
+
+		if (!ret)
+			return 0;
+	}
+}
+
+static int mse_adapter_netdev_cancel(int index)
+{
+	struct mse_adapter_netdev *nd;
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	WRITE_ONCE(nd->cancel_count, nd->cancel_count + 1);
+	wake_up_interruptible(&nd->wait);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_get_link_speed(int index)
+{
+	struct mse_adapter_netdev *nd;
+	struct ethtool_link_ksettings ks;
+	struct net_device *dev;
+	int speed;
+
+	mse_debug("index=%d\n", index);
+
+	nd = mse_adapter_netdev_get_priv(index);
+	if (!nd) {
+		mse_err("failed to get adapter\n");
+		return -EPERM;
+	}
+
+	rtnl_lock();
+
+	dev = rtnl_dereference(nd->port->dev);
+	if (!dev || !netif_carrier_ok(dev))
+		speed = 0;
+	else if (__ethtool_get_link_ksettings(dev, &ks) ||
+		 !ks.base.speed || ks.base.speed == SPEED_UNKNOWN)
+		/* virtual devices may not know their speed */
+		speed = READ_ONCE(link_speed);
+	else
+		speed = ks.base.speed;
+
+	rtnl_unlock();
+
+	/* return speed as Mbps */
+	return speed;
+}
+
+static int mse_adapter_netdev_event(struct notifier_block *nb,
+				    unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	int i;
+
+	if (event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	for (i = 0; i < ARRAY_SIZE(port_table); i++) {
+		if (port_table[i].users &&
+		    rtnl_dereference(port_table[i].dev) == dev) {
+			mse_warn("%s is unregistered\n", dev->name);
+			mse_adapter_netdev_detach_port(&port_table[i]);
+		}
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block mse_adapter_netdev_notifier = {
+	.notifier_call = mse_adapter_netdev_event,
+};
+
+static struct mse_adapter_network_ops mse_adapter_netdev_ops = {
+	.owner = THIS_MODULE,
+	.name = "netdev",
+	.type = MSE_TYPE_ADAPTER_NETWORK,
+	.open = mse_adapter_netdev_open,
+	.release = mse_adapter_netdev_release,
+	.set_cbs_param = mse_adapter_netdev_set_cbs_param,
+	.set_streamid = mse_adapter_netdev_set_streamid,
+	.send_prepare = mse_adapter_netdev_send_prepare,
+	.send = mse_adapter_netdev_send,
+	.receive_prepare = mse_adapter_netdev_receive_prepare,
+	.receive = mse_adapter_netdev_receive,
+	.cancel = mse_adapter_netdev_cancel,
+	.get_link_speed = mse_adapter_netdev_get_link_speed,
+	.cpu_copy = true,
+};
+
+static int __init mse_adapter_netdev_init(void)
+{
+	int ret;
+
+	mse_debug("START\n");
+
+	ret = register_netdevice_notifier(&mse_adapter_netdev_notifier);
+	if (ret) {
+		mse_err("cannot register netdevice notifier\n");
+		return ret;
+	}
+
+	adapter_index = mse_register_adapter_network(&mse_adapter_netdev_ops);
+	if (adapter_index < 0) {
+		mse_err("cannot register\n");
+		unregister_netdevice_notifier(&mse_adapter_netdev_notifier);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+static void __exit mse_adapter_netdev_exit(void)
+{
+	mse_debug("START\n");
+	mse_unregister_adapter_network(adapter_index);
+	unregister_netdevice_notifier(&mse_adapter_netdev_notifier);
+}
+
+module_init(mse_adapter_netdev_init);
+module_exit(mse_adapter_netdev_exit);
+
+MODULE_AUTHOR("Renesas Electronics Corporation");
+MODULE_DESCRIPTION("Renesas Media Streaming Engine");
+MODULE_LICENSE("Dual MIT/GPL");
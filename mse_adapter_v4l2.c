@@ -119,6 +119,8 @@ struct v4l2_adapter_temp_buffer {
 	size_t length;
 	unsigned char *buf;
 	bool prepared;
+	/* marker offsets of MJPEG frame, found while it is written */
+	struct mse_jpeg_markers markers;
 };
 
 /* File handle information */
@@ -168,6 +170,11 @@ struct v4l2_adapter_device {
 
 	/* mpeg2ts stream type */
 	enum MSE_MPEG2TS_TYPE	mpeg2ts_type;
+
+	/* NAL index of last captured frame, protected by lock_buf_list */
+	struct v4l2_ctrl_handler	ctrl_handler;
+	struct mse_nal_index	nal_index;
+	unsigned int		nal_index_sequence;
 };
 
 /* Format information */
@@ -531,6 +538,7 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 				   size_t size)
 {
 	struct v4l2_adapter_temp_buffer *temp;
+	struct mse_jpeg_markers markers;
 	unsigned char *copy_from;
 	size_t bytesused, length, pos;
 	size_t copy_size = size;
@@ -548,7 +556,9 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 	mse_debug("temp_w=%d bytesused=%zu buf=%p size=%zu\n",
 		  temp_w, bytesused, buf, size);
 
-	pos = jpeg_search_eoi(buf, size, 0);
+	/* one walk finds both SOS and EOI, the packetizer reuses them */
+	jpeg_scan_markers(buf, size, !bytesused, &markers);
+	pos = markers.eoi_offset;
 	if (!((temp_w + NUM_BUFFERS - temp_r - 1) % NUM_BUFFERS > 0)) {
 		if (pos != size) {
 			mse_debug("temp buffer has no enough area\n");
@@ -569,9 +579,16 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 	memcpy(temp->buf + bytesused, copy_from, copy_size);
 	temp->bytesused += copy_size;
 
+	if (!bytesused)
+		temp->markers.header_len = markers.header_len;
+
 	if (jpeg_frame_is_valid(temp->buf, temp->bytesused)) {
+		temp->markers.eoi_offset = temp->bytesused;
 		temp->prepared = true;
 		vadp_dev->temp_w = (temp_w + 1) % NUM_BUFFERS;
+	} else if (pos != size) {
+		/* broken frame is kept with next one, packetizer searches */
+		temp->markers.header_len = 0;
 	}
 
 	if (size == pos)
@@ -582,6 +599,10 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 	copy_size = size - pos;
 
 	temp = &vadp_dev->temp_buf[vadp_dev->temp_w];
+	if (!temp->bytesused) {
+		jpeg_scan_markers(copy_from, copy_size, true, &markers);
+		temp->markers.header_len = markers.header_len;
+	}
 	memcpy(temp->buf + temp->bytesused, copy_from, copy_size);
 	temp->bytesused += copy_size;
 
@@ -1440,6 +1461,7 @@ static int set_stream_buffer(struct vb2_queue *vq)
 	struct v4l2_adapter_device *vadp_dev = vb2_get_drv_priv(vq);
 	struct v4l2_adapter_temp_buffer *temp;
 	struct v4l2_adapter_buffer *vadp_buf;
+	const struct mse_jpeg_markers *markers = NULL;
 	unsigned char *buf = NULL;
 	long size = 0;
 	int err;
@@ -1469,6 +1491,10 @@ static int set_stream_buffer(struct vb2_queue *vq)
 			if (temp) {
 				buf = temp->buf;
 				size = temp->bytesused;
+				if (vadp_dev->format.pixelformat ==
+				    V4L2_PIX_FMT_MJPEG &&
+				    temp->markers.header_len)
+					markers = &temp->markers;
 			}
 		} else {
 			buf = vb2_plane_vaddr(&vadp_buf->vb.vb2_buf, 0);
@@ -1494,11 +1520,19 @@ static int set_stream_buffer(struct vb2_queue *vq)
 
 	mse_debug("buf=%p size=%lu\n", buf, size);
 
-	err = mse_start_transmission(vadp_dev->index_instance,
-				     buf,
-				     size,
-				     vq,
-				     mse_adapter_v4l2_callback);
+	if (markers)
+		err = mse_start_transmission_jpeg(vadp_dev->index_instance,
+						  buf,
+						  size,
+						  markers,
+						  vq,
+						  mse_adapter_v4l2_callback);
+	else
+		err = mse_start_transmission(vadp_dev->index_instance,
+					     buf,
+					     size,
+					     vq,
+					     mse_adapter_v4l2_callback);
 
 	if (err < 0) {
 		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
@@ -1563,6 +1597,14 @@ static int mse_adapter_v4l2_callback(void *priv, int size)
 		vadp_buf->vb.vb2_buf.timestamp = ktime_get_ns();
 		vadp_buf->vb.sequence = vadp_dev->sequence++;
 		vadp_buf->vb.field = vadp_dev->format.field;
+
+		if (IS_MSE_TYPE_VIDEO(vadp_dev->type)) {
+			vadp_dev->nal_index.num = 0;
+			vadp_dev->nal_index.overflow = false;
+			mse_get_nal_index(vadp_dev->index_instance,
+					  &vadp_dev->nal_index);
+			vadp_dev->nal_index_sequence = vadp_buf->vb.sequence;
+		}
 	} else {
 		if (vadp_dev->use_temp_buffer) {
 			temp = temp_buffer_get_prepared(vadp_dev);
@@ -1786,6 +1828,56 @@ static const struct v4l2_ioctl_ops g_mse_adapter_v4l2_ioctl_ops = {
 ,
 };
 
+static int mse_adapter_v4l2_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct v4l2_adapter_device *vadp_dev;
+	struct mse_nal_index *nal_index;
+	u32 *val = ctrl->p_new.p_u32;
+	unsigned long flags;
+	int i;
+
+	if (ctrl->id != MSE_V4L2_CID_NAL_INDEX)
+		return -EINVAL;
+
+	vadp_dev = container_of(ctrl->handler, struct v4l2_adapter_device,
+				ctrl_handler);
+	nal_index = &vadp_dev->nal_index;
+
+	memset(val, 0, ctrl->elems * sizeof(*val));
+
+	spin_lock_irqsave(&vadp_dev->lock_buf_list, flags);
+
+	val[0] = vadp_dev->nal_index_sequence;
+	val[1] = nal_index->num;
+	if (nal_index->overflow)
+		val[1] |= MSE_V4L2_NAL_INDEX_OVERFLOW;
+
+	for (i = 0; i < nal_index->num; i++) {
+		val[2 + i * 3] = nal_index->entry[i].offset;
+		val[3 + i * 3] = nal_index->entry[i].size;
+		val[4 + i * 3] = nal_index->entry[i].type;
+	}
+
+	spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops g_mse_adapter_v4l2_ctrl_ops = {
+	.g_volatile_ctrl = mse_adapter_v4l2_g_volatile_ctrl,
+};
+
+static const struct v4l2_ctrl_config g_mse_adapter_v4l2_ctrl_nal_index = {
+	.ops	= &g_mse_adapter_v4l2_ctrl_ops,
+	.id	= MSE_V4L2_CID_NAL_INDEX,
+	.name	= "NAL Index",
+	.type	= V4L2_CTRL_TYPE_U32,
+	.flags	= V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+	.max	= U32_MAX,
+	.step	= 1,
+	.dims	= { MSE_V4L2_NAL_INDEX_WORDS },
+};
+
 static struct v4l2_file_operations g_mse_adapter_v4l2_fops = {
 	.owner		= THIS_MODULE,
 	.poll		= vb2_fop_poll,
@@ -1821,6 +1913,7 @@ static void mse_adapter_v4l2_cleanup(struct v4l2_adapter_device *vadp_dev)
 {
 	v4l2_device_unregister(&vadp_dev->v4l2_dev);
 	video_unregister_device(&vadp_dev->vdev);
+	v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
 }
 
 static int vadp_vb2_queue_init(struct v4l2_adapter_device *vadp_dev,
@@ -1887,6 +1980,18 @@ static int mse_adapter_v4l2_probe(int dev_num, enum MSE_TYPE type)
 
 	vdev->lock = &vadp_dev->mutex_vb2;
 
+	v4l2_ctrl_handler_init(&vadp_dev->ctrl_handler, 1);
+	if (IS_MSE_TYPE_VIDEO(type))
+		v4l2_ctrl_new_custom(&vadp_dev->ctrl_handler,
+				     &g_mse_adapter_v4l2_ctrl_nal_index, NULL);
+	if (vadp_dev->ctrl_handler.error) {
+		err = vadp_dev->ctrl_handler.error;
+		mse_err("Failed v4l2_ctrl_new_custom() Rtn=%d\n", err);
+		v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
+		return err;
+	}
+	vdev->ctrl_handler = &vadp_dev->ctrl_handler;
+
 	video_set_drvdata(vdev, vadp_dev);
 
 	v4l2_dev = &vadp_dev->v4l2_dev;
@@ -1895,6 +2000,7 @@ static int mse_adapter_v4l2_probe(int dev_num, enum MSE_TYPE type)
 	err = v4l2_device_register(NULL, v4l2_dev);
 	if (err) {
 		mse_err("Failed v4l2_device_register() Rtn=%d\n", err);
+		v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
 		return -EPERM;
 	}
 
@@ -1903,6 +2009,7 @@ static int mse_adapter_v4l2_probe(int dev_num, enum MSE_TYPE type)
 	if (err) {
 		mse_err("Failed video_register_device() Rtn=%d\n", err);
 		v4l2_device_unregister(&vadp_dev->v4l2_dev);
+		v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
 		return -EPERM;
 	}
 
@@ -66,6 +66,7 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/kobject.h>
+#include <linux/log2.h>
 #include <linux/of_device.h>
 #include <linux/string.h>
 #include <linux/sysfs.h>
@@ -846,7 +847,172 @@ int mse_config_get_delay_time(int index, struct mse_delay_time *data)
 	return 0;
 }
 
+static void mse_config_err_packet_buffer_config(
+	const struct mse_packet_buffer_config *data)
+{
+	mse_err("invalid value. type=%d zero_copy=%d ring_size=%u/%u burst=%u/%u batch=%u guard=%u\n",
+		data->type, data->zero_copy,
+		data->tx_ring_size, data->rx_ring_size,
+		data->tx_burst, data->rx_burst,
+		data->tx_batch_packets, data->tx_batch_guard_ns);
+}
+
+/*
+ * Check the fields which depend on each other, they are written one by one
+ * through sysfs in any order, so it is checked when the stream is opened.
+ */
+int mse_config_check_packet_buffer_config(
+	const struct mse_packet_buffer_config *data)
+{
+	/* one slot is always kept empty in packet buffer */
+	if (data->tx_burst >= data->tx_ring_size ||
+	    data->rx_burst >= data->rx_ring_size)
+		goto wrong_value;
+
+	/* packets are sent at once by tx_burst at most */
+	if (data->tx_batch_packets > data->tx_burst)
+		goto wrong_value;
+
+	return 0;
+
+wrong_value:
+	mse_config_err_packet_buffer_config(data);
+
+	return -EINVAL;
+}
+
+/* each field is checked alone, see mse_config_check_packet_buffer_config */
+int mse_config_set_packet_buffer_config(int index,
+					struct mse_packet_buffer_config *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	if (mse_dev_is_busy(index)) {
+		mse_err("mse%d is running.\n", index);
+		return -EBUSY;
+	}
+
+	mse_debug("START\n");
+
+	if (data->type >= MSE_PACKET_BUFFER_TYPE_MAX)
+		goto wrong_value;
+
+	if (data->tx_ring_size < MSE_CONFIG_RING_SIZE_MIN ||
+	    data->tx_ring_size > MSE_CONFIG_RING_SIZE_MAX ||
+	    data->rx_ring_size < MSE_CONFIG_RING_SIZE_MIN ||
+	    data->rx_ring_size > MSE_CONFIG_RING_SIZE_MAX)
+		goto wrong_value;
+
+	/* ring index is masked, sizes are not rounded up */
+	if (!is_power_of_2(data->tx_ring_size) ||
+	    !is_power_of_2(data->rx_ring_size))
+		goto wrong_value;
+
+	if (data->tx_burst < MSE_CONFIG_BURST_MIN ||
+	    data->tx_burst > MSE_CONFIG_BURST_MAX ||
+	    data->rx_burst < MSE_CONFIG_BURST_MIN ||
+	    data->rx_burst > MSE_CONFIG_BURST_MAX)
+		goto wrong_value;
+
+	if (data->tx_batch_packets < 1)
+		goto wrong_value;
+
+	spin_lock_irqsave(&config->lock, flags);
+	config->packet_buffer_config = *data;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+
+wrong_value:
+	mse_config_err_packet_buffer_config(data);
+
+	return -EINVAL;
+}
+
+int mse_config_get_packet_buffer_config(int index,
+					struct mse_packet_buffer_config *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	mse_debug("START\n");
+
+	spin_lock_irqsave(&config->lock, flags);
+	*data = config->packet_buffer_config;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
+/* stats are set by core when TX stream stops, not by user */
+int mse_config_set_packet_buffer_stats(int index,
+				       struct mse_packet_buffer_stats *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	mse_debug("START\n");
+
+	spin_lock_irqsave(&config->lock, flags);
+	config->packet_buffer_stats = *data;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
+int mse_config_get_packet_buffer_stats(int index,
+				       struct mse_packet_buffer_stats *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	mse_debug("START\n");
+
+	spin_lock_irqsave(&config->lock, flags);
+	*data = config->packet_buffer_stats;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
 /* default config parameters */
+/* packet buffer defaults are common to all media types */
+#define MSE_PACKET_BUFFER_CONFIG_DEFAULT {		\
+	.type = MSE_PACKET_BUFFER_TYPE_COHERENT,	\
+	.zero_copy = false,				\
+	.tx_ring_size = 512,				\
+	.rx_ring_size = 256,				\
+	.tx_burst = 128,				\
+	.rx_burst = 64,					\
+	.tx_batch_packets = 1,				\
+	.tx_batch_guard_ns = 500000,			\
+}
+
 static struct mse_config mse_config_default_audio = {
 	.info = {
 		.device = "",
@@ -901,6 +1067,7 @@ static struct mse_config mse_config_default_audio = {
 		.tx_delay_time_ns = 2000000,
 		.rx_delay_time_ns = 2000000,
 	},
+	.packet_buffer_config = MSE_PACKET_BUFFER_CONFIG_DEFAULT,
 };
 
 static struct mse_config mse_config_default_video = {
@@ -943,6 +1110,7 @@ static struct mse_config mse_config_default_video = {
 		.tx_delay_time_ns = 0,
 		.rx_delay_time_ns = 0,
 	},
+	.packet_buffer_config = MSE_PACKET_BUFFER_CONFIG_DEFAULT,
 };
 
 static struct mse_config mse_config_default_mpeg2ts = {
@@ -985,6 +1153,7 @@ static struct mse_config mse_config_default_mpeg2ts = {
 		.tx_delay_time_ns = 0,
 		.rx_delay_time_ns = 0,
 	},
+	.packet_buffer_config = MSE_PACKET_BUFFER_CONFIG_DEFAULT,
 };
 
 /* config init */
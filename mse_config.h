@@ -82,6 +82,8 @@ struct mse_config {
 	struct mse_avtp_tx_param avtp_tx_param_crf;
 	struct mse_avtp_rx_param avtp_rx_param_crf;
 	struct mse_delay_time delay_time;
+	struct mse_packet_buffer_config packet_buffer_config;
+	struct mse_packet_buffer_stats packet_buffer_stats;
 };
 
 int mse_dev_to_index(struct device *dev);
@@ -128,6 +130,16 @@ int mse_config_get_avtp_rx_param_crf(int index,
 				     struct mse_avtp_rx_param *data);
 int mse_config_set_delay_time(int index, struct mse_delay_time *data);
 int mse_config_get_delay_time(int index, struct mse_delay_time *data);
+int mse_config_check_packet_buffer_config(
+	const struct mse_packet_buffer_config *data);
+int mse_config_set_packet_buffer_config(int index,
+					struct mse_packet_buffer_config *data);
+int mse_config_get_packet_buffer_config(int index,
+					struct mse_packet_buffer_config *data);
+int mse_config_set_packet_buffer_stats(int index,
+				       struct mse_packet_buffer_stats *data);
+int mse_config_get_packet_buffer_stats(int index,
+				       struct mse_packet_buffer_stats *data);
 void mse_config_init(struct mse_config *config,
 		     enum MSE_STREAM_TYPE type,
 		     char *device_name);
@@ -93,9 +93,14 @@
 #define MSE_DEBUG_STATE    (0)
 
 #define MSE_TIMEOUT_CLOSE             (msecs_to_jiffies(5000)) /* 5secs */
-#define MSE_TIMEOUT_PACKETIZE         (msecs_to_jiffies(16))   /* 16msecs */
 #define MSE_TIMEOUT_PACKETIZE_MPEG2TS (msecs_to_jiffies(2000)) /* 2secs */
 
+/** @brief poll interval of packets in flight on network adapter */
+#define MSE_REAP_INTERVAL_US    (250)
+#define MSE_REAP_RETRY_MAX      (80)
+/** @brief poll interval of packets left in flight after stop */
+#define MSE_REAP_KEPT_INTERVAL_US (10000)
+
 #define MSE_RADIX_HEXADECIMAL   (16)
 #define MSE_DEFAULT_BITRATE     (50000000) /* 50Mbps */
 
@@ -106,14 +111,13 @@
 
 /** @brief packet buffer related definitions */
 #define MSE_PACKET_SIZE_MAX     (1526)
-#define MSE_TX_PACKET_NUM_MAX   (128)
-#define MSE_RX_PACKET_NUM_MAX   (128)
-#define MSE_TX_PACKET_NUM       (MSE_TX_PACKET_NUM_MAX)
-#define MSE_RX_PACKET_NUM       (64)
-#define MSE_TX_RING_SIZE        (MSE_TX_PACKET_NUM_MAX * 3)
-#define MSE_RX_RING_SIZE        (MSE_RX_PACKET_NUM_MAX * 2)
-#define MSE_CRF_TX_RING_SIZE    (MSE_TX_PACKET_NUM_MAX)
-#define MSE_CRF_RX_RING_SIZE    (MSE_RX_PACKET_NUM_MAX * 2)
+#define MSE_CRF_PACKET_NUM_MAX  (128)
+/*
+ * ring sizes must be power of 2 for mse_packet_ctrl_alloc(),
+ * media ring size and burst are configured by packet_buffer_config
+ */
+#define MSE_CRF_TX_RING_SIZE    (MSE_CRF_PACKET_NUM_MAX)
+#define MSE_CRF_RX_RING_SIZE    (MSE_CRF_PACKET_NUM_MAX * 2)
 
 #define q_next(que, pos)        (((pos) + 1) % (que)->len)
 #define q_prev(que, pos)        (((pos) - 1 + (que)->len) % (que)->len)
@@ -266,6 +270,12 @@ struct mse_trans_buffer {
 	void *private_data;
 	/** @brief callback function to media adapter */
 	int (*mse_completion)(void *priv, int size);
+	/** @brief NAL index of received H.264 frame, only for listener */
+	struct mse_nal_index *nal_index;
+	/** @brief marker offsets of JPEG frame, eoi_offset 0 if unknown */
+	struct mse_jpeg_markers jpeg_markers;
+	/** @brief packet buffer position after last packet referring it */
+	unsigned int packet_end;
 
 	struct list_head list;
 };
@@ -275,7 +285,7 @@ struct mse_wait_packet {
 	/** @brief AVTP timestamp for launch timer */
 	u64 launch_avtp_timestamp;
 	/** @brief release position of packet buffer */
-	int release_p;
+	unsigned int release_p;
 
 	struct list_head list;
 };
@@ -288,6 +298,42 @@ struct mse_workqueue {
 	struct task_struct *tsk;
 };
 
+/** @brief RX channel of network adapter shared by instances */
+struct mse_rx_channel {
+	struct list_head list;
+	/** @brief network adapter ops and device */
+	struct mse_adapter_network_ops *network;
+	char dev_name[MSE_NAME_LEN_MAX + 1];
+	int index_network;
+	/** @brief number of opened and started streams */
+	int num_streams;
+	int num_running;
+	/** @brief lock for start and stop */
+	struct mutex lock;
+
+	/** @brief packet buffer associated with network adapter */
+	struct mse_packet_ctrl *packet_buffer;
+	bool f_prepared;
+	/** @brief streams looked up by stream ID */
+	struct mse_packet_demux demux;
+	/** @brief stream owning packet buffer when not rx_shared */
+	struct mse_rx_stream *direct;
+
+	/** @brief receive queue */
+	bool f_receiving;
+	struct kthread_work wk_receive;
+	struct mse_workqueue wq_receive;
+};
+
+/** @brief stream of instance in RX channel */
+struct mse_rx_stream {
+	struct mse_packet_demux_entry entry;
+	bool f_running;
+	/** @brief work queued when packets are dispatched */
+	struct mse_workqueue *wq;
+	struct kthread_work *work;
+};
+
 /** @brief instance by related adapter */
 struct mse_instance {
 	/** @brief wait for streaming stop */
@@ -306,6 +352,12 @@ struct mse_instance {
 	int index_network;
 	int index_packetizer;
 
+	/** @brief RX channels and streams in them */
+	struct mse_rx_channel *rx_channel;
+	struct mse_rx_stream rx_stream;
+	struct mse_rx_channel *crf_rx_channel;
+	struct mse_rx_stream crf_rx_stream;
+
 	/** @brief media adapter info */
 	struct mse_adapter *media;
 	/** @brief network adapter ops */
@@ -332,6 +384,8 @@ struct mse_instance {
 	struct kthread_work wk_start_trans;
 	/** @brief stop streaming queue */
 	struct kthread_work wk_stop_streaming;
+	/** @brief reap queue of packets left in flight after stop */
+	struct kthread_work wk_reap;
 
 	/** @brief stream workqueue */
 	struct mse_workqueue wq_stream;
@@ -344,11 +398,19 @@ struct mse_instance {
 
 	/** @brief wait queue for streaming */
 	wait_queue_head_t wait_wk_stream;
+	/** @brief packetize is parked until packets are sent */
+	atomic_t packetize_parked;
+	/** @brief callback is parked until zero copy packets complete */
+	atomic_t callback_parked;
 
 	/** @brief spin lock for buffer list */
 	spinlock_t lock_buf_list;
 	/** @brief array of transmission buffer */
 	struct mse_trans_buffer trans_buffer[MSE_TRANS_BUF_NUM];
+	/** @brief transmission buffer in completion callback */
+	struct mse_trans_buffer *buf_completing;
+	/** @brief NAL index array of transmission buffers */
+	struct mse_nal_index *nal_index;
 	/** @brief list of transmission buffer is not completed */
 	struct list_head trans_buf_list;
 	/** @brief list of transmission buffer for core processing */
@@ -357,6 +419,8 @@ struct mse_instance {
 	struct list_head wait_buf_list;
 	/** @brief list of transmission buffer for processing done */
 	struct list_head done_buf_list;
+	/** @brief list of transmission buffer referred by zero copy packets */
+	struct list_head sent_buf_list;
 	/** @brief index of transmission buffer array */
 	int trans_idx;
 	/** @brief count of buffers is not completed */
@@ -408,6 +472,16 @@ struct mse_instance {
 
 	/** @brief packet buffer */
 	struct mse_packet_ctrl *packet_buffer;
+	/** @brief number of packets in packet buffer */
+	int ring_size;
+	/** @brief max number of packets per send/receive */
+	int burst;
+	/** @brief packets held for send until batch or deadline */
+	int tx_batch_packets;
+	u32 tx_batch_guard_ns;
+	struct hrtimer batch_timer;
+	/** @brief count of batches sent by deadline */
+	u32 tx_batch_deadline;
 	/** @brief array of wait packet */
 	struct mse_wait_packet *wait_packet;
 	/** @brief index of wait packet array */
@@ -421,6 +495,8 @@ struct mse_instance {
 	int avtp_timestamps_current;
 	/** @brief stopping streaming flag */
 	bool f_stopping;
+	/** @brief packets in flight are kept after stop */
+	bool f_inflight_kept;
 	/** @brief continue streaming flag */
 	bool f_continue;
 	bool f_depacketizing;
@@ -465,6 +541,7 @@ struct mse_instance {
 	bool f_get_first_packet;
 
 	/** @brief packet buffer */
+	struct mse_packet_buffer_config packet_buffer_config;
 	int crf_index_network;
 	struct mse_packet_ctrl *crf_packet_buffer;
 	bool f_crf_sending;
@@ -517,6 +594,10 @@ struct mse_device {
 	struct mse_instance *instance_table[MSE_INSTANCE_MAX];
 	struct mse_ptp_ops *ptp_table[MSE_PTP_MAX];
 	struct mch_ops *mch_table[MSE_MCH_MAX];
+
+	/** @brief RX channels of network adapters */
+	struct list_head rx_channel_list;
+	struct mutex lock_rx_channel;
 };
 
 struct mse_instance_dummy {
@@ -783,6 +864,13 @@ static inline bool mse_is_buffer_empty(struct mse_instance *instance)
 	return !atomic_read(&instance->trans_buf_cnt);
 }
 
+/* packets may refer to media buffer until they are sent */
+static inline bool mse_is_zero_copy(struct mse_instance *instance)
+{
+	return instance->tx && instance->packet_buffer_config.zero_copy &&
+	       instance->packetizer->packetize_sg;
+}
+
 static bool compare_pcr(u64 a, u64 b)
 {
 	u64 diff;
@@ -891,6 +979,8 @@ static void mse_get_default_config(struct mse_instance *instance,
 	else
 		instance->delay_time_ns = delay_time.rx_delay_time_ns;
 
+	instance->packet_buffer_config = media->config.packet_buffer_config;
+
 	switch (media->type) {
 	case MSE_TYPE_ADAPTER_VIDEO:
 		video_config = media->config.media_video_config;
@@ -1135,6 +1225,28 @@ static void mse_trans_complete(struct mse_instance *instance,
 
 		mse_debug("total processed=%zu\n", instance->processed);
 		atomic_dec(&instance->trans_buf_cnt);
+		instance->buf_completing = buf;
+		callback_completion(buf, size);
+		instance->buf_completing = NULL;
+	}
+}
+
+/*
+ * Zero copy buffers are freed only after network adapter completes their
+ * packets, unless it is released and no packet is in flight anymore.
+ */
+static void mse_free_sent_trans_buffers(struct mse_instance *instance,
+					int size,
+					bool released)
+{
+	struct mse_trans_buffer *buf, *buf1;
+
+	list_for_each_entry_safe(buf, buf1, &instance->sent_buf_list, list) {
+		if (!released &&
+		    !mse_packet_ctrl_is_completed(instance->packet_buffer,
+						  buf->packet_end))
+			break;
+
 		callback_completion(buf, size);
 	}
 }
@@ -1148,9 +1260,12 @@ static void mse_free_all_trans_buffers(struct mse_instance *instance, int size)
 		callback_completion(buf, size);
 	list_for_each_entry_safe(buf, buf1, &instance->wait_buf_list, list)
 		callback_completion(buf, size);
+	mse_free_sent_trans_buffers(instance, size, false);
 	list_for_each_entry_safe(buf, buf1, &instance->proc_buf_list, list)
 		callback_completion(buf, size);
 	atomic_set(&instance->done_buf_cnt, 0);
+	atomic_set(&instance->packetize_parked, 0);
+	atomic_set(&instance->callback_parked, 0);
 
 	/* free all buf from TRANS buf list */
 	list_for_each_entry_safe(buf, buf1, &instance->trans_buf_list, list)
@@ -1163,6 +1278,408 @@ static void mse_free_all_trans_buffers(struct mse_instance *instance, int size)
 #define mse_flush_workqueue(_q) kthread_flush_worker(&(_q).wrk)
 #define mse_destroy_workqueue(_q) kthread_stop((_q).tsk)
 
+static int mse_create_workqueue(struct mse_workqueue *wrk, const char *name)
+{
+	kthread_init_worker(&wrk->wrk);
+	wrk->tsk = kthread_run(kthread_worker_fn, &wrk->wrk, "%s", name);
+	if (IS_ERR(wrk->tsk)) {
+		int err = PTR_ERR(wrk->tsk);
+		/* set to NULL for easier ptr check in cleanup path */
+		wrk->tsk = NULL;
+		return err;
+	}
+
+	/* rt priority needed? */
+	if (avb_rt_prio > 0) {
+		if (avb_rt_prio > (MAX_RT_PRIO - 1)) {
+			mse_warn("limit avb_rt_prio val %d to maximum %d\n",
+				 avb_rt_prio, MAX_RT_PRIO - 1);
+			avb_rt_prio = MAX_RT_PRIO - 1;
+		}
+		if (avb_rt_prio >= (MAX_RT_PRIO / 2))
+			sched_set_fifo(wrk->tsk);
+		else
+			sched_set_fifo_low(wrk->tsk);
+	}
+	return 0;
+}
+
+/*
+ * RX channel functions
+ *
+ * Each RX instance owns a packet buffer which is filled by the RX channel
+ * it belongs to. The channel of a device which is rx_shared receives
+ * packets into its own packet buffer and dispatches them by stream ID, so
+ * it can feed several instances. The packet buffers of these instances are
+ * local. Otherwise the device is filtered by stream ID and the channel
+ * receives directly into the packet buffer of its only instance.
+ */
+static void mse_rx_stream_notify(struct mse_packet_demux_entry *entry)
+{
+	struct mse_rx_stream *stream;
+
+	stream = container_of(entry, struct mse_rx_stream, entry);
+	mse_queue_work(*stream->wq, stream->work);
+}
+
+static void mse_work_rx_channel(struct kthread_work *work)
+{
+	struct mse_rx_channel *channel;
+	int err;
+
+	channel = container_of(work, struct mse_rx_channel, wk_receive);
+
+	mse_debug("START %s\n", channel->dev_name);
+
+	while (READ_ONCE(channel->f_receiving)) {
+		/* request receive packet */
+		err = mse_packet_ctrl_receive_packet(
+			channel->index_network,
+			channel->packet_buffer->burst,
+			channel->packet_buffer,
+			channel->network);
+		if (err < 0) {
+			/* network adapter is canceled at stop */
+			if (READ_ONCE(channel->f_receiving))
+				mse_err("receive error %d\n", err);
+			break;
+		}
+
+		if (!channel->direct) {
+			/* dispatch to instances, it queues depacketize */
+			mse_packet_ctrl_demux_packet(channel->packet_buffer,
+						     &channel->demux);
+		} else if (err > 0 && READ_ONCE(channel->direct->f_running)) {
+			mse_rx_stream_notify(&channel->direct->entry);
+		}
+	}
+
+	mse_debug("END %s\n", channel->dev_name);
+}
+
+static int mse_rx_channel_start(struct mse_rx_channel *channel,
+				struct mse_rx_stream *stream)
+{
+	struct mse_packet_ctrl *packet_buffer = channel->packet_buffer;
+	int ret = 0;
+
+	if (READ_ONCE(stream->f_running))
+		return 0;
+
+	mutex_lock(&channel->lock);
+
+	if (stream->f_running)
+		goto out;
+
+	if (!channel->num_running) {
+		/* slots stay queued to network adapter until release */
+		if (!channel->f_prepared) {
+			ret = mse_packet_ctrl_attach(packet_buffer);
+			if (ret)
+				goto out;
+
+			ret = mse_packet_ctrl_receive_prepare_packet(
+				channel->index_network,
+				packet_buffer,
+				channel->network);
+			if (ret) {
+				mse_packet_ctrl_detach(packet_buffer);
+				mse_err("packet buffer associate error, ret=%d\n",
+					ret);
+				goto out;
+			}
+			channel->f_prepared = true;
+		} else if (channel->direct) {
+			/* drop packets received before last stop */
+			mse_packet_ctrl_discard_packet(packet_buffer);
+		}
+
+		WRITE_ONCE(channel->f_receiving, true);
+		mse_queue_work(channel->wq_receive, &channel->wk_receive);
+	}
+
+	mse_packet_ctrl_demux_enable(&channel->demux, &stream->entry, true);
+	channel->num_running++;
+	WRITE_ONCE(stream->f_running, true);
+
+out:
+	mutex_unlock(&channel->lock);
+
+	return ret;
+}
+
+static void mse_rx_channel_stop(struct mse_rx_channel *channel,
+				struct mse_rx_stream *stream)
+{
+	int ret;
+
+	mutex_lock(&channel->lock);
+
+	if (!stream->f_running)
+		goto out;
+
+	/* no more packets are stored into packet buffer of the stream */
+	mse_packet_ctrl_demux_enable(&channel->demux, &stream->entry, false);
+	WRITE_ONCE(stream->f_running, false);
+
+	if (!--channel->num_running) {
+		WRITE_ONCE(channel->f_receiving, false);
+		ret = channel->network->cancel(channel->index_network);
+		if (ret)
+			mse_err("failed network adapter cancel() ret=%d\n",
+				ret);
+
+		mse_flush_work(&channel->wk_receive);
+	}
+
+out:
+	mutex_unlock(&channel->lock);
+}
+
+static int mse_rx_channel_set_streamid(struct mse_rx_channel *channel,
+				       struct mse_rx_stream *stream,
+				       u8 streamid[8])
+{
+	int ret = 0;
+
+	mse_packet_ctrl_demux_set_streamid(&channel->demux,
+					   &stream->entry,
+					   streamid);
+
+	/* the device of shared channel is not filtered by one stream */
+	if (!channel->network->rx_shared)
+		ret = channel->network->set_streamid(channel->index_network,
+						     streamid);
+
+	return ret;
+}
+
+/* get RX channel of the device, the network adapter is opened if needed */
+static struct mse_rx_channel *mse_rx_channel_get(
+	struct mse_adapter_network_ops *network,
+	const char *dev_name,
+	struct mse_packet_buffer_config *config)
+{
+	struct mse_rx_channel *channel;
+	char name[MSE_NAME_LEN_MAX + 1];
+	int ret;
+
+	mutex_lock(&mse->lock_rx_channel);
+
+	list_for_each_entry(channel, &mse->rx_channel_list, list) {
+		if (network->rx_shared && channel->network == network &&
+		    !mse_compare_param_key(channel->dev_name,
+					   (char *)dev_name)) {
+			channel->num_streams++;
+			goto out;
+		}
+	}
+
+	channel = kzalloc(sizeof(*channel), GFP_KERNEL);
+	if (!channel) {
+		channel = ERR_PTR(-ENOMEM);
+		goto out;
+	}
+
+	ret = network->open((char *)dev_name);
+	if (ret < 0) {
+		mse_err("cannot open network adapter ret=%d\n", ret);
+		goto error_open;
+	}
+
+	channel->network = network;
+	channel->index_network = ret;
+	mse_name_strlcpy(channel->dev_name, dev_name);
+	mutex_init(&channel->lock);
+	mse_packet_ctrl_demux_init(&channel->demux);
+	kthread_init_work(&channel->wk_receive, mse_work_rx_channel);
+
+	/* packets of all the streams are received into this buffer */
+	if (network->rx_shared) {
+		channel->packet_buffer = mse_packet_ctrl_alloc(
+			&mse->pdev->dev,
+			config->rx_ring_size,
+			MSE_PACKET_SIZE_MAX,
+			config,
+			false);
+		if (!channel->packet_buffer) {
+			ret = -ENOMEM;
+			goto error_alloc;
+		}
+	}
+
+	snprintf(name, sizeof(name), "mse_rx_%s", channel->dev_name);
+	ret = mse_create_workqueue(&channel->wq_receive, name);
+	if (ret)
+		goto error_create_wq;
+
+	channel->num_streams = 1;
+	list_add_tail(&channel->list, &mse->rx_channel_list);
+
+out:
+	mutex_unlock(&mse->lock_rx_channel);
+
+	return channel;
+
+error_create_wq:
+	mse_packet_ctrl_free(channel->packet_buffer);
+error_alloc:
+	network->release(channel->index_network);
+error_open:
+	kfree(channel);
+	mutex_unlock(&mse->lock_rx_channel);
+
+	return ERR_PTR(ret);
+}
+
+/* put RX channel, the network adapter is released by the last stream */
+static void mse_rx_channel_put(struct mse_rx_channel *channel,
+			       struct mse_rx_stream *stream)
+{
+	mse_rx_channel_stop(channel, stream);
+	mse_packet_ctrl_demux_del(&channel->demux, &stream->entry);
+
+	mutex_lock(&mse->lock_rx_channel);
+
+	if (--channel->num_streams) {
+		mutex_unlock(&mse->lock_rx_channel);
+		return;
+	}
+
+	list_del(&channel->list);
+	mutex_unlock(&mse->lock_rx_channel);
+
+	mse_flush_workqueue(channel->wq_receive);
+	mse_destroy_workqueue(channel->wq_receive);
+
+	channel->network->release(channel->index_network);
+
+	/* packet buffer of direct stream is freed by its instance */
+	if (!channel->direct)
+		mse_packet_ctrl_free(channel->packet_buffer);
+	kfree(channel);
+}
+
+/* packet buffer of the stream is owned by RX channel while it is added */
+static bool mse_rx_channel_is_direct(struct mse_rx_channel *channel)
+{
+	return channel && channel->direct;
+}
+
+/* add stream of instance to RX channel */
+static void mse_rx_channel_add(struct mse_rx_channel *channel,
+			       struct mse_rx_stream *stream,
+			       struct mse_packet_ctrl *packet_buffer,
+			       struct mse_workqueue *wq,
+			       struct kthread_work *work)
+{
+	stream->wq = wq;
+	stream->work = work;
+	stream->f_running = false;
+	stream->entry.notify = mse_rx_stream_notify;
+	mse_packet_ctrl_demux_add(&channel->demux, &stream->entry,
+				  packet_buffer);
+
+	/* only stream of the device filtered by stream ID, no demux */
+	if (!channel->network->rx_shared) {
+		channel->packet_buffer = packet_buffer;
+		channel->direct = stream;
+	} else {
+		mse_packet_ctrl_set_local(packet_buffer);
+	}
+}
+
+/*
+ * Packets are held until tx_batch_packets are queued or the AVTP
+ * presentation time of the oldest one minus guard time is reached.
+ * Otherwise batch timer is started for the deadline.
+ */
+static bool mse_tx_batch_ready(struct mse_instance *instance)
+{
+	struct mse_packet_ctrl *packet_buffer = instance->packet_buffer;
+	int queued;
+	u32 timestamp;
+	u64 now;
+	s32 remain;
+
+	queued = mse_packet_ctrl_check_packet_unsent(packet_buffer);
+	if (!queued)
+		return false;
+
+	if (queued >= instance->tx_batch_packets ||
+	    mse_state_test(instance, MSE_STATE_STOPPING))
+		return true;
+
+	/* packet without presentation time is not held */
+	if (!mse_packet_ctrl_get_head_timestamp(packet_buffer, &timestamp))
+		return true;
+
+	if (mse_ptp_get_time(instance->ptp_index, &now) < 0)
+		return true;
+
+	remain = PTP_TIME_DIFF_S32(timestamp, now) -
+		 (s32)instance->tx_batch_guard_ns;
+	if (remain <= 0) {
+		instance->tx_batch_deadline++;
+		return true;
+	}
+
+	hrtimer_start(&instance->batch_timer, ns_to_ktime(remain),
+		      HRTIMER_MODE_REL);
+
+	return false;
+}
+
+/*
+ * Requeue works parked on the packet buffer after slots are released,
+ * packetize only once a burst of slots is free.
+ */
+static void mse_resume_packet_waiters(struct mse_instance *instance)
+{
+	int wait_count = instance->ring_size - instance->burst;
+
+	/* order release of slots before test of parked flags */
+	smp_mb();
+
+	if (atomic_read(&instance->callback_parked) &&
+	    atomic_xchg(&instance->callback_parked, 0))
+		mse_queue_work(instance->wq_packet, &instance->wk_callback);
+
+	if (!atomic_read(&instance->packetize_parked) ||
+	    mse_packet_ctrl_check_packet_remain(instance->packet_buffer) >=
+	    wait_count)
+		return;
+
+	if (atomic_xchg(&instance->packetize_parked, 0))
+		mse_queue_work(instance->wq_packet, &instance->wk_packetize);
+}
+
+/* take back packets completed by network adapter */
+static void mse_reap_packets(struct mse_instance *instance)
+{
+	int err;
+
+	err = mse_packet_ctrl_reap_packet(instance->index_network,
+					  instance->packet_buffer,
+					  instance->network);
+	if (err < 0)
+		mse_err("reap error %d\n", err);
+	else if (err > 0)
+		mse_resume_packet_waiters(instance);
+}
+
+/* network adapter does not notify completion, poll it by batch timer */
+static void mse_poll_packets_inflight(struct mse_instance *instance)
+{
+	if (!mse_packet_ctrl_check_packet_inflight(instance->packet_buffer))
+		return;
+
+	if (!hrtimer_active(&instance->batch_timer))
+		hrtimer_start(&instance->batch_timer,
+			      ns_to_ktime(MSE_REAP_INTERVAL_US * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+}
+
 static void mse_work_stream_common(struct mse_instance *instance)
 {
 	int index_network;
@@ -1187,8 +1704,10 @@ static void mse_work_stream_common(struct mse_instance *instance)
 	network = instance->network;
 
 	if (instance->tx) {
-		/* while data is remained */
-		do {
+		mse_reap_packets(instance);
+
+		/* while batch of data is remained */
+		while (mse_tx_batch_ready(instance)) {
 			/* request send packet */
 			err = mse_packet_ctrl_send_packet(index_network,
 							  packet_buffer,
@@ -1199,30 +1718,18 @@ static void mse_work_stream_common(struct mse_instance *instance)
 				break;
 			}
 
-			wake_up_interruptible(&instance->wait_wk_stream);
-		} while (mse_packet_ctrl_check_packet_remain(packet_buffer));
-	} else {
-		/* while state is RUNNABLE */
-		while (mse_state_test(instance, MSE_STATE_RUNNABLE)) {
-			/* request receive packet */
-			err = mse_packet_ctrl_receive_packet(
-				index_network,
-				MSE_RX_PACKET_NUM,
-				packet_buffer,
-				network);
-
-			if (err < 0) {
-				mse_err("receive error %d\n", err);
-				break;
-			}
-
-			/* process depacketize */
-			mse_queue_work(instance->wq_packet, &instance->wk_depacketize);
+			/* send also releases completed packets */
+			if (err > 0)
+				mse_resume_packet_waiters(instance);
 		}
 
-		/* process depacketize to process last data */
-		if (mse_state_test(instance, MSE_STATE_STOPPING))
-			mse_queue_work(instance->wq_packet, &instance->wk_depacketize);
+		mse_poll_packets_inflight(instance);
+	} else if (mse_state_test(instance, MSE_STATE_RUNNABLE)) {
+		/* RX channel receives packets and queues depacketize */
+		err = mse_rx_channel_start(instance->rx_channel,
+					   &instance->rx_stream);
+		if (err < 0)
+			mse_err("receive start error %d\n", err);
 	}
 
 	write_lock_irqsave(&instance->lock_stream, flags);
@@ -1256,6 +1763,8 @@ static void mse_work_stream_mpeg2ts_tx(struct mse_instance *instance)
 	packet_buffer = instance->packet_buffer;
 	network = instance->network;
 
+	mse_reap_packets(instance);
+
 	/* while data is remained */
 	do {
 		/* request send packet */
@@ -1267,9 +1776,16 @@ static void mse_work_stream_mpeg2ts_tx(struct mse_instance *instance)
 			break;
 		}
 
-		wake_up_interruptible(&instance->wait_wk_stream);
+		/* send also releases completed packets */
+		if (err > 0)
+			mse_resume_packet_waiters(instance);
 	} while (mse_packet_ctrl_check_packet_remain_wait(packet_buffer));
 
+	mse_poll_packets_inflight(instance);
+
+	/* stop work waits for all packets completed */
+	wake_up_interruptible(&instance->wait_wk_stream);
+
 	write_lock_irqsave(&instance->lock_stream, flags);
 	instance->f_streaming = false;
 	mse_debug_state(instance);
@@ -1991,6 +2507,37 @@ static int create_avtp_timestamps(struct mse_instance *instance)
 	return 0;
 }
 
+/*
+ * Fit slots of TX packet buffer to the packet size reported by packetizer.
+ * It is called while stream is not started, so packet buffer has no memory.
+ */
+static int mse_fit_packet_buffer(struct mse_packet_ctrl *packet_buffer,
+				 struct mse_packetizer_ops *packetizer,
+				 int index_packetizer)
+{
+	struct mse_audio_info info;
+	int packet_size;
+	int ret;
+
+	if (!packetizer->get_audio_info)
+		return 0;
+
+	ret = packetizer->get_audio_info(index_packetizer, &info);
+	if (ret < 0)
+		return ret;
+
+	/* keep slots cache line aligned for streaming DMA sync */
+	packet_size = max_t(int, info.avtp_packet_size, AVTP_FRAME_SIZE_MIN);
+	packet_size = ALIGN(packet_size, dma_get_cache_alignment());
+	if (packet_size > MSE_PACKET_SIZE_MAX)
+		packet_size = MSE_PACKET_SIZE_MAX;
+
+	mse_debug("packet size %d -> %d\n",
+		  mse_packet_ctrl_packet_size(packet_buffer), packet_size);
+
+	return mse_packet_ctrl_set_packet_size(packet_buffer, packet_size);
+}
+
 static int mse_initialize_crf_packetizer(struct mse_instance *instance)
 {
 	struct mse_packetizer_ops *crf =
@@ -2032,11 +2579,18 @@ static int mse_initialize_crf_packetizer(struct mse_instance *instance)
 			mse_err("cbs param set error, ret=%d\n", ret);
 			return ret;
 		}
+
+		ret = mse_fit_packet_buffer(instance->crf_packet_buffer,
+					    crf,
+					    instance->crf_index);
+		if (ret < 0)
+			return ret;
 	}
 
 	if (instance->crf_type == MSE_CRF_TYPE_RX) {
-		ret = instance->network->set_streamid(
-					instance->crf_index_network,
+		ret = mse_rx_channel_set_streamid(
+					instance->crf_rx_channel,
+					&instance->crf_rx_stream,
 					instance->crf_net_config.streamid);
 		if (ret < 0) {
 			mse_err("stream id set error, ret=%d\n", ret);
@@ -2096,7 +2650,7 @@ static int mse_open_crf_packetizer(struct mse_instance *instance)
 
 static bool check_packet_remain(struct mse_instance *instance)
 {
-	int wait_count = MSE_TX_RING_SIZE - MSE_TX_PACKET_NUM;
+	int wait_count = instance->ring_size - instance->burst;
 	int rem = mse_packet_ctrl_check_packet_remain(instance->packet_buffer);
 	struct mse_wait_packet *wp0, *wp1;
 	u32 accum_wait_time;
@@ -2127,6 +2681,80 @@ static bool check_packet_remain(struct mse_instance *instance)
 		return wait_count > rem;
 }
 
+/*
+ * Packetize never sleeps on a full packet buffer. It parks instead and
+ * returns, leaving the buffer at the head of proc_buf_list; the stream
+ * work requeues it once send has released slots.
+ */
+static bool mse_park_packetize(struct mse_instance *instance)
+{
+	unsigned long flags;
+
+	if (check_packet_remain(instance))
+		return false;
+
+	atomic_set(&instance->packetize_parked, 1);
+	smp_mb();
+
+	/* slots may have been released before parked was visible */
+	if (check_packet_remain(instance)) {
+		atomic_set(&instance->packetize_parked, 0);
+		return false;
+	}
+
+	read_lock_irqsave(&instance->lock_stream, flags);
+	if (!instance->f_streaming)
+		mse_queue_work(instance->wq_stream, &instance->wk_stream);
+	read_unlock_irqrestore(&instance->lock_stream, flags);
+
+	mse_debug("packetize parked\n");
+
+	return true;
+}
+
+/*
+ * Zero copy packets refer to the media buffer until network adapter
+ * completes them. The buffer waits in sent_buf_list with the position
+ * after its last packet, and the next buffer is packetized meanwhile.
+ */
+static void mse_trans_zero_copy_sent(struct mse_instance *instance,
+				     struct mse_trans_buffer *buf,
+				     int size)
+{
+	buf->packet_end = mse_packet_ctrl_write_pos(instance->packet_buffer);
+	buf->work_length = size;
+	list_move_tail(&buf->list, &instance->sent_buf_list);
+
+	if (!list_empty(&instance->proc_buf_list))
+		mse_queue_work(instance->wq_packet, &instance->wk_packetize);
+}
+
+/* packets not sent are dropped, sent buffers wait for the rest only */
+static void mse_trans_zero_copy_drop(struct mse_instance *instance)
+{
+	unsigned int write_p;
+	struct mse_trans_buffer *buf;
+
+	write_p = mse_packet_ctrl_write_pos(instance->packet_buffer);
+	list_for_each_entry(buf, &instance->sent_buf_list, list) {
+		if ((int)(buf->packet_end - write_p) > 0)
+			buf->packet_end = write_p;
+	}
+}
+
+/* complete TX buffer, zero copy one is completed by callback later */
+static void mse_trans_complete_packetized(struct mse_instance *instance,
+					  struct mse_trans_buffer *buf,
+					  int size)
+{
+	if (mse_is_zero_copy(instance)) {
+		mse_trans_zero_copy_sent(instance, buf, size);
+		mse_queue_work(instance->wq_packet, &instance->wk_callback);
+	} else {
+		mse_trans_complete(instance, &instance->proc_buf_list, size);
+	}
+}
+
 static void mse_work_packetize_common(struct mse_instance *instance)
 {
 	int ret = 0;
@@ -2155,6 +2783,12 @@ static void mse_work_packetize_common(struct mse_instance *instance)
 	if (trans_size <= 0) /* no data to process */
 		return;
 
+	/* hand marker offsets found by media adapter to packetizer */
+	if (!buf->work_length && instance->packetizer->set_jpeg_markers)
+		instance->packetizer->set_jpeg_markers(
+			instance->index_packetizer,
+			buf->jpeg_markers.eoi_offset ? &buf->jpeg_markers : NULL);
+
 	/* make AVTP packet with one timestamp */
 	if (!IS_MSE_TYPE_AUDIO(instance->media->type)) {
 		instance->avtp_timestamps_current = 0;
@@ -2166,21 +2800,9 @@ static void mse_work_packetize_common(struct mse_instance *instance)
 	while (buf->work_length < buf->buffer_size) {
 		/* state is EXECUTE */
 		if (mse_state_test(instance, MSE_STATE_EXECUTE)) {
-			/* wait for packet buffer processed */
-			if (!check_packet_remain(instance)) {
-				read_lock_irqsave(&instance->lock_stream,
-						  flags);
-				if (!instance->f_streaming)
-					mse_queue_work(instance->wq_stream, &instance->wk_stream);
-				read_unlock_irqrestore(&instance->lock_stream,
-						       flags);
-
-				if (!wait_event_interruptible_timeout(
-						instance->wait_wk_stream,
-						check_packet_remain(instance),
-						MSE_TIMEOUT_PACKETIZE))
-					mse_debug("wait event timeouted\n");
-			}
+			/* park until stream work releases slots */
+			if (mse_park_packetize(instance))
+				return;
 		}
 
 		ret = mse_packet_ctrl_make_packet(
@@ -2230,9 +2852,7 @@ static void mse_work_packetize_common(struct mse_instance *instance)
 							flags);
 			}
 
-			mse_trans_complete(instance,
-					   &instance->proc_buf_list,
-					   ret);
+			mse_trans_complete_packetized(instance, buf, ret);
 
 			return;
 		}
@@ -2240,7 +2860,7 @@ static void mse_work_packetize_common(struct mse_instance *instance)
 		mse_err("error=%d buffer may be corrupted\n", ret);
 		instance->f_continue = false;
 
-		mse_trans_complete(instance, &instance->proc_buf_list, ret);
+		mse_trans_complete_packetized(instance, buf, ret);
 
 		/* state is STOPPING */
 		if (mse_state_test(instance, MSE_STATE_STOPPING)) {
@@ -2259,6 +2879,10 @@ static void mse_work_packetize_common(struct mse_instance *instance)
 	if (instance->f_continue) {
 		mse_queue_work(instance->wq_packet, &instance->wk_packetize);
 	} else {
+		if (mse_is_zero_copy(instance))
+			mse_trans_zero_copy_sent(instance, buf,
+						 buf->work_length);
+
 		if (!instance->timer_interval)
 			atomic_inc(&instance->done_buf_cnt);
 
@@ -2603,7 +3227,7 @@ static void mse_update_wait_packet(struct mse_instance *instance,
 	wp->launch_avtp_timestamp = timestamp;
 
 	list_add_tail(&wp->list, &instance->wait_packet_list);
-	instance->wait_packet_idx = (instance->wait_packet_idx + 1) % MSE_TX_RING_SIZE;
+	instance->wait_packet_idx = (instance->wait_packet_idx + 1) % instance->ring_size;
 }
 
 static void mse_control_wait_packet(struct mse_instance *instance,
@@ -2702,7 +3326,6 @@ static void mse_work_packetize_mpeg2ts_tx(struct mse_instance *instance)
 {
 	struct mse_trans_buffer *buf;
 	size_t piece_length = 0;
-	unsigned long flags;
 	size_t buffer_size;
 	int trans_size;
 	int ret = 0;
@@ -2763,23 +3386,9 @@ static void mse_work_packetize_mpeg2ts_tx(struct mse_instance *instance)
 	while (buf->work_length < buffer_size) {
 		/* state is EXECUTE */
 		if (mse_state_test(instance, MSE_STATE_EXECUTE)) {
-			/* wait for packet buffer processed */
-			if (!check_packet_remain(instance)) {
-				read_lock_irqsave(&instance->lock_stream,
-						  flags);
-				if (!instance->f_streaming)
-					mse_queue_work(instance->wq_stream, &instance->wk_stream);
-				read_unlock_irqrestore(&instance->lock_stream,
-						       flags);
-
-				if (!wait_event_interruptible_timeout(
-						instance->wait_wk_stream,
-						check_packet_remain(instance),
-						MSE_TIMEOUT_PACKETIZE_MPEG2TS)) {
-					mse_debug("wait event timeouted\n");
-					break;
-				}
-			}
+			/* park until stream work releases slots */
+			if (mse_park_packetize(instance))
+				return;
 		}
 
 		ret = do_packetize_mpeg2ts_tx(instance,
@@ -3052,7 +3661,7 @@ static bool mse_check_buffer_starvation(struct mse_instance *instance)
 
 	/* Exists still available space in receive buffer */
 	remain = mse_packet_ctrl_check_packet_remain(instance->packet_buffer);
-	if (remain > MSE_RX_PACKET_NUM_MAX)
+	if (remain > instance->ring_size / 2)
 		return false;
 
 	mse_debug("Insufficient free buffer.\n");
@@ -3116,6 +3725,9 @@ static bool do_depacketize_video_rx(struct mse_instance *instance, struct mse_tr
 	unsigned long flags;
 	int ret = 0;
 
+	if (buf->nal_index)
+		buf->nal_index->num = 0;
+
 	/* get AVTP packet payload */
 	ret = mse_packet_ctrl_take_out_packet(instance->index_packetizer,
 					      buf->buffer,
@@ -3140,6 +3752,10 @@ static bool do_depacketize_video_rx(struct mse_instance *instance, struct mse_tr
 		 * Here we use the output timestamp.
 		 */
 		launch_avtp_timestamp = (u32)(timestamps[0] + instance->delay_time_ns);
+
+		if (buf->nal_index)
+			instance->packetizer->get_nal_index(
+				instance->index_packetizer, buf->nal_index);
 	} else if (ret == -EAGAIN && !mse_state_test(instance, MSE_STATE_STOPPING)) {
 		/* no process data, wait next receive */
 		return false;
@@ -3521,6 +4137,66 @@ static void mse_work_callback_mpeg2ts_tx(struct mse_instance *instance)
 	write_unlock_irqrestore(&instance->lock_state, flags);
 }
 
+/*
+ * Complete zero copy buffers in order, each one only after network
+ * adapter has completed the last packet referring to it. Otherwise the
+ * callback parks until stream work releases packets.
+ */
+static void mse_work_callback_zero_copy_tx(struct mse_instance *instance)
+{
+	struct mse_packet_ctrl *packet_buffer = instance->packet_buffer;
+	struct mse_trans_buffer *buf;
+	unsigned long flags;
+	int size;
+
+	/* state is NOT RUNNING */
+	if (!mse_state_test(instance, MSE_STATE_RUNNING)) {
+		mse_err("instance state is not RUNNING\n");
+		return; /* skip work */
+	}
+
+	mse_debug_state(instance);
+
+	while ((buf = list_first_entry_or_null(&instance->sent_buf_list,
+					       struct mse_trans_buffer,
+					       list))) {
+		if (!mse_packet_ctrl_is_completed(packet_buffer,
+						  buf->packet_end)) {
+			atomic_set(&instance->callback_parked, 1);
+			smp_mb();
+
+			/* packets may have been released meanwhile */
+			if (!mse_packet_ctrl_is_completed(packet_buffer,
+							  buf->packet_end))
+				return;
+
+			atomic_set(&instance->callback_parked, 0);
+		}
+
+		/* packetized buffer is output by done_buf_cnt timing */
+		size = (int)buf->work_length;
+		if (size >= 0 && !atomic_dec_not_zero(&instance->done_buf_cnt))
+			return;
+
+		mse_trans_complete(instance, &instance->sent_buf_list, size);
+	}
+
+	write_lock_irqsave(&instance->lock_state, flags);
+
+	if (mse_is_buffer_empty(instance)) {
+		/* state is STOPPING */
+		if (mse_state_test_nolock(instance, MSE_STATE_STOPPING)) {
+			mse_queue_work(instance->wq_packet, &instance->wk_stop_streaming);
+		} else {
+			/* if state is EXECUTE, change to IDLE */
+			mse_state_change_if(instance, MSE_STATE_IDLE,
+					    MSE_STATE_EXECUTE);
+		}
+	}
+
+	write_unlock_irqrestore(&instance->lock_state, flags);
+}
+
 static void mse_work_callback(struct kthread_work *work)
 {
 	struct mse_instance *instance;
@@ -3529,21 +4205,189 @@ static void mse_work_callback(struct kthread_work *work)
 
 	mse_debug("START\n");
 
-	if (instance->tx)
-		if (IS_MSE_TYPE_MPEG2TS(instance->media->type))
-			mse_work_callback_mpeg2ts_tx(instance);
-		else
-			mse_work_callback_common(instance);
-	else
-		if (IS_MSE_TYPE_VIDEO(instance->media->type))
-			mse_work_callback_video_rx(instance);
-		else
-			mse_work_callback_common(instance);
+	if (instance->tx)
+		if (IS_MSE_TYPE_MPEG2TS(instance->media->type))
+			mse_work_callback_mpeg2ts_tx(instance);
+		else if (mse_is_zero_copy(instance))
+			mse_work_callback_zero_copy_tx(instance);
+		else
+			mse_work_callback_common(instance);
+	else
+		if (IS_MSE_TYPE_VIDEO(instance->media->type))
+			mse_work_callback_video_rx(instance);
+		else
+			mse_work_callback_common(instance);
+}
+
+/*
+ * Borrow DMA memory for packet buffer and associate TX packet buffer with
+ * network adapter. RX packet buffer is filled by RX channel, it is not
+ * associated with network adapter.
+ */
+static int mse_attach_packet_buffer(struct mse_instance *instance,
+				    int index_network,
+				    struct mse_packet_ctrl *packet_buffer,
+				    bool tx)
+{
+	struct mse_adapter_network_ops *network = instance->network;
+	int ret;
+
+	if (mse_packet_ctrl_is_attached(packet_buffer))
+		return 0;
+
+	ret = mse_packet_ctrl_attach(packet_buffer);
+	if (ret) {
+		mse_err("packet buffer attach error, ret=%d\n", ret);
+		return ret;
+	}
+
+	if (!tx)
+		return 0;
+
+	/* associate packet buffer with network adapter */
+	ret = mse_packet_ctrl_send_prepare_packet(index_network,
+						  packet_buffer,
+						  network);
+	if (ret) {
+		mse_packet_ctrl_detach(packet_buffer);
+		mse_err("packet buffer associate error, ret=%d\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* wait for network adapter to complete packets in flight before drop */
+static int mse_wait_packets_inflight(struct mse_instance *instance,
+				     int index_network,
+				     struct mse_packet_ctrl *packet_buffer)
+{
+	int i, ret, inflight;
+
+	for (i = 0; i < MSE_REAP_RETRY_MAX; i++) {
+		ret = mse_packet_ctrl_reap_packet(index_network,
+						  packet_buffer,
+						  instance->network);
+		if (ret < 0) {
+			mse_err("reap error %d\n", ret);
+			return ret;
+		}
+
+		if (!mse_packet_ctrl_check_packet_inflight(packet_buffer))
+			return 0;
+
+		usleep_range(MSE_REAP_INTERVAL_US, MSE_REAP_INTERVAL_US * 2);
+	}
+
+	inflight = mse_packet_ctrl_check_packet_inflight(packet_buffer);
+	mse_err("%d packets are not completed, keep them until reaped\n",
+		inflight);
+
+	return -ETIMEDOUT;
+}
+
+/*
+ * return DMA memory of packet buffers, called while stream is stopped.
+ * It returns -EBUSY when TX packet buffer is kept for packets in flight.
+ */
+static int mse_detach_packet_buffers(struct mse_instance *instance)
+{
+	int ret = 0;
+
+	/* packet buffer of direct RX stream stays armed on its channel */
+	if (!mse_rx_channel_is_direct(instance->rx_channel))
+		ret = mse_packet_ctrl_detach(instance->packet_buffer);
+
+	if (instance->crf_packet_buffer) {
+		if (instance->crf_type == MSE_CRF_TYPE_TX)
+			mse_wait_packets_inflight(instance,
+						  instance->crf_index_network,
+						  instance->crf_packet_buffer);
+		if (!mse_rx_channel_is_direct(instance->crf_rx_channel) &&
+		    mse_packet_ctrl_detach(instance->crf_packet_buffer))
+			ret = -EBUSY;
+	}
+
+	return ret;
+}
+
+/*
+ * Packets left in flight by stop keep their payload mapped, their zero
+ * copy buffers and packet buffers until network adapter completes them.
+ */
+static int mse_release_kept_packets(struct mse_instance *instance)
+{
+	struct mse_packet_ctrl *crf_packet_buffer = instance->crf_packet_buffer;
+	int ret, busy = 0;
+
+	if (instance->tx) {
+		ret = mse_packet_ctrl_reap_packet(instance->index_network,
+						  instance->packet_buffer,
+						  instance->network);
+		if (ret < 0)
+			mse_err("reap error %d\n", ret);
+
+		mse_free_sent_trans_buffers(instance, 0, false);
+
+		if (mse_packet_ctrl_detach(instance->packet_buffer))
+			busy = -EBUSY;
+	}
+
+	if (crf_packet_buffer && instance->crf_type == MSE_CRF_TYPE_TX) {
+		ret = mse_packet_ctrl_reap_packet(instance->crf_index_network,
+						  crf_packet_buffer,
+						  instance->network);
+		if (ret < 0)
+			mse_err("reap error %d\n", ret);
+
+		if (mse_packet_ctrl_detach(crf_packet_buffer))
+			busy = -EBUSY;
+	}
+
+	return busy;
+}
+
+static int mse_attach_packet_buffers(struct mse_instance *instance)
+{
+	int ret;
+
+	ret = mse_attach_packet_buffer(instance,
+				       instance->index_network,
+				       instance->packet_buffer,
+				       instance->tx);
+	if (ret)
+		return ret;
+
+	if (instance->tx) {
+		/* pre-stamp static header into packet buffer */
+		ret = mse_packet_ctrl_prepare_packets(
+			instance->index_packetizer,
+			instance->packet_buffer,
+			instance->packetizer);
+		if (ret < 0)
+			goto error;
+	}
+
+	if (instance->crf_packet_buffer) {
+		ret = mse_attach_packet_buffer(
+			instance,
+			instance->crf_index_network,
+			instance->crf_packet_buffer,
+			instance->crf_type == MSE_CRF_TYPE_TX);
+		if (ret)
+			goto error;
+	}
+
+	return 0;
+
+error:
+	mse_detach_packet_buffers(instance);
+
+	return ret;
 }
 
 static void mse_stop_streaming_audio(struct mse_instance *instance)
 {
-	int ret;
 	enum MSE_CRF_TYPE crf_type = instance->crf_type;
 
 	/* cancel timestamp timer */
@@ -3553,11 +4397,8 @@ static void mse_stop_streaming_audio(struct mse_instance *instance)
 	hrtimer_cancel(&instance->crf_timer);
 
 	if (crf_type == MSE_CRF_TYPE_RX) {
-		ret = instance->network->cancel(
-			instance->crf_index_network);
-		if (ret)
-			mse_err("failed cancel() ret=%d\n", ret);
-
+		mse_rx_channel_stop(instance->crf_rx_channel,
+				    &instance->crf_rx_stream);
 		mse_flush_work(&instance->wk_crf_receive);
 	} else if (crf_type == MSE_CRF_TYPE_TX &&
 		   instance->f_crf_sending) {
@@ -3568,6 +4409,25 @@ static void mse_stop_streaming_audio(struct mse_instance *instance)
 		mse_flush_work(&instance->wk_timestamp);
 }
 
+/* batch stats of stream are read by sysfs and ioctl after stop */
+static void mse_publish_batch_stats(struct mse_instance *instance)
+{
+	struct mse_packet_batch_stats *batch_stats =
+		&instance->packet_buffer->batch_stats;
+	struct mse_packet_buffer_stats stats = {
+		.tx_batch_sends = batch_stats->sends,
+		.tx_batch_max = batch_stats->max,
+		.tx_batch_packets = batch_stats->packets,
+		.tx_batch_deadline = instance->tx_batch_deadline,
+	};
+
+	mse_debug("tx batch: sends=%u packets=%llu max=%u deadline=%u\n",
+		  stats.tx_batch_sends, stats.tx_batch_packets,
+		  stats.tx_batch_max, stats.tx_batch_deadline);
+
+	mse_config_set_packet_buffer_stats(instance->media->index, &stats);
+}
+
 static void mse_stop_streaming_common(struct mse_instance *instance)
 {
 	int ret;
@@ -3579,12 +4439,9 @@ static void mse_stop_streaming_common(struct mse_instance *instance)
 	if (ret)
 		return;
 
-	if (!instance->tx) {
-		ret = instance->network->cancel(instance->index_network);
-		if (ret)
-			mse_err("failed network adapter cancel() ret=%d\n",
-				ret);
-	}
+	if (!instance->tx)
+		mse_rx_channel_stop(instance->rx_channel,
+				    &instance->rx_stream);
 
 	/* cancel timer */
 	if (instance->ptp_timer_handle) {
@@ -3595,6 +4452,24 @@ static void mse_stop_streaming_common(struct mse_instance *instance)
 		hrtimer_cancel(&instance->timer);
 	}
 
+	/*
+	 * drop packets which are not sent once packets in flight are
+	 * completed, it also releases packets which refer to media buffer
+	 * before returning it. Packets still in flight after timeout stay
+	 * mapped with their media buffers until they are reaped.
+	 */
+	if (instance->tx) {
+		hrtimer_cancel(&instance->batch_timer);
+		mse_flush_work(&instance->wk_stream);
+		ret = mse_wait_packets_inflight(instance,
+						instance->index_network,
+						instance->packet_buffer);
+		mse_packet_ctrl_discard_packet(instance->packet_buffer);
+		if (ret)
+			mse_trans_zero_copy_drop(instance);
+		mse_publish_batch_stats(instance);
+	}
+
 	/* return callback to all transmission request */
 	mse_free_all_trans_buffers(instance, 0);
 
@@ -3602,6 +4477,15 @@ static void mse_stop_streaming_common(struct mse_instance *instance)
 	if (IS_MSE_TYPE_AUDIO(instance->media->type))
 		mse_stop_streaming_audio(instance);
 
+	/* packet buffers are borrowed again at start streaming */
+	if (mse_detach_packet_buffers(instance)) {
+		instance->f_inflight_kept = true;
+		hrtimer_start(&instance->batch_timer,
+			      ns_to_ktime(MSE_REAP_KEPT_INTERVAL_US *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+
 	instance->f_completion = true;
 	instance->f_stopping = false;
 
@@ -3610,12 +4494,8 @@ static void mse_stop_streaming_common(struct mse_instance *instance)
 
 static void mse_work_stop_streaming_common(struct mse_instance *instance)
 {
-	int ret;
-	struct mse_adapter_network_ops *network;
 	unsigned long flags;
 
-	network = instance->network;
-
 	mse_debug_state(instance);
 
 	/* state is NOT STARTED */
@@ -3642,9 +4522,8 @@ static void mse_work_stop_streaming_common(struct mse_instance *instance)
 	if (instance->tx) {
 		mse_queue_work(instance->wq_packet, &instance->wk_start_trans);
 	} else {
-		ret = network->cancel(instance->index_network);
-		if (ret)
-			mse_err("failed network adapter cancel() => %d\n", ret);
+		mse_rx_channel_stop(instance->rx_channel,
+				    &instance->rx_stream);
 
 		mse_queue_work(instance->wq_packet, &instance->wk_depacketize);
 	}
@@ -3717,6 +4596,50 @@ static void mse_work_stop_streaming(struct kthread_work *work)
 		mse_work_stop_streaming_common(instance);
 }
 
+static void mse_work_reap(struct kthread_work *work)
+{
+	struct mse_instance *instance;
+
+	instance = container_of(work, struct mse_instance, wk_reap);
+
+	/* state is NOT OPEN */
+	if (!instance->f_inflight_kept ||
+	    !mse_state_test(instance, MSE_STATE_OPEN))
+		return; /* skip work */
+
+	if (!mse_release_kept_packets(instance)) {
+		mse_info("packets left in flight are completed\n");
+		instance->f_inflight_kept = false;
+		return;
+	}
+
+	hrtimer_start(&instance->batch_timer,
+		      ns_to_ktime(MSE_REAP_KEPT_INTERVAL_US * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart mse_batch_timer_callback(struct hrtimer *arg)
+{
+	struct mse_instance *instance;
+
+	instance = container_of(arg, struct mse_instance, batch_timer);
+
+	/* state is NOT STARTED */
+	if (!mse_state_test(instance, MSE_STATE_STARTED)) {
+		/* reap packets left in flight by stop */
+		if (READ_ONCE(instance->f_inflight_kept))
+			mse_queue_work(instance->wq_packet, &instance->wk_reap);
+		else
+			mse_debug("stopping ...\n");
+		return HRTIMER_NORESTART;
+	}
+
+	/* send held packets by deadline, or reap packets in flight */
+	mse_queue_work(instance->wq_stream, &instance->wk_stream);
+
+	return HRTIMER_NORESTART;
+}
+
 static enum hrtimer_restart mse_timer_callback(struct hrtimer *arg)
 {
 	struct mse_instance *instance;
@@ -3841,7 +4764,8 @@ static u32 mse_ptp_timer_callback_mpeg2ts_tx(struct mse_instance *instance)
 		/* If equal to previous timestamp, current output buffer */
 		if (PTP_TIME_DIFF_S32(launch_avtp_timestamp, expire_prev) <= 0) {
 			/* Release limit */
-			instance->packet_buffer->wait_p = wp->release_p;
+			mse_packet_ctrl_release_wait(instance->packet_buffer,
+						     wp->release_p);
 			list_del(&wp->list);
 		} else {
 			/* Schedule next expire time */
@@ -3949,7 +4873,7 @@ static void mse_work_crf_receive(struct kthread_work *work)
 {
 	struct mse_instance *instance;
 	struct mse_audio_info audio_info;
-	int err, count;
+	int count;
 	u64 ptimes[6];
 	struct mse_packetizer_ops *crf =
 		&mse_packetizer_crf_timestamp_audio_ops;
@@ -3958,17 +4882,10 @@ static void mse_work_crf_receive(struct kthread_work *work)
 
 	mse_debug("START\n");
 
-	do {
-		err = mse_packet_ctrl_receive_packet_crf(
-			instance->crf_index_network,
-			1,
-			instance->crf_packet_buffer,
-			instance->network);
-		if (err < 0) {
-			mse_err("receive error %d\n", err);
-			break;
-		}
-
+	/* packets are stored by RX channel */
+	while (mse_state_test(instance, MSE_STATE_RUNNABLE) &&
+	       mse_packet_ctrl_check_packet_remain(
+			instance->crf_packet_buffer)) {
 		count = mse_packet_ctrl_take_out_packet_crf(
 			instance->crf_index,
 			ptimes,
@@ -3977,6 +4894,9 @@ static void mse_work_crf_receive(struct kthread_work *work)
 
 		mse_debug("crf receive %d timestamp\n", count);
 
+		if (count <= 0)
+			continue;
+
 		crf->get_audio_info(instance->crf_index, &audio_info);
 
 		if (!instance->crf_que.f_init)
@@ -3986,9 +4906,7 @@ static void mse_work_crf_receive(struct kthread_work *work)
 				     audio_info.frame_interval_time);
 
 		tstamps_enq_tstamps(&instance->crf_que, ptimes, count);
-
-	/* while state is RUNNABLE */
-	} while (mse_state_test(instance, MSE_STATE_RUNNABLE));
+	}
 }
 
 static enum hrtimer_restart mse_crf_callback(struct hrtimer *arg)
@@ -4163,7 +5081,9 @@ static void mse_start_streaming_audio(struct mse_instance *instance, u64 now)
 
 	/* receive clock using CRF */
 	if (instance->crf_type == MSE_CRF_TYPE_RX) {
-		mse_queue_work(instance->wq_crf_packet, &instance->wk_crf_receive);
+		if (mse_rx_channel_start(instance->crf_rx_channel,
+					 &instance->crf_rx_stream) < 0)
+			mse_err("crf receive start error\n");
 	}
 }
 
@@ -4780,9 +5700,16 @@ int mse_set_audio_config(int index, struct mse_audio_config *config)
 		ret = network->set_cbs_param(index_network, &cbs);
 		if (ret < 0)
 			return ret;
+
+		ret = mse_fit_packet_buffer(instance->packet_buffer,
+					    packetizer,
+					    index_packetizer);
+		if (ret < 0)
+			return ret;
 	} else {
-		ret = network->set_streamid(index_network,
-					    net_config->streamid);
+		ret = mse_rx_channel_set_streamid(instance->rx_channel,
+						  &instance->rx_stream,
+						  net_config->streamid);
 		if (ret < 0)
 			return ret;
 	}
@@ -4946,8 +5873,9 @@ int mse_set_video_config(int index, struct mse_video_config *config)
 		mse_debug("bandwidth fraction = %08x\n",
 			  cbs.bandwidth_fraction);
 	} else {
-		ret = network->set_streamid(index_network,
-					    net_config->streamid);
+		ret = mse_rx_channel_set_streamid(instance->rx_channel,
+						  &instance->rx_stream,
+						  net_config->streamid);
 		if (ret < 0)
 			return ret;
 	}
@@ -5074,8 +6002,9 @@ int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 		mse_debug("bandwidth fraction = %08x\n",
 			  cbs.bandwidth_fraction);
 	} else {
-		ret = network->set_streamid(index_network,
-					    net_config->streamid);
+		ret = mse_rx_channel_set_streamid(instance->rx_channel,
+						  &instance->rx_stream,
+						  net_config->streamid);
 		if (ret < 0)
 			return ret;
 	}
@@ -5113,7 +6042,13 @@ static void mse_cleanup_crf_network_interface(struct mse_instance *instance)
 	if (instance->crf_index_network < 0)
 		return;
 
-	instance->network->release(instance->crf_index_network);
+	if (instance->crf_rx_channel) {
+		mse_rx_channel_put(instance->crf_rx_channel,
+				   &instance->crf_rx_stream);
+		instance->crf_rx_channel = NULL;
+	} else {
+		instance->network->release(instance->crf_index_network);
+	}
 	instance->crf_index_network = MSE_INDEX_UNDEFINED;
 	module_put(network->owner);
 
@@ -5124,11 +6059,11 @@ static void mse_cleanup_crf_network_interface(struct mse_instance *instance)
 
 static int mse_setup_crf_network_interface(struct mse_instance *instance)
 {
-	int ret;
 	int index_network;
 	struct mse_adapter_network_ops *network;
 	struct mse_network_device *network_device;
 	struct mse_packet_ctrl *packet_buffer;
+	struct mse_rx_channel *channel = NULL;
 	char *dev_name;
 	int ring_size;
 	bool tx;
@@ -5154,11 +6089,22 @@ static int mse_setup_crf_network_interface(struct mse_instance *instance)
 		return -EBUSY;
 	}
 
-	index_network = network->open(dev_name);
-	if (index_network < 0) {
-		module_put(network->owner);
+	if (tx) {
+		index_network = network->open(dev_name);
+		if (index_network < 0) {
+			module_put(network->owner);
+
+			return index_network;
+		}
+	} else {
+		channel = mse_rx_channel_get(network, dev_name,
+					     &instance->packet_buffer_config);
+		if (IS_ERR(channel)) {
+			module_put(network->owner);
 
-		return index_network;
+			return PTR_ERR(channel);
+		}
+		index_network = channel->index_network;
 	}
 
 	instance->crf_net_config.port_transmit_rate =
@@ -5167,30 +6113,24 @@ static int mse_setup_crf_network_interface(struct mse_instance *instance)
 	/* allocate packet buffer */
 	packet_buffer = mse_packet_ctrl_alloc(&mse->pdev->dev,
 					      ring_size,
-					      MSE_PACKET_SIZE_MAX);
+					      MSE_PACKET_SIZE_MAX,
+					      &instance->packet_buffer_config,
+					      tx);
 	if (!packet_buffer) {
-		network->release(index_network);
+		if (tx)
+			network->release(index_network);
+		else
+			mse_rx_channel_put(channel, &instance->crf_rx_stream);
 		module_put(network->owner);
 
 		return -ENOMEM;
 	}
 
-	/* associate crf packet buffer with network adapter */
-	if (tx)
-		ret = mse_packet_ctrl_send_prepare_packet(index_network,
-							  packet_buffer,
-							  network);
-	else
-		ret = mse_packet_ctrl_receive_prepare_packet(index_network,
-							     packet_buffer,
-							     network);
-	if (ret) {
-		mse_packet_ctrl_free(packet_buffer);
-		network->release(index_network);
-		module_put(network->owner);
-
-		mse_err("crf buffer associate error, ret=%d\n", ret);
-		return ret;
+	if (!tx) {
+		mse_rx_channel_add(channel, &instance->crf_rx_stream,
+				   packet_buffer, &instance->wq_crf_packet,
+				   &instance->wk_crf_receive);
+		instance->crf_rx_channel = channel;
 	}
 
 	instance->crf_index_network = index_network;
@@ -5362,32 +6302,6 @@ static void mse_exit_kernel_resource(struct mse_instance *instance,
 		mse_destroy_workqueue(instance->wq_stream);
 }
 
-static int mse_create_workqueue(struct mse_workqueue *wrk, const char *name)
-{
-	kthread_init_worker(&wrk->wrk);
-	wrk->tsk = kthread_run(kthread_worker_fn, &wrk->wrk, "%s", name);
-	if (IS_ERR(wrk->tsk)) {
-		int err = PTR_ERR(wrk->tsk);
-		/* set to NULL for easier ptr check in cleanup path */
-		wrk->tsk = NULL;
-		return err;
-	}
-
-	/* rt priority needed? */
-	if (avb_rt_prio > 0) {
-		if (avb_rt_prio > (MAX_RT_PRIO - 1)) {
-			mse_warn("limit avb_rt_prio val %d to maximum %d\n",
-				 avb_rt_prio, MAX_RT_PRIO - 1);
-			avb_rt_prio = MAX_RT_PRIO - 1;
-		}
-		if (avb_rt_prio >= (MAX_RT_PRIO / 2))
-			sched_set_fifo(wrk->tsk);
-		else
-			sched_set_fifo_low(wrk->tsk);
-	}
-	return 0;
-}
-
 static int mse_init_kernel_resource(struct mse_instance *instance,
 				    struct mse_adapter *adapter)
 {
@@ -5396,10 +6310,13 @@ static int mse_init_kernel_resource(struct mse_instance *instance,
 	atomic_set(&instance->trans_buf_cnt, 0);
 	atomic_set(&instance->done_buf_cnt, 0);
 	init_waitqueue_head(&instance->wait_wk_stream);
+	atomic_set(&instance->packetize_parked, 0);
+	atomic_set(&instance->callback_parked, 0);
 	INIT_LIST_HEAD(&instance->trans_buf_list);
 	INIT_LIST_HEAD(&instance->proc_buf_list);
 	INIT_LIST_HEAD(&instance->wait_buf_list);
 	INIT_LIST_HEAD(&instance->done_buf_list);
+	INIT_LIST_HEAD(&instance->sent_buf_list);
 	INIT_LIST_HEAD(&instance->wait_packet_list);
 	rwlock_init(&instance->lock_state);
 	rwlock_init(&instance->lock_stream);
@@ -5417,6 +6334,7 @@ static int mse_init_kernel_resource(struct mse_instance *instance,
 	kthread_init_work(&instance->wk_timestamp, mse_work_timestamp);
 	kthread_init_work(&instance->wk_start_trans, mse_work_start_transmission);
 	kthread_init_work(&instance->wk_stop_streaming, mse_work_stop_streaming);
+	kthread_init_work(&instance->wk_reap, mse_work_reap);
 
 	if (mse_create_workqueue(&instance->wq_stream, "mse_streamq") < 0) {
 		mse_err("failed to create mse_streamq workqueue\n");
@@ -5438,6 +6356,9 @@ static int mse_init_kernel_resource(struct mse_instance *instance,
 	instance->timer_interval = 0;
 	instance->timer.function = &mse_timer_callback;
 
+	hrtimer_init(&instance->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	instance->batch_timer.function = &mse_batch_timer_callback;
+
 	if (IS_MSE_TYPE_AUDIO(adapter->type)) {
 		hrtimer_init(&instance->tstamp_timer,
 			     CLOCK_MONOTONIC, HRTIMER_MODE_REL);
@@ -5474,10 +6395,22 @@ static void mse_cleanup_network_interface(struct mse_instance *instance)
 	if (instance->index_network < 0)
 		return;
 
-	instance->network->release(instance->index_network);
+	if (instance->rx_channel) {
+		mse_rx_channel_put(instance->rx_channel,
+				   &instance->rx_stream);
+		instance->rx_channel = NULL;
+	} else {
+		instance->network->release(instance->index_network);
+	}
 	instance->index_network = MSE_INDEX_UNDEFINED;
 	module_put(network->owner);
 
+	/* network adapter no longer reads packets kept in flight by stop */
+	if (instance->f_inflight_kept) {
+		mse_free_sent_trans_buffers(instance, 0, true);
+		instance->f_inflight_kept = false;
+	}
+
 	if (IS_MSE_TYPE_MPEG2TS(instance->media->type) && instance->tx) {
 		wait_packet = instance->wait_packet;
 		instance->wait_packet = NULL;
@@ -5498,10 +6431,11 @@ static int mse_setup_network_interface(struct mse_instance *instance,
 	struct mse_network_device *network_device;
 	struct mse_packet_ctrl *packet_buffer;
 	struct mse_wait_packet *wait_packet;
+	struct mse_rx_channel *channel = NULL;
 	char *dev_name;
 	char name[MSE_NAME_LEN_MAX + 1];
 	long link_speed;
-	int i, ret, ring_size;
+	int i, ret, ring_size, burst;
 	unsigned long flags;
 
 	network_device = &media->config.network_device;
@@ -5530,10 +6464,42 @@ static int mse_setup_network_interface(struct mse_instance *instance,
 
 	if (tx) {
 		dev_name = (char *)network_device->device_name_tx;
-		ring_size = MSE_TX_RING_SIZE;
+		ring_size = instance->packet_buffer_config.tx_ring_size;
+		burst = instance->packet_buffer_config.tx_burst;
 	} else {
 		dev_name = (char *)network_device->device_name_rx;
-		ring_size = MSE_RX_RING_SIZE;
+		ring_size = instance->packet_buffer_config.rx_ring_size;
+		burst = instance->packet_buffer_config.rx_burst;
+	}
+
+	/* sysfs writes fields one by one, check them together here */
+	ret = mse_config_check_packet_buffer_config(
+		&instance->packet_buffer_config);
+	if (ret)
+		return ret;
+
+	/* check packet buffer config with limits of network adapter */
+	if ((network->max_packets &&
+	     ring_size > network->max_packets) ||
+	    (network->max_burst && burst > network->max_burst)) {
+		mse_err("packet buffer exceeds limits of %s. ring_size=%d/%d burst=%d/%d\n",
+			name, ring_size, network->max_packets,
+			burst, network->max_burst);
+
+		return -EINVAL;
+	}
+
+	/* DMA features of packet buffer do not apply to CPU copy */
+	if (network->cpu_copy &&
+	    (instance->packet_buffer_config.type !=
+	     MSE_PACKET_BUFFER_TYPE_COHERENT ||
+	     instance->packet_buffer_config.zero_copy)) {
+		mse_warn("%s copies packets by CPU, packet buffer type=%d zero_copy=%d are overridden by coherent without zero copy\n",
+			 name, instance->packet_buffer_config.type,
+			 instance->packet_buffer_config.zero_copy);
+		instance->packet_buffer_config.type =
+			MSE_PACKET_BUFFER_TYPE_COHERENT;
+		instance->packet_buffer_config.zero_copy = false;
 	}
 
 	if (!try_module_get(network->owner)) {
@@ -5542,24 +6508,34 @@ static int mse_setup_network_interface(struct mse_instance *instance,
 		return -EBUSY;
 	}
 
-	/* open network adapter */
-	ret = network->open(dev_name);
-	if (ret < 0) {
-		mse_err("cannot open network adapter ret=%d\n", ret);
-		module_put(network->owner);
+	/* open network adapter, RX device is shared by RX channel */
+	if (tx) {
+		ret = network->open(dev_name);
+		if (ret < 0) {
+			mse_err("cannot open network adapter ret=%d\n", ret);
+			module_put(network->owner);
 
-		return ret;
+			return ret;
+		}
+		index_network = ret;
+	} else {
+		channel = mse_rx_channel_get(network, dev_name,
+					     &instance->packet_buffer_config);
+		if (IS_ERR(channel)) {
+			module_put(network->owner);
+
+			return PTR_ERR(channel);
+		}
+		index_network = channel->index_network;
 	}
-	index_network = ret;
 
 	/* get speed link */
 	link_speed = network->get_link_speed(index_network);
 	if (link_speed <= 0) {
 		mse_err("Link Down. ret=%ld\n", link_speed);
-		network->release(index_network);
-		module_put(network->owner);
+		ret = -ENETDOWN;
 
-		return -ENETDOWN;
+		goto error_release;
 	}
 
 	mse_debug("Link Speed=%ldMbps\n", link_speed);
@@ -5569,58 +6545,70 @@ static int mse_setup_network_interface(struct mse_instance *instance,
 	/* allocate packet buffer */
 	packet_buffer = mse_packet_ctrl_alloc(&mse->pdev->dev,
 					      ring_size,
-					      MSE_PACKET_SIZE_MAX);
+					      MSE_PACKET_SIZE_MAX,
+					      &instance->packet_buffer_config,
+					      tx);
 	if (!packet_buffer) {
-		network->release(index_network);
-		module_put(network->owner);
-
-		return -ENOMEM;
-	}
-
-	/* associate packet buffer with network adapter */
-	if (tx)
-		ret = mse_packet_ctrl_send_prepare_packet(index_network,
-							  packet_buffer,
-							  network);
-	else
-		ret = mse_packet_ctrl_receive_prepare_packet(index_network,
-							     packet_buffer,
-							     network);
-	if (ret) {
-		mse_packet_ctrl_free(packet_buffer);
-		network->release(index_network);
-		module_put(network->owner);
+		ret = -ENOMEM;
 
-		mse_err("packet buffer associate error, ret=%d\n", ret);
-		return ret;
+		goto error_release;
 	}
 
 	if (IS_MSE_TYPE_MPEG2TS(instance->media->type) && instance->tx) {
-		wait_packet = kmalloc_array(MSE_TX_RING_SIZE,
+		wait_packet = kmalloc_array(ring_size,
 					    sizeof(struct mse_wait_packet),
 					    GFP_KERNEL);
 		if (!wait_packet) {
 			mse_packet_ctrl_free(packet_buffer);
-			network->release(index_network);
-			module_put(network->owner);
-
 			mse_err("wait_packet memory allocation error\n");
-			return -ENOMEM;
+			ret = -ENOMEM;
+
+			goto error_release;
 		}
 
 		instance->wait_packet = wait_packet;
 		instance->wait_packet_idx = 0;
 	}
 
+	if (!tx) {
+		mse_rx_channel_add(channel, &instance->rx_stream,
+				   packet_buffer, &instance->wq_packet,
+				   &instance->wk_depacketize);
+		instance->rx_channel = channel;
+	}
+
 	instance->network = network;
 	instance->index_network = index_network;
 	instance->packet_buffer = packet_buffer;
+	instance->ring_size = ring_size;
+	instance->burst = burst;
+	instance->tx_batch_packets =
+		instance->packet_buffer_config.tx_batch_packets;
+	instance->tx_batch_guard_ns =
+		instance->packet_buffer_config.tx_batch_guard_ns;
 
 	return 0;
+
+error_release:
+	if (tx)
+		network->release(index_network);
+	else
+		mse_rx_channel_put(channel, &instance->rx_stream);
+	module_put(network->owner);
+
+	return ret;
 }
 
 static void mse_release_packetizer(struct mse_instance *instance)
 {
+	int i;
+
+	for (i = 0; i < MSE_TRANS_BUF_NUM; i++)
+		instance->trans_buffer[i].nal_index = NULL;
+
+	kfree(instance->nal_index);
+	instance->nal_index = NULL;
+
 	if (instance->index_packetizer < 0)
 		return;
 
@@ -5631,7 +6619,7 @@ static void mse_release_packetizer(struct mse_instance *instance)
 static int mse_open_packetizer(struct mse_instance *instance,
 			       enum MSE_PACKETIZER packetizer_id)
 {
-	int ret;
+	int ret, i;
 	struct mse_packetizer_ops *packetizer;
 
 	/* Get packetizer */
@@ -5662,6 +6650,19 @@ static int mse_open_packetizer(struct mse_instance *instance,
 		return ret;
 	}
 
+	/* NAL index is only recorded by listener of H.264 */
+	if (!instance->tx && packetizer->get_nal_index) {
+		instance->nal_index = kcalloc(MSE_TRANS_BUF_NUM,
+					      sizeof(*instance->nal_index),
+					      GFP_KERNEL);
+		if (!instance->nal_index)
+			return -ENOMEM;
+
+		for (i = 0; i < MSE_TRANS_BUF_NUM; i++)
+			instance->trans_buffer[i].nal_index =
+				&instance->nal_index[i];
+	}
+
 	return 0;
 }
 
@@ -5883,6 +6884,11 @@ int mse_close(int index)
 		return err;
 	}
 
+	/* packets left in flight are dropped after network release */
+	hrtimer_cancel(&instance->batch_timer);
+	mse_flush_work(&instance->wk_reap);
+	hrtimer_cancel(&instance->batch_timer);
+
 	mse_exit_kernel_resource(instance, adapter);
 
 	/* remove instance from resource table */
@@ -5943,15 +6949,34 @@ int mse_start_streaming(int index)
 		return -EPERM;
 	}
 
+	/* packet buffers are kept until packets of last stream complete */
+	mse_flush_work(&instance->wk_reap);
+	if (instance->f_inflight_kept) {
+		up(&instance->sem_stopping);
+		mse_err("packets of last stream are in flight. index=%d\n",
+			index);
+		return -EBUSY;
+	}
+
+	/* borrow DMA memory of packet buffers from shared pool */
+	err = mse_attach_packet_buffers(instance);
+	if (err) {
+		up(&instance->sem_stopping);
+		return err;
+	}
+
 	write_lock_irqsave(&instance->lock_state, flags);
 	err = mse_state_change(instance, MSE_STATE_IDLE);
 	write_unlock_irqrestore(&instance->lock_state, flags);
 	if (err) {
+		mse_detach_packet_buffers(instance);
 		up(&instance->sem_stopping);
 		mse_err("unable to change state to IDLE, err=%d\n", err);
 		return err;
 	}
 
+	instance->tx_batch_deadline = 0;
+
 	/* get timestamp(nsec) */
 	mse_ptp_get_time(instance->ptp_index, &now);
 	mse_tstamp_init(instance, now);
@@ -6015,11 +7040,13 @@ int mse_stop_streaming(int index)
 }
 EXPORT_SYMBOL(mse_stop_streaming);
 
-int mse_start_transmission(int index,
-			   void *buffer,
-			   size_t buffer_size,
-			   void *priv,
-			   int (*mse_completion)(void *priv, int size))
+static int mse_start_transmission_common(
+	int index,
+	void *buffer,
+	size_t buffer_size,
+	const struct mse_jpeg_markers *markers,
+	void *priv,
+	int (*mse_completion)(void *priv, int size))
 {
 	int err = -EINVAL;
 	struct mse_instance *instance;
@@ -6091,6 +7118,10 @@ int mse_start_transmission(int index,
 		buf->work_length = 0;
 		buf->private_data = priv;
 		buf->mse_completion = mse_completion;
+		if (markers)
+			buf->jpeg_markers = *markers;
+		else
+			buf->jpeg_markers.eoi_offset = 0;
 
 		if (instance->tx &&
 		    IS_MSE_TYPE_MPEG2TS(instance->media->type)) {
@@ -6114,8 +7145,72 @@ int mse_start_transmission(int index,
 
 	return err;
 }
+
+int mse_start_transmission(int index,
+			   void *buffer,
+			   size_t buffer_size,
+			   void *priv,
+			   int (*mse_completion)(void *priv, int size))
+{
+	return mse_start_transmission_common(index, buffer, buffer_size,
+					     NULL, priv, mse_completion);
+}
 EXPORT_SYMBOL(mse_start_transmission);
 
+int mse_start_transmission_jpeg(int index,
+				void *buffer,
+				size_t buffer_size,
+				const struct mse_jpeg_markers *markers,
+				void *priv,
+				int (*mse_completion)(void *priv, int size))
+{
+	if (!markers) {
+		mse_err("invalid argument. markers is NULL\n");
+		return -EINVAL;
+	}
+
+	return mse_start_transmission_common(index, buffer, buffer_size,
+					     markers, priv, mse_completion);
+}
+EXPORT_SYMBOL(mse_start_transmission_jpeg);
+
+int mse_get_nal_index(int index, struct mse_nal_index *nal_index)
+{
+	struct mse_instance *instance;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+
+	if (!nal_index) {
+		mse_err("invalid argument. nal_index\n");
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&mse->lock_instance_table, flags);
+	instance = mse->instance_table[index];
+	spin_unlock_irqrestore(&mse->lock_instance_table, flags);
+
+	if (!instance) {
+		mse_err("operation is not permitted. index=%d\n", index);
+		return -EPERM;
+	}
+
+	/* only for the frame in completion callback */
+	if (!instance->buf_completing)
+		return -EBUSY;
+
+	if (!instance->buf_completing->nal_index)
+		return -EPERM;
+
+	*nal_index = *instance->buf_completing->nal_index;
+
+	return 0;
+}
+EXPORT_SYMBOL(mse_get_nal_index);
+
 int mse_register_mch(struct mch_ops *ops)
 {
 	int index;
@@ -6264,6 +7359,8 @@ static int mse_probe(void)
 	spin_lock_init(&mse->lock_instance_table);
 	spin_lock_init(&mse->lock_ptp_table);
 	spin_lock_init(&mse->lock_mch_table);
+	INIT_LIST_HEAD(&mse->rx_channel_list);
+	mutex_init(&mse->lock_rx_channel);
 
 	/* register platform device */
 	mse->pdev = platform_device_register_simple("mse", -1, NULL, 0);
@@ -6337,6 +7434,8 @@ static void mse_remove(void)
 {
 	/* release ioctl device */
 	mse_ioctl_exit(major, mse_instance_max);
+	/* release DMA memory of packet buffers */
+	mse_packet_ctrl_pool_destroy();
 	/* destroy class */
 	if (mse->class)
 		class_destroy(mse->class);
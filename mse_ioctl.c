@@ -505,6 +505,65 @@ static long mse_ioctl_get_delay_time(struct file *file, unsigned long param)
 	return 0;
 }
 
+static long mse_ioctl_set_packet_buffer_config(struct file *file,
+					       unsigned long param)
+{
+	struct mse_packet_buffer_config data;
+	char __user *buf = (char __user *)param;
+
+	mse_debug("START\n");
+
+	if (copy_from_user(&data, buf, sizeof(data)))
+		return -EFAULT;
+
+	/* whole config is given at once, check it before storing */
+	if (mse_config_check_packet_buffer_config(&data))
+		return -EINVAL;
+
+	return mse_config_set_packet_buffer_config(iminor(file->f_inode),
+						   &data);
+}
+
+static long mse_ioctl_get_packet_buffer_config(struct file *file,
+					       unsigned long param)
+{
+	struct mse_packet_buffer_config data;
+	char __user *buf = (char __user *)param;
+	int ret;
+
+	mse_debug("START\n");
+
+	ret = mse_config_get_packet_buffer_config(iminor(file->f_inode),
+						  &data);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(buf, &data, sizeof(data)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long mse_ioctl_get_packet_buffer_stats(struct file *file,
+					      unsigned long param)
+{
+	struct mse_packet_buffer_stats data;
+	char __user *buf = (char __user *)param;
+	int ret;
+
+	mse_debug("START\n");
+
+	ret = mse_config_get_packet_buffer_stats(iminor(file->f_inode),
+						 &data);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(buf, &data, sizeof(data)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static long mse_ioctl_common(struct file *file,
 			     unsigned int cmd,
 			     unsigned long param)
@@ -560,6 +619,12 @@ static long mse_ioctl_common(struct file *file,
 		return mse_ioctl_set_delay_time(file, param);
 	case MSE_G_DELAY_TIME:
 		return mse_ioctl_get_delay_time(file, param);
+	case MSE_S_PACKET_BUFFER_CONFIG:
+		return mse_ioctl_set_packet_buffer_config(file, param);
+	case MSE_G_PACKET_BUFFER_CONFIG:
+		return mse_ioctl_get_packet_buffer_config(file, param);
+	case MSE_G_PACKET_BUFFER_STATS:
+		return mse_ioctl_get_packet_buffer_stats(file, param);
 	default:
 		mse_err("illegal cmd=0x%08x\n", cmd);
 		return -EINVAL;
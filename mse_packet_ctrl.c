@@ -65,85 +65,537 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/mm.h>
 #include <linux/dma-mapping.h>
 #include <linux/if_vlan.h>
+#include <linux/log2.h>
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
 #include "mse_packet_ctrl.h"
 #include "avtp.h"
 
-#define MSE_PACKET_COUNT_MAX (128)
+/* Number of packets between read_p and write_p */
+static unsigned int mse_packet_ctrl_remain(unsigned int write_p,
+					   unsigned int read_p)
+{
+	return write_p - read_p;
+}
 
-/* Checking the difference between read_p and write_p */
-static int mse_packet_ctrl_check_packet_remain_common(struct mse_packet_ctrl *dma,
-						      int write_p)
+/* Producer side: number of free slots, refresh cached read_p if needed */
+static unsigned int mse_packet_ctrl_free_slots(struct mse_packet_ctrl *dma,
+					       unsigned int write_p,
+					       unsigned int wanted)
+{
+	unsigned int free_slots;
+
+	free_slots = dma->size - 1 -
+		mse_packet_ctrl_remain(write_p, dma->read_p_cache);
+	if (free_slots < wanted) {
+		dma->read_p_cache = smp_load_acquire(&dma->read_p);
+		free_slots = dma->size - 1 -
+			mse_packet_ctrl_remain(write_p, dma->read_p_cache);
+	}
+
+	return free_slots;
+}
+
+/* Consumer side: number of filled slots, refresh cached write_p if needed */
+static unsigned int mse_packet_ctrl_filled_slots(struct mse_packet_ctrl *dma,
+						 unsigned int read_p,
+						 unsigned int wanted)
+{
+	unsigned int filled;
+
+	filled = mse_packet_ctrl_remain(dma->write_p_cache, read_p);
+	if ((int)filled < (int)wanted) {
+		dma->write_p_cache = smp_load_acquire(&dma->write_p);
+		filled = mse_packet_ctrl_remain(dma->write_p_cache, read_p);
+	}
+
+	return filled;
+}
+
+/* Map payload in media buffer, vmalloc area is split at page boundary */
+static int mse_packet_ctrl_map_payload(struct mse_packet_ctrl *dma,
+				       struct mse_packet *packet,
+				       u8 *data,
+				       size_t size)
+{
+	struct mse_packet_vec *vec;
+	struct page *page;
+	size_t offset, len;
+
+	for (packet->num_vec = 0; size > 0; packet->num_vec++) {
+		if (packet->num_vec >= MSE_PACKET_VEC_MAX)
+			return -EINVAL;
+
+		vec = &packet->vec[packet->num_vec];
+		offset = offset_in_page(data);
+		if (is_vmalloc_addr(data)) {
+			page = vmalloc_to_page(data);
+			len = min_t(size_t, size, PAGE_SIZE - offset);
+		} else {
+			page = virt_to_page(data);
+			len = size;
+		}
+
+		vec->paddr = dma_map_page(dma->dev, page, offset, len,
+					  DMA_TO_DEVICE);
+		if (dma_mapping_error(dma->dev, vec->paddr))
+			return -ENOMEM;
+
+		vec->len = len;
+		data += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+static void mse_packet_ctrl_unmap_payload(struct mse_packet_ctrl *dma,
+					  unsigned int pos,
+					  int num)
 {
-	return (write_p + dma->size - dma->read_p) % dma->size;
+	struct mse_packet *packet;
+	int i;
+
+	if (!dma->f_zero_copy)
+		return;
+
+	for (; num > 0; num--, pos++) {
+		packet = mse_packet_ctrl_slot(dma, pos);
+		for (i = 0; i < packet->num_vec; i++)
+			dma_unmap_page(dma->dev,
+				       packet->vec[i].paddr,
+				       packet->vec[i].len,
+				       DMA_TO_DEVICE);
+		packet->num_vec = 0;
+	}
 }
 
+/* Checking the difference between read_p and write_p */
 int mse_packet_ctrl_check_packet_remain(struct mse_packet_ctrl *dma)
 {
-	return mse_packet_ctrl_check_packet_remain_common(dma, dma->write_p);
+	unsigned int read_p = smp_load_acquire(&dma->read_p);
+
+	return mse_packet_ctrl_remain(smp_load_acquire(&dma->write_p),
+				      read_p);
+}
+
+/* Consumer side: number of packets not handed to the network adapter */
+int mse_packet_ctrl_check_packet_unsent(struct mse_packet_ctrl *dma)
+{
+	return mse_packet_ctrl_remain(smp_load_acquire(&dma->write_p),
+				      dma->send_p);
+}
+
+/* Consumer side: number of packets sent and not completed yet */
+int mse_packet_ctrl_check_packet_inflight(struct mse_packet_ctrl *dma)
+{
+	return mse_packet_ctrl_remain(dma->send_p, dma->read_p);
+}
+
+/* Producer side: all packets before pos are completed */
+bool mse_packet_ctrl_is_completed(struct mse_packet_ctrl *dma,
+				  unsigned int pos)
+{
+	return (int)(smp_load_acquire(&dma->read_p) - pos) >= 0;
+}
+
+/*
+ * Consumer side: AVTP timestamp of the oldest packet which is not sent,
+ * it returns false when the packet has no valid timestamp.
+ */
+bool mse_packet_ctrl_get_head_timestamp(struct mse_packet_ctrl *dma,
+					u32 *timestamp)
+{
+	struct mse_packet *packet = mse_packet_ctrl_slot(dma, dma->send_p);
+
+	if (!avtp_get_tv(packet->vaddr))
+		return false;
+
+	*timestamp = avtp_get_timestamp(packet->vaddr);
+
+	return true;
 }
 
 int mse_packet_ctrl_check_packet_remain_wait(struct mse_packet_ctrl *dma)
 {
-	return mse_packet_ctrl_check_packet_remain_common(dma, dma->wait_p);
+	return mse_packet_ctrl_remain(smp_load_acquire(&dma->wait_p),
+				      dma->send_p);
 }
 
 void mse_packet_ctrl_release_all_wait(struct mse_packet_ctrl *dma)
 {
-	dma->wait_p = dma->write_p;
+	smp_store_release(&dma->wait_p, dma->write_p);
+}
+
+void mse_packet_ctrl_release_wait(struct mse_packet_ctrl *dma,
+				  unsigned int release_p)
+{
+	/* wait_p never goes backward */
+	if ((int)(release_p - READ_ONCE(dma->wait_p)) > 0)
+		smp_store_release(&dma->wait_p, release_p);
+}
+
+/*
+ * DMA memory of packet buffers is shared by all instances. It is handed
+ * out in chunks of MSE_PACKET_CHUNK_SIZE, each chunk holds several slots.
+ * Chunks returned by a packet buffer are kept for reuse by other ones up
+ * to MSE_PACKET_POOL_RESERVE per type, the rest is freed on detach and
+ * the reserve at module exit.
+ */
+#define MSE_PACKET_CHUNK_SIZE (16 * 1024)
+#define MSE_PACKET_POOL_RESERVE (4)
+
+/* slots handed to packetize_burst of packetizer at once */
+#define MSE_PACKETIZE_BURST_MAX (16)
+
+struct mse_packet_chunk {
+	struct list_head list;
+	struct device *dev;
+	void *vaddr;
+	dma_addr_t paddr;
+};
+
+static DEFINE_MUTEX(mse_packet_pool_lock);
+static struct list_head mse_packet_pool[MSE_PACKET_BUFFER_TYPE_MAX] = {
+	LIST_HEAD_INIT(mse_packet_pool[MSE_PACKET_BUFFER_TYPE_COHERENT]),
+	LIST_HEAD_INIT(mse_packet_pool[MSE_PACKET_BUFFER_TYPE_STREAMING]),
+};
+static int mse_packet_pool_count[MSE_PACKET_BUFFER_TYPE_MAX];
+
+static struct mse_packet_chunk *mse_packet_chunk_alloc(
+	struct device *dev,
+	enum MSE_PACKET_BUFFER_TYPE type)
+{
+	struct mse_packet_chunk *chunk;
+
+	chunk = kzalloc(sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return NULL;
+
+	/* chunk may be reused for both directions */
+	chunk->dev = dev;
+	if (type == MSE_PACKET_BUFFER_TYPE_STREAMING)
+		chunk->vaddr = dma_alloc_noncoherent(dev,
+						     MSE_PACKET_CHUNK_SIZE,
+						     &chunk->paddr,
+						     DMA_BIDIRECTIONAL,
+						     GFP_KERNEL);
+	else
+		chunk->vaddr = dma_alloc_coherent(dev,
+						  MSE_PACKET_CHUNK_SIZE,
+						  &chunk->paddr,
+						  GFP_KERNEL);
+	if (!chunk->vaddr) {
+		kfree(chunk);
+		return NULL;
+	}
+
+	return chunk;
 }
 
-void mse_packet_ctrl_discard_packet(struct mse_packet_ctrl *dma)
+static void mse_packet_chunk_free(struct mse_packet_chunk *chunk,
+				  enum MSE_PACKET_BUFFER_TYPE type)
 {
-	dma->read_p = dma->write_p;
+	if (type == MSE_PACKET_BUFFER_TYPE_STREAMING)
+		dma_free_noncoherent(chunk->dev,
+				     MSE_PACKET_CHUNK_SIZE,
+				     chunk->vaddr,
+				     chunk->paddr,
+				     DMA_BIDIRECTIONAL);
+	else
+		dma_free_coherent(chunk->dev,
+				  MSE_PACKET_CHUNK_SIZE,
+				  chunk->vaddr,
+				  chunk->paddr);
+	kfree(chunk);
+}
+
+/* chunk of local packet buffer, it is not pooled */
+static struct mse_packet_chunk *mse_packet_chunk_alloc_local(void)
+{
+	struct mse_packet_chunk *chunk;
+
+	chunk = kzalloc(sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return NULL;
+
+	chunk->vaddr = kmalloc(MSE_PACKET_CHUNK_SIZE, GFP_KERNEL);
+	if (!chunk->vaddr) {
+		kfree(chunk);
+		return NULL;
+	}
+
+	return chunk;
+}
+
+static void mse_packet_chunk_free_local(struct list_head *chunks)
+{
+	struct mse_packet_chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, chunks, list) {
+		list_del(&chunk->list);
+		kfree(chunk->vaddr);
+		kfree(chunk);
+	}
+}
+
+static struct mse_packet_chunk *mse_packet_pool_get(
+	struct device *dev,
+	enum MSE_PACKET_BUFFER_TYPE type)
+{
+	struct mse_packet_chunk *chunk;
+
+	mutex_lock(&mse_packet_pool_lock);
+	chunk = list_first_entry_or_null(&mse_packet_pool[type],
+					 struct mse_packet_chunk, list);
+	if (chunk) {
+		list_del(&chunk->list);
+		mse_packet_pool_count[type]--;
+	}
+	mutex_unlock(&mse_packet_pool_lock);
+
+	if (!chunk)
+		chunk = mse_packet_chunk_alloc(dev, type);
+
+	return chunk;
+}
+
+static void mse_packet_pool_put(struct list_head *chunks,
+				enum MSE_PACKET_BUFFER_TYPE type)
+{
+	struct mse_packet_chunk *chunk, *tmp;
+
+	mutex_lock(&mse_packet_pool_lock);
+	list_for_each_entry_safe(chunk, tmp, chunks, list) {
+		list_del(&chunk->list);
+		if (mse_packet_pool_count[type] < MSE_PACKET_POOL_RESERVE) {
+			list_add_tail(&chunk->list, &mse_packet_pool[type]);
+			mse_packet_pool_count[type]++;
+		} else {
+			mse_packet_chunk_free(chunk, type);
+		}
+	}
+	mutex_unlock(&mse_packet_pool_lock);
+}
+
+void mse_packet_ctrl_pool_destroy(void)
+{
+	struct mse_packet_chunk *chunk, *tmp;
+	int type;
+
+	mutex_lock(&mse_packet_pool_lock);
+	for (type = 0; type < MSE_PACKET_BUFFER_TYPE_MAX; type++) {
+		list_for_each_entry_safe(chunk, tmp, &mse_packet_pool[type],
+					 list) {
+			list_del(&chunk->list);
+			mse_packet_chunk_free(chunk, type);
+		}
+		mse_packet_pool_count[type] = 0;
+	}
+	mutex_unlock(&mse_packet_pool_lock);
+}
+
+/*
+ * Hand over packets [pos, pos + num) to the device, RX slots are handed
+ * over whole to be received into.
+ */
+static void mse_packet_ctrl_sync_for_device(struct mse_packet_ctrl *dma,
+					    unsigned int pos,
+					    int num)
+{
+	struct mse_packet *packet;
+
+	if (dma->f_local || dma->type != MSE_PACKET_BUFFER_TYPE_STREAMING)
+		return;
+
+	for (; num > 0; num--, pos++) {
+		packet = mse_packet_ctrl_slot(dma, pos);
+		dma_sync_single_for_device(dma->dev,
+					   packet->paddr,
+					   dma->dir == DMA_FROM_DEVICE ?
+					   dma->max_packet_size : packet->len,
+					   dma->dir);
+	}
+}
+
+/* consumer returns slots up to read_p, adapter may re-arm RX ones */
+static void mse_packet_ctrl_release_slots(struct mse_packet_ctrl *dma,
+					  unsigned int read_p)
+{
+	if (dma->dir == DMA_FROM_DEVICE)
+		mse_packet_ctrl_sync_for_device(dma, dma->read_p,
+						read_p - dma->read_p);
+
+	smp_store_release(&dma->read_p, read_p);
+}
+
+/*
+ * Drop packets which are not completed. TX packets in flight are still read
+ * by network adapter, they stay mapped and only packets not sent are dropped,
+ * write_p goes back to send_p as the producer is stopped then.
+ */
+int mse_packet_ctrl_discard_packet(struct mse_packet_ctrl *dma)
+{
+	unsigned int read_p = dma->read_p;
+
+	dma->write_p_cache = smp_load_acquire(&dma->write_p);
+
+	if (dma->dir == DMA_TO_DEVICE &&
+	    mse_packet_ctrl_check_packet_inflight(dma)) {
+		mse_packet_ctrl_unmap_payload(dma, dma->send_p,
+					      mse_packet_ctrl_remain(
+						      dma->write_p_cache,
+						      dma->send_p));
+		dma->write_p_cache = dma->send_p;
+		smp_store_release(&dma->wait_p, dma->send_p);
+		smp_store_release(&dma->write_p, dma->send_p);
+
+		return -EBUSY;
+	}
+
+	mse_packet_ctrl_unmap_payload(dma, read_p,
+				      mse_packet_ctrl_remain(dma->write_p_cache,
+							     read_p));
+	dma->send_p = dma->write_p_cache;
+	mse_packet_ctrl_release_slots(dma, dma->write_p_cache);
+
+	return 0;
+}
+
+/* Parse AVTP header of received packets [pos, pos + num) into metadata */
+static void mse_packet_ctrl_fill_meta(struct mse_packet_ctrl *dma,
+				      unsigned int pos,
+				      int num)
+{
+	struct mse_packet_meta *meta = &dma->meta;
+	struct mse_packet *packet;
+	u8 streamid[AVTP_STREAMID_SIZE];
+	unsigned int i, len;
+
+	for (; num > 0; num--, pos++) {
+		packet = mse_packet_ctrl_slot(dma, pos);
+		i = mse_packet_ctrl_meta_index(dma, pos);
+
+		avtp_get_stream_id(packet->vaddr, streamid);
+		meta->streamid[i] = get_unaligned_be64(streamid);
+		meta->subtype[i] = avtp_get_subtype(packet->vaddr);
+
+		if (meta->subtype[i] == AVTP_SUBTYPE_CRF) {
+			len = AVTP_CRF_PAYLOAD_OFFSET +
+				avtp_get_crf_data_length(packet->vaddr);
+			meta->tv[i] = false;
+			meta->avtp_timestamp[i] = 0;
+		} else {
+			len = AVTP_PAYLOAD_OFFSET +
+				avtp_get_stream_data_length(packet->vaddr);
+			meta->tv[i] = avtp_get_tv(packet->vaddr);
+			meta->avtp_timestamp[i] =
+				avtp_get_timestamp(packet->vaddr);
+		}
+
+		/* broken header, leave it to depacketizer */
+		meta->len[i] = min_t(unsigned int, len, packet->len);
+	}
+}
+
+/* Take back packets [pos, pos + num) from the device */
+static void mse_packet_ctrl_sync_for_cpu(struct mse_packet_ctrl *dma,
+					 unsigned int pos,
+					 int num)
+{
+	struct mse_packet *packet;
+
+	if (dma->f_local || dma->type != MSE_PACKET_BUFFER_TYPE_STREAMING)
+		return;
+
+	for (; num > 0; num--, pos++) {
+		packet = mse_packet_ctrl_slot(dma, pos);
+		dma_sync_single_for_cpu(dma->dev,
+					packet->paddr,
+					dma->max_packet_size,
+					dma->dir);
+	}
+}
+
+static void mse_packet_ctrl_free_meta(struct mse_packet_ctrl *dma)
+{
+	kfree(dma->meta.len);
+	kfree(dma->meta.subtype);
+	kfree(dma->meta.tv);
+	kfree(dma->meta.streamid);
+	kfree(dma->meta.avtp_timestamp);
 }
 
 struct mse_packet_ctrl *mse_packet_ctrl_alloc(struct device *dev,
 					      int max_packet,
-					      int max_packet_size)
+					      int max_packet_size,
+					      struct mse_packet_buffer_config *config,
+					      bool tx)
 {
 	struct mse_packet_ctrl *dma;
-	dma_addr_t paddr, pitch;
-	int i;
 
-	mse_debug("packets=%d size=%d\n", max_packet, max_packet_size);
+	mse_debug("packets=%d size=%d type=%d zero_copy=%d\n",
+		  max_packet, max_packet_size, config->type,
+		  config->zero_copy);
 
-	dma = kmalloc(sizeof(*dma), GFP_KERNEL);
-	if (!dma)
+	if (max_packet_size > MSE_PACKET_CHUNK_SIZE)
 		return NULL;
 
-	dma->dma_vaddr = dma_alloc_coherent(dev,
-					    max_packet_size * max_packet,
-					    &dma->dma_handle,
-					    GFP_KERNEL);
-	if (!dma->dma_vaddr) {
-		mse_err("cannot dma_alloc_coherent!\n");
-		kfree(dma);
+	/* ring index is masked */
+	if (!is_power_of_2(max_packet)) {
+		mse_err("ring size %d is not a power of 2\n", max_packet);
 		return NULL;
 	}
 
+	dma = kzalloc(sizeof(*dma), GFP_KERNEL);
+	if (!dma)
+		return NULL;
+
 	dma->dev = dev;
+	dma->type = config->type;
+	dma->dir = tx ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	dma->f_zero_copy = tx && config->zero_copy;
+	INIT_LIST_HEAD(&dma->chunk_list);
+
 	dma->size = max_packet;
-	dma->write_p = 0;
-	dma->read_p = 0;
-	dma->wait_p = 0;
+	dma->mask = max_packet - 1;
+	dma->burst = min_t(int, tx ? config->tx_burst : config->rx_burst,
+			   dma->size - 1);
 	dma->max_packet_size = max_packet_size;
-	dma->packet_table = kmalloc((sizeof(struct mse_packet) * dma->size),
+	dma->packet_table = kcalloc(dma->size,
+				    sizeof(struct mse_packet),
 				    GFP_KERNEL);
-
-	paddr = dma->dma_handle;
-	for (i = 0; i < dma->size; i++) {
-		pitch = dma->max_packet_size * i;
-		dma->packet_table[i].len = dma->max_packet_size;
-		dma->packet_table[i].paddr = paddr + pitch;
-		dma->packet_table[i].vaddr = dma->dma_vaddr + pitch;
+	if (!dma->packet_table)
+		goto error;
+
+	if (!tx) {
+		dma->meta.len = kcalloc(dma->size, sizeof(u16), GFP_KERNEL);
+		dma->meta.subtype = kcalloc(dma->size, sizeof(u8), GFP_KERNEL);
+		dma->meta.tv = kcalloc(dma->size, sizeof(bool), GFP_KERNEL);
+		dma->meta.streamid = kcalloc(dma->size, sizeof(u64),
+					     GFP_KERNEL);
+		dma->meta.avtp_timestamp = kcalloc(dma->size, sizeof(u32),
+						   GFP_KERNEL);
+		if (!dma->meta.len || !dma->meta.subtype || !dma->meta.tv ||
+		    !dma->meta.streamid || !dma->meta.avtp_timestamp)
+			goto error;
 	}
 
 	return dma;
+
+error:
+	mse_packet_ctrl_free_meta(dma);
+	kfree(dma->packet_table);
+	kfree(dma);
+
+	return NULL;
 }
 
 void mse_packet_ctrl_free(struct mse_packet_ctrl *dma)
@@ -153,14 +605,200 @@ void mse_packet_ctrl_free(struct mse_packet_ctrl *dma)
 
 	mse_debug("START\n");
 
+	/* network adapter is released, it reads no packet in flight */
+	if (mse_packet_ctrl_is_attached(dma) && dma->dir == DMA_TO_DEVICE) {
+		mse_packet_ctrl_unmap_payload(
+			dma, dma->read_p,
+			mse_packet_ctrl_check_packet_inflight(dma));
+		smp_store_release(&dma->read_p, dma->send_p);
+	}
+
+	mse_packet_ctrl_detach(dma);
+	mse_packet_ctrl_free_meta(dma);
 	kfree(dma->packet_table);
-	dma_free_coherent(dma->dev,
-			  dma->size * dma->max_packet_size,
-			  dma->dma_vaddr,
-			  dma->dma_handle);
 	kfree(dma);
 }
 
+/* packet buffer only passed between instances, it needs no DMA memory */
+int mse_packet_ctrl_set_local(struct mse_packet_ctrl *dma)
+{
+	if (mse_packet_ctrl_is_attached(dma))
+		return -EBUSY;
+
+	dma->f_local = true;
+
+	return 0;
+}
+
+int mse_packet_ctrl_set_packet_size(struct mse_packet_ctrl *dma,
+				    int max_packet_size)
+{
+	if (mse_packet_ctrl_is_attached(dma))
+		return -EBUSY;
+
+	if (max_packet_size > MSE_PACKET_CHUNK_SIZE)
+		return -EINVAL;
+
+	dma->max_packet_size = max_packet_size;
+
+	return 0;
+}
+
+int mse_packet_ctrl_attach(struct mse_packet_ctrl *dma)
+{
+	struct mse_packet_chunk *chunk = NULL;
+	int slots_per_chunk;
+	size_t offset;
+	int i;
+
+	if (mse_packet_ctrl_is_attached(dma))
+		return 0;
+
+	slots_per_chunk = MSE_PACKET_CHUNK_SIZE / dma->max_packet_size;
+
+	for (i = 0; i < dma->size; i++) {
+		if (!(i % slots_per_chunk)) {
+			if (dma->f_local)
+				chunk = mse_packet_chunk_alloc_local();
+			else
+				chunk = mse_packet_pool_get(dma->dev,
+							    dma->type);
+			if (!chunk) {
+				mse_err("cannot allocate dma buffer! type=%d\n",
+					dma->type);
+				mse_packet_ctrl_detach(dma);
+				return -ENOMEM;
+			}
+			list_add_tail(&chunk->list, &dma->chunk_list);
+		}
+
+		offset = dma->max_packet_size * (i % slots_per_chunk);
+		dma->packet_table[i].len = dma->max_packet_size;
+		dma->packet_table[i].paddr = chunk->paddr + offset;
+		dma->packet_table[i].vaddr = chunk->vaddr + offset;
+		dma->packet_table[i].num_vec = 0;
+	}
+
+	/* adapter numbers the slots from 0 after send_prepare */
+	dma->write_p = 0;
+	dma->wait_p = 0;
+	dma->read_p_cache = 0;
+	dma->read_p = 0;
+	dma->send_p = 0;
+	dma->write_p_cache = 0;
+
+	/* slots may hold data of other packet buffer */
+	dma->f_prestamped = false;
+	memset(&dma->batch_stats, 0, sizeof(dma->batch_stats));
+
+	mse_debug("attached %d packets\n", dma->size);
+
+	return 0;
+}
+
+int mse_packet_ctrl_detach(struct mse_packet_ctrl *dma)
+{
+	if (!mse_packet_ctrl_is_attached(dma))
+		return 0;
+
+	/* chunks are kept while network adapter reads packets in flight */
+	if (mse_packet_ctrl_discard_packet(dma))
+		return -EBUSY;
+
+	if (dma->f_local)
+		mse_packet_chunk_free_local(&dma->chunk_list);
+	else
+		mse_packet_pool_put(&dma->chunk_list, dma->type);
+	dma->f_prestamped = false;
+
+	mse_debug("detached %d packets\n", dma->size);
+
+	return 0;
+}
+
+static int mse_packet_ctrl_make_packet_burst(int index,
+					     void *data,
+					     size_t size,
+					     int *current_timestamp,
+					     int timestamps_size,
+					     u64 *timestamps,
+					     struct mse_packet_ctrl *dma,
+					     struct mse_packetizer_ops *ops,
+					     size_t *processed)
+{
+	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
+	unsigned int write_p = dma->write_p;
+	struct mse_packet *packets[MSE_PACKETIZE_BURST_MAX];
+	unsigned int burst_timestamps[MSE_PACKETIZE_BURST_MAX];
+	int pcount = 0, pcount_max;
+	int i, num, made;
+
+	pcount_max = min_t(int,
+			   mse_packet_ctrl_free_slots(dma, write_p, dma->burst),
+			   dma->burst);
+	if (!pcount_max)
+		mse_debug("make overrun r=%u w=%u p=%zu/%zu\n",
+			  dma->read_p_cache, write_p, *processed, size);
+
+	while ((ret == MSE_PACKETIZE_STATUS_CONTINUE) &&
+	       (pcount < pcount_max)) {
+		num = min_t(int, pcount_max - pcount, MSE_PACKETIZE_BURST_MAX);
+		for (i = 0; i < num; i++) {
+			int ts_pos = *current_timestamp + i;
+
+			if (timestamps_size == 1)         /* video */
+				burst_timestamps[i] = timestamps[0];
+			else if (ts_pos < timestamps_size)    /* audio */
+				burst_timestamps[i] = timestamps[ts_pos];
+			else if (ts_pos == timestamps_size)
+				burst_timestamps[i] = 0; /* dummy, not used */
+			else
+				break;
+
+			packets[i] = mse_packet_ctrl_slot(dma, write_p + i);
+			if (!dma->f_prestamped)
+				memset(packets[i]->vaddr, 0,
+				       AVTP_FRAME_SIZE_MIN);
+		}
+
+		if (!i) {
+			mse_err("not enough timestamp %d\n", timestamps_size);
+			ret = -EINVAL;
+			break;
+		}
+
+		made = ops->packetize_burst(index, packets, burst_timestamps,
+					    i, data, size, processed, &ret);
+		if (made < 0) {
+			ret = made;
+			break;
+		}
+
+		/* every packetize step consumed a timestamp */
+		if (timestamps_size != 1)
+			*current_timestamp += made +
+				(ret < 0 || ret == MSE_PACKETIZE_STATUS_NOT_ENOUGH);
+
+		for (i = 0; i < made; i++)
+			if (packets[i]->len < AVTP_FRAME_SIZE_MIN)
+				packets[i]->len = AVTP_FRAME_SIZE_MIN;
+
+		pcount += made;
+		write_p += made;
+	}
+
+	/* publish packets to consumer at once */
+	if (pcount)
+		smp_store_release(&dma->write_p, write_p);
+
+	mse_debug("packetize %d %zu/%zu\n", pcount, *processed, size);
+
+	if (ret < 0)
+		return ret;
+
+	return *processed;
+}
+
 int mse_packet_ctrl_make_packet(int index,
 				void *data,
 				size_t size,
@@ -174,24 +812,36 @@ int mse_packet_ctrl_make_packet(int index,
 {
 	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
 	size_t packet_size = 0;
-	int new_write_p;
+	size_t payload_offset, payload_size = 0;
+	unsigned int write_p = dma->write_p;
+	struct mse_packet *packet;
 	int pcount = 0, pcount_max;
 	unsigned int timestamp;
-	int packetized;
+	bool zero_copy = dma->f_zero_copy && ops->packetize_sg;
+
+	if (ops->packetize_burst && !zero_copy)
+		return mse_packet_ctrl_make_packet_burst(index,
+							 data,
+							 size,
+							 current_timestamp,
+							 timestamps_size,
+							 timestamps,
+							 dma,
+							 ops,
+							 processed);
+
+	pcount_max = min_t(int,
+			   mse_packet_ctrl_free_slots(dma, write_p, dma->burst),
+			   dma->burst);
+	if (!pcount_max)
+		mse_debug("make overrun r=%u w=%u p=%zu/%zu\n",
+			  dma->read_p_cache, write_p, *processed, size);
 
-	packetized = mse_packet_ctrl_check_packet_remain(dma);
-	pcount_max = min(dma->size - packetized - 1, MSE_PACKET_COUNT_MAX);
 	while ((ret == MSE_PACKETIZE_STATUS_CONTINUE) &&
 	       (pcount < pcount_max)) {
-		new_write_p = (dma->write_p + 1) % dma->size;
-		if (new_write_p == dma->read_p) {
-			mse_debug("make overrun r=%d w=%d nw=%d p=%zu/%zu\n",
-				  dma->read_p, dma->write_p, new_write_p,
-				  *processed, size);
-			return *processed;
-		}
-		memset(dma->packet_table[dma->write_p].vaddr, 0,
-		       AVTP_FRAME_SIZE_MIN);
+		packet = mse_packet_ctrl_slot(dma, write_p);
+		if (!dma->f_prestamped)
+			memset(packet->vaddr, 0, AVTP_FRAME_SIZE_MIN);
 		if (timestamps_size == 1) {               /* video */
 			timestamp = timestamps[0];
 		} else {                              /* audio */
@@ -203,33 +853,63 @@ int mse_packet_ctrl_make_packet(int index,
 			} else {
 				mse_err("not enough timestamp %d\n",
 					timestamps_size);
-				return -EINVAL;
+				ret = -EINVAL;
+				break;
 			}
 		}
 
-		ret = ops->packetize(index,
-				     dma->packet_table[dma->write_p].vaddr,
-				     &packet_size,
-				     data,
-				     size,
-				     processed,
-				     &timestamp);
+		if (zero_copy)
+			ret = ops->packetize_sg(index,
+						packet->vaddr,
+						&packet_size,
+						data,
+						size,
+						processed,
+						&timestamp,
+						&payload_offset,
+						&payload_size);
+		else
+			ret = ops->packetize(index,
+					     packet->vaddr,
+					     &packet_size,
+					     data,
+					     size,
+					     processed,
+					     &timestamp);
 
 		if (ret >= 0 && ret != MSE_PACKETIZE_STATUS_NOT_ENOUGH) {
-			pcount++;
-			if (packet_size < AVTP_FRAME_SIZE_MIN)
+			if (payload_size) {
+				if (mse_packet_ctrl_map_payload(
+					dma, packet, data + payload_offset,
+					payload_size)) {
+					mse_err("cannot map payload %zu\n",
+						payload_size);
+					mse_packet_ctrl_unmap_payload(
+						dma, write_p, 1);
+					ret = -ENOMEM;
+					break;
+				}
+			} else if (packet_size < AVTP_FRAME_SIZE_MIN) {
 				packet_size = AVTP_FRAME_SIZE_MIN;
-			dma->packet_table[dma->write_p].len = packet_size;
+			}
+			pcount++;
+			packet->len = packet_size;
 
-			dma->write_p = new_write_p;
-		} else if (ret < 0) {
-			return ret;
+			write_p++;
 		} else {
 			break;
 		}
 	}
+
+	/* publish packets to consumer at once */
+	if (pcount)
+		smp_store_release(&dma->write_p, write_p);
+
 	mse_debug("packetize %d %zu/%zu\n", pcount, *processed, size);
 
+	if (ret < 0)
+		return ret;
+
 	return *processed;
 }
 
@@ -240,21 +920,22 @@ int mse_packet_ctrl_make_packet_crf(int index,
 {
 	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
 	size_t packet_size = 0;
-	int new_write_p;
+	unsigned int write_p = dma->write_p;
+	struct mse_packet *packet;
 
-	new_write_p = (dma->write_p + 1) % dma->size;
-	if (new_write_p == dma->read_p) {
-		mse_err("make overrun r=%d w=%d nw=%d\n",
-			dma->read_p, dma->write_p, new_write_p);
+	if (!mse_packet_ctrl_free_slots(dma, write_p, 1)) {
+		mse_err("make overrun r=%u w=%u\n",
+			dma->read_p_cache, write_p);
 		return -ENOSPC;
 	}
 
-	memset(dma->packet_table[dma->write_p].vaddr, 0, AVTP_FRAME_SIZE_MIN);
+	packet = mse_packet_ctrl_slot(dma, write_p);
+	memset(packet->vaddr, 0, AVTP_FRAME_SIZE_MIN);
 
 	/* CRF packetizer */
 	ret = mse_packetizer_crf_timestamp_audio_ops.packetize(
 		index,
-		dma->packet_table[dma->write_p].vaddr,
+		packet->vaddr,
 		&packet_size,
 		timestamps,
 		timestamps_size * sizeof(*timestamps),
@@ -264,14 +945,35 @@ int mse_packet_ctrl_make_packet_crf(int index,
 	if (ret >= 0) {
 		if (packet_size < AVTP_FRAME_SIZE_MIN)
 			packet_size = AVTP_FRAME_SIZE_MIN;
-		dma->packet_table[dma->write_p].len = packet_size;
+		packet->len = packet_size;
 
-		dma->write_p = new_write_p;
+		smp_store_release(&dma->write_p, write_p + 1);
 	}
 
 	return MSE_PACKETIZE_STATUS_COMPLETE;
 }
 
+/* Write static header into all slots, packetizer rewrites dynamic fields */
+int mse_packet_ctrl_prepare_packets(int index,
+				    struct mse_packet_ctrl *dma,
+				    struct mse_packetizer_ops *ops)
+{
+	int ret;
+
+	dma->f_prestamped = false;
+
+	if (!ops->prepare_packets)
+		return 0;
+
+	ret = ops->prepare_packets(index, dma->packet_table, dma->size);
+	if (ret < 0)
+		return ret;
+
+	dma->f_prestamped = true;
+
+	return 0;
+}
+
 int mse_packet_ctrl_send_prepare_packet(
 				int index,
 				struct mse_packet_ctrl *dma,
@@ -285,49 +987,105 @@ int mse_packet_ctrl_send_prepare_packet(
 static int mse_packet_ctrl_send_packet_common(int index,
 					      struct mse_packet_ctrl *dma,
 					      struct mse_adapter_network_ops *ops,
-					      int write_p)
+					      unsigned int packetized)
 {
-	int read_p, ret, send_size;
-	int packetized;
+	unsigned int send_p = dma->send_p;
+	int ret, send_size;
 
-	packetized = mse_packet_ctrl_check_packet_remain_common(dma, write_p);
-	send_size = min(packetized, MSE_PACKET_COUNT_MAX);
+	send_size = min_t(unsigned int, packetized, dma->burst);
 
 	if (!send_size)
 		return 0;
 
+	mse_packet_ctrl_sync_for_device(dma, send_p, send_size);
+
 	/* send packets */
 	ret = ops->send(index, dma->packet_table, send_size);
 	if (ret < 0)
 		return -EPERM;
 
-	read_p = dma->read_p; /* for debug */
-	dma->read_p = (dma->read_p + ret) % dma->size;
+	dma->send_p = send_p + ret;
 
-	mse_debug("%d packtets w=%d r=%d->%d\n",
-		  ret, dma->write_p, read_p, dma->read_p);
+	dma->batch_stats.sends++;
+	dma->batch_stats.packets += ret;
+	dma->batch_stats.max = max_t(u32, dma->batch_stats.max, ret);
 
-	return 0;
+	mse_debug("%d packtets s=%u->%u\n", ret, send_p, send_p + ret);
+
+	/* slots are released by reap, or at once without it */
+	if (mse_packet_ctrl_reap_packet(index, dma, ops) < 0)
+		return -EPERM;
+
+	return ret;
+}
+
+/*
+ * Consumer side: release packets completed by the network adapter. Their
+ * payload is unmapped before slots go back to the producer, so neither
+ * slot nor media buffer is reused while the adapter may still read it.
+ */
+int mse_packet_ctrl_reap_packet(int index,
+				struct mse_packet_ctrl *dma,
+				struct mse_adapter_network_ops *ops)
+{
+	unsigned int read_p = dma->read_p;
+	int inflight = mse_packet_ctrl_remain(dma->send_p, read_p);
+	int ret;
+
+	if (!inflight)
+		return 0;
+
+	if (ops->reap) {
+		ret = ops->reap(index);
+		if (ret < 0)
+			return ret;
+		ret = min(ret, inflight);
+	} else {
+		ret = inflight;
+	}
+
+	if (!ret)
+		return 0;
+
+	/* completed packets no longer refer to media buffer */
+	mse_packet_ctrl_unmap_payload(dma, read_p, ret);
+
+	/* return slots to producer */
+	smp_store_release(&dma->read_p, read_p + ret);
+
+	mse_debug("%d packtets r=%u->%u\n", ret, read_p, read_p + ret);
+
+	return ret;
 }
 
 int mse_packet_ctrl_send_packet(int index,
 				struct mse_packet_ctrl *dma,
 				struct mse_adapter_network_ops *ops)
 {
+	unsigned int packetized;
+
+	packetized = mse_packet_ctrl_filled_slots(dma, dma->send_p,
+						  dma->burst);
+
 	return mse_packet_ctrl_send_packet_common(index,
 						  dma,
 						  ops,
-						  dma->write_p);
+						  packetized);
 }
 
 int mse_packet_ctrl_send_packet_wait(int index,
 				     struct mse_packet_ctrl *dma,
 				     struct mse_adapter_network_ops *ops)
 {
+	unsigned int packetized;
+
+	packetized = mse_packet_ctrl_remain(smp_load_acquire(&dma->wait_p),
+					    dma->send_p);
+
 	return mse_packet_ctrl_send_packet_common(index,
 						  dma,
 						  ops,
-						  dma->wait_p);
+						  packetized);
 }
 
 int mse_packet_ctrl_receive_prepare_packet(
@@ -335,6 +1093,9 @@ int mse_packet_ctrl_receive_prepare_packet(
 				struct mse_packet_ctrl *dma,
 				struct mse_adapter_network_ops *ops)
 {
+	/* all slots are armed for receive */
+	mse_packet_ctrl_sync_for_device(dma, 0, dma->size);
+
 	return ops->receive_prepare(index,
 				    dma->packet_table,
 				    dma->size);
@@ -345,19 +1106,18 @@ int mse_packet_ctrl_receive_packet(int index,
 				   struct mse_packet_ctrl *dma,
 				   struct mse_adapter_network_ops *ops)
 {
-	int write_p, ret;
-	int received = 0, empty_slot;
-	int size = min(max_size, MSE_PACKET_COUNT_MAX);
+	unsigned int write_p = dma->write_p;
+	unsigned int empty_slot;
+	int size = min(max_size, dma->burst);
+	int ret;
 
-	mse_debug("network adapter=%s r=%d w=%d\n",
-		  ops->name, dma->read_p, dma->write_p);
+	mse_debug("network adapter=%s w=%u\n", ops->name, write_p);
 
-	received = mse_packet_ctrl_check_packet_remain(dma);
-	empty_slot = (dma->size - 1) - received;
+	empty_slot = mse_packet_ctrl_free_slots(dma, write_p, size);
 
 	/* receive overrun */
 	if (empty_slot == 0)
-		return received;
+		return dma->size - 1;
 
 	if (size > empty_slot)
 		size = empty_slot;
@@ -366,50 +1126,15 @@ int mse_packet_ctrl_receive_packet(int index,
 	if (ret < 0)
 		return ret;
 
-	write_p = dma->write_p; /* for debug */
-	dma->write_p = (write_p + ret) % dma->size;
+	mse_packet_ctrl_sync_for_cpu(dma, write_p, ret);
+	mse_packet_ctrl_fill_meta(dma, write_p, ret);
 
-	mse_debug("%d packtets r=%d w=%d->%d\n",
-		  ret, dma->read_p, write_p, dma->write_p);
+	/* publish received packets to consumer */
+	smp_store_release(&dma->write_p, write_p + ret);
 
-	return mse_packet_ctrl_check_packet_remain(dma);
-}
-
-/* TODO: Remove. it is same as mse_packet_ctrl_receive_packet */
-int mse_packet_ctrl_receive_packet_crf(int index,
-				       int max_size,
-				       struct mse_packet_ctrl *dma,
-				       struct mse_adapter_network_ops *ops)
-{
-	int write_p, ret;
-	int size = max_size;
+	mse_debug("%d packtets w=%u->%u\n", ret, write_p, write_p + ret);
 
-	mse_debug("network adapter=%s r=%d w=%d\n",
-		  ops->name, dma->read_p, dma->write_p);
-
-	if (dma->read_p > dma->write_p &&
-	    dma->read_p < dma->write_p + size) {
-		mse_info("receive overrun r=%d w=%d size=%d/%d\n",
-			 dma->read_p, dma->write_p, size, max_size);
-		return -ENOSPC;
-	}
-
-	ret = ops->receive(index, size);
-	if (ret < 0) {
-		mse_err("receive error %d\n", ret);
-		return -EPERM;
-	}
-
-	write_p = dma->write_p; /* for debug */
-	dma->write_p = (write_p + ret) % dma->size;
-
-	mse_debug("%d packtets r=%d w=%d->%d\n",
-		  ret, dma->read_p, write_p, dma->write_p);
-
-	if (ret != size)
-		return -EINTR; /* for cancel */
-	else
-		return 0;
+	return mse_packet_ctrl_remain(write_p + ret, dma->read_p_cache);
 }
 
 int mse_packet_ctrl_take_out_packet(int index,
@@ -423,35 +1148,38 @@ int mse_packet_ctrl_take_out_packet(int index,
 				    size_t *processed)
 {
 	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
+	unsigned int read_p = dma->read_p;
+	struct mse_packet *packet;
 	unsigned int recv_time;
 	int pcount = 0;
 	int received;
+	u16 *len = dma->meta.len;
 
-	mse_debug("r=%d w=%d s=%d v=%p\n",
-		  dma->read_p, dma->write_p, dma->size,
-		  dma->packet_table[dma->read_p].vaddr);
+	mse_debug("r=%u s=%d\n", read_p, dma->size);
 
 	*timestamps_stored = 0;
 
-	received = mse_packet_ctrl_check_packet_remain(dma);
+	received = mse_packet_ctrl_filled_slots(dma, read_p, dma->size);
 	while (received-- > 0 && *timestamps_stored < timestamps_size) {
+		packet = mse_packet_ctrl_slot(dma, read_p);
 		ret = ops->depacketize(index,
 				       data,
 				       size,
 				       processed,
 				       &recv_time,
-				       dma->packet_table[dma->read_p].vaddr,
-				       dma->packet_table[dma->read_p].len);
+				       packet->vaddr,
+				       len[mse_packet_ctrl_meta_index(dma,
+								      read_p)]);
 		if (ret == MSE_PACKETIZE_STATUS_SKIP)
 			break;
 
-		dma->read_p = (dma->read_p + 1) % dma->size;
+		read_p++;
 
 		if (ret == MSE_PACKETIZE_STATUS_DISCARD)
 			continue;
 
 		if (ret < 0)
-			return -EIO;
+			break;
 
 		pcount++;
 
@@ -463,9 +1191,16 @@ int mse_packet_ctrl_take_out_packet(int index,
 
 		/* update received count */
 		if (received <= 0)
-			received = mse_packet_ctrl_check_packet_remain(dma);
+			received = mse_packet_ctrl_filled_slots(dma, read_p,
+								dma->size);
 	}
 
+	/* return slots to producer */
+	mse_packet_ctrl_release_slots(dma, read_p);
+
+	if (ret < 0)
+		return -EIO;
+
 	if (ret == MSE_PACKETIZE_STATUS_CONTINUE &&
 	    (pcount > 0 || received <= 0)) {
 		mse_debug("depacketize not enough. processed packet=%d(processed=%zu, ret=%d)\n",
@@ -485,22 +1220,23 @@ int mse_packet_ctrl_take_out_packet_crf(
 	int ret;
 	int count = 0;
 	size_t crf_len;
+	unsigned int read_p = dma->read_p;
+	struct mse_packet *packet;
 
-	mse_debug("r=%d w=%d s=%d v=%p\n",
-		  dma->read_p, dma->write_p, dma->size,
-		  dma->packet_table[dma->read_p].vaddr);
+	mse_debug("r=%u s=%d\n", read_p, dma->size);
 
-	if (dma->read_p == dma->write_p)
+	if (!mse_packet_ctrl_filled_slots(dma, read_p, 1))
 		return 0;
 
+	packet = mse_packet_ctrl_slot(dma, read_p);
 	ret = mse_packetizer_crf_timestamp_audio_ops.depacketize(
 		index, timestamps, timestamps_size * sizeof(*timestamps),
 		&crf_len,
 		NULL,
-		dma->packet_table[dma->read_p].vaddr,
-		dma->packet_table[dma->read_p].len);
+		packet->vaddr,
+		dma->meta.len[mse_packet_ctrl_meta_index(dma, read_p)]);
 
-	dma->read_p = (dma->read_p + 1) % dma->size;
+	mse_packet_ctrl_release_slots(dma, read_p + 1);
 
 	if (ret < 0)
 		return -EIO;
@@ -513,3 +1249,161 @@ int mse_packet_ctrl_take_out_packet_crf(
 	/* return the number of timestamp */
 	return count;
 }
+
+void mse_packet_ctrl_demux_init(struct mse_packet_demux *demux)
+{
+	mutex_init(&demux->lock);
+	hash_init(demux->table);
+}
+
+void mse_packet_ctrl_demux_add(struct mse_packet_demux *demux,
+			       struct mse_packet_demux_entry *entry,
+			       struct mse_packet_ctrl *dma)
+{
+	mutex_lock(&demux->lock);
+	entry->dma = dma;
+	entry->f_enabled = false;
+	entry->received = 0;
+	hash_add_rcu(demux->table, &entry->node, entry->hash);
+	mutex_unlock(&demux->lock);
+}
+
+/* entry is not referred by demux when it returns */
+void mse_packet_ctrl_demux_del(struct mse_packet_demux *demux,
+			       struct mse_packet_demux_entry *entry)
+{
+	mutex_lock(&demux->lock);
+	hash_del_rcu(&entry->node);
+	mutex_unlock(&demux->lock);
+
+	synchronize_rcu();
+}
+
+void mse_packet_ctrl_demux_set_streamid(struct mse_packet_demux *demux,
+					struct mse_packet_demux_entry *entry,
+					u8 streamid[8])
+{
+	mutex_lock(&demux->lock);
+	hash_del_rcu(&entry->node);
+	synchronize_rcu();
+	entry->streamid = get_unaligned_be64(streamid);
+	entry->hash = mse_packet_ctrl_stream_hash(entry->streamid);
+	hash_add_rcu(demux->table, &entry->node, entry->hash);
+	mutex_unlock(&demux->lock);
+}
+
+/*
+ * packets are stored into dma of entry only while it is enabled, no more
+ * packets are stored when disable returns
+ */
+void mse_packet_ctrl_demux_enable(struct mse_packet_demux *demux,
+				  struct mse_packet_demux_entry *entry,
+				  bool enable)
+{
+	mutex_lock(&demux->lock);
+	WRITE_ONCE(entry->f_enabled, enable);
+	mutex_unlock(&demux->lock);
+
+	if (!enable)
+		synchronize_rcu();
+}
+
+/*
+ * lookup by stream ID in metadata, slot itself is not touched. Called
+ * in RCU read side, the entry is valid until rcu_read_unlock().
+ */
+static struct mse_packet_demux_entry *mse_packet_ctrl_demux_lookup(
+	struct mse_packet_demux *demux,
+	u64 streamid)
+{
+	struct mse_packet_demux_entry *entry;
+	u32 hash = mse_packet_ctrl_stream_hash(streamid);
+
+	hash_for_each_possible_rcu(demux->table, entry, node, hash) {
+		if (entry->streamid == streamid)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Producer side of dst: copy a packet and its metadata */
+static int mse_packet_ctrl_store_packet(struct mse_packet_ctrl *dst,
+					struct mse_packet_ctrl *src,
+					unsigned int pos)
+{
+	unsigned int write_p = dst->write_p;
+	unsigned int i, j;
+
+	if (!mse_packet_ctrl_free_slots(dst, write_p, 1))
+		return -ENOSPC;
+
+	i = mse_packet_ctrl_meta_index(src, pos);
+	j = mse_packet_ctrl_meta_index(dst, write_p);
+
+	memcpy(mse_packet_ctrl_slot(dst, write_p)->vaddr,
+	       mse_packet_ctrl_slot(src, pos)->vaddr,
+	       min_t(int, src->meta.len[i], dst->max_packet_size));
+	dst->meta.len[j] = min_t(int, src->meta.len[i],
+				 dst->max_packet_size);
+	dst->meta.subtype[j] = src->meta.subtype[i];
+	dst->meta.tv[j] = src->meta.tv[i];
+	dst->meta.streamid[j] = src->meta.streamid[i];
+	dst->meta.avtp_timestamp[j] = src->meta.avtp_timestamp[i];
+
+	/* publish stored packet to consumer */
+	smp_store_release(&dst->write_p, write_p + 1);
+
+	return 0;
+}
+
+/*
+ * Consumer side of dma: dispatch all received packets to the entries of
+ * demux. Packets of unknown or disabled streams are dropped. It takes no
+ * lock, entries are looked up in RCU read side and the lock of demux only
+ * serializes their updates.
+ */
+int mse_packet_ctrl_demux_packet(struct mse_packet_ctrl *dma,
+				 struct mse_packet_demux *demux)
+{
+	struct mse_packet_demux_entry *entry;
+	unsigned int read_p = dma->read_p;
+	int received, count = 0;
+	int bkt;
+
+	received = mse_packet_ctrl_filled_slots(dma, read_p, dma->size);
+	if (!received)
+		return 0;
+
+	rcu_read_lock();
+
+	for (; received > 0; received--, read_p++) {
+		entry = mse_packet_ctrl_demux_lookup(
+			demux,
+			dma->meta.streamid[mse_packet_ctrl_meta_index(dma,
+								      read_p)]);
+		if (!entry || !READ_ONCE(entry->f_enabled))
+			continue;
+
+		if (mse_packet_ctrl_store_packet(entry->dma, dma, read_p)) {
+			mse_debug("demux overrun hash=%08x\n", entry->hash);
+			continue;
+		}
+
+		entry->received++;
+		count++;
+	}
+
+	/* return slots to producer */
+	mse_packet_ctrl_release_slots(dma, read_p);
+
+	hash_for_each_rcu(demux->table, bkt, entry, node) {
+		if (entry->received && entry->notify)
+			entry->notify(entry);
+		entry->received = 0;
+	}
+
+	rcu_read_unlock();
+
+	return count;
+}
@@ -62,25 +62,170 @@
 #ifndef __MSE_PACKET_CTRL_H__
 #define __MSE_PACKET_CTRL_H__
 
+#include <linux/hash.h>
+#include <linux/hashtable.h>
+#include <linux/mutex.h>
+#include <asm/unaligned.h>
+
+/*
+ * Packet ring shared by exactly one producer and one consumer.
+ *
+ * TX: producer is the packetize work, consumer is the stream work.
+ * RX: producer is the stream work, consumer is the depacketize work.
+ *
+ * write_p, read_p and wait_p are free running counters, the slot is
+ * selected by masking them with (size - 1), so size is a power of two.
+ * Each side publishes its own index with smp_store_release() and reads
+ * the other side with smp_load_acquire(), and keeps a cached copy of the
+ * opposite index to avoid touching the remote cache line on every packet.
+ *
+ * With MSE_PACKET_BUFFER_TYPE_STREAMING the packet area is cacheable, the
+ * slots are synced only when handed to or taken from the network adapter.
+ *
+ * TX consumer hands packets [read_p, send_p) to the network adapter, they
+ * go back to the producer only when the adapter reports them completed,
+ * see reap of mse_adapter_network_ops. send_p is private to the consumer.
+ *
+ * With zero copy, a TX slot holds the headers only and its payload vectors
+ * refer to the media buffer. They stay mapped until the slot is completed.
+ *
+ * The slots have no memory until mse_packet_ctrl_attach(), it borrows
+ * chunks from a pool shared by all packet buffers and
+ * mse_packet_ctrl_detach() returns them. While TX packets are in flight,
+ * detach keeps the chunks and returns -EBUSY, mse_packet_ctrl_free() drops
+ * them as network adapter is released before. A local packet buffer is never
+ * handed to the device, its chunks are plain kernel memory.
+ *
+ * RX packet buffer has metadata of each slot, parsed from AVTP header by
+ * the producer when packets are received. It is kept in separate arrays
+ * indexed like packet_table, so the consumer scans them without touching
+ * slots.
+ */
+struct mse_packet_meta {
+	u16 *len;
+	u8 *subtype;
+	bool *tv;
+	u64 *streamid;
+	u32 *avtp_timestamp;
+};
+
+/* sizes of batches passed to send of network adapter */
+struct mse_packet_batch_stats {
+	u32 sends;
+	u32 max;
+	u64 packets;
+};
+
 struct mse_packet_ctrl {
 	struct device *dev;
 	int size;
-	int write_p;
-	int read_p;
-	int wait_p;
+	unsigned int mask;
+	int burst;
 	int max_packet_size;
-	dma_addr_t dma_handle;
-	void *dma_vaddr;
+	enum MSE_PACKET_BUFFER_TYPE type;
+	enum dma_data_direction dir;
+	struct list_head chunk_list;
 	struct mse_packet *packet_table;
+	struct mse_packet_meta meta;
+	bool f_prestamped;
+	bool f_zero_copy;
+	bool f_local;
+
+	/* producer side */
+	unsigned int write_p ____cacheline_aligned_in_smp;
+	unsigned int wait_p;
+	unsigned int read_p_cache;
+
+	/* consumer side */
+	unsigned int read_p ____cacheline_aligned_in_smp;
+	unsigned int send_p;
+	unsigned int write_p_cache;
+	struct mse_packet_batch_stats batch_stats;
 };
 
+/*
+ * Demultiplexer of packets received by a packet buffer which is shared by
+ * several streams. Each packet is copied into the packet buffer of the
+ * entry having its stream ID, the entries are looked up by stream hash.
+ * The table is RCU protected, lock serializes updates of entries only.
+ */
+#define MSE_PACKET_DEMUX_HASH_BITS (4)
+
+struct mse_packet_demux_entry {
+	struct hlist_node node;
+	u32 hash;
+	u64 streamid;
+	struct mse_packet_ctrl *dma;
+	bool f_enabled;
+	int received;
+	/* called after packets are stored into dma */
+	void (*notify)(struct mse_packet_demux_entry *entry);
+};
+
+struct mse_packet_demux {
+	struct mutex lock;
+	DECLARE_HASHTABLE(table, MSE_PACKET_DEMUX_HASH_BITS);
+};
+
+static inline struct mse_packet *mse_packet_ctrl_slot(
+	struct mse_packet_ctrl *dma,
+	unsigned int pos)
+{
+	return &dma->packet_table[pos & dma->mask];
+}
+
+static inline int mse_packet_ctrl_packet_size(struct mse_packet_ctrl *dma)
+{
+	return dma->max_packet_size;
+}
+
+static inline bool mse_packet_ctrl_is_attached(struct mse_packet_ctrl *dma)
+{
+	return !list_empty(&dma->chunk_list);
+}
+
+/* index of metadata arrays for the slot at pos */
+static inline unsigned int mse_packet_ctrl_meta_index(
+	struct mse_packet_ctrl *dma,
+	unsigned int pos)
+{
+	return pos & dma->mask;
+}
+
+static inline u32 mse_packet_ctrl_stream_hash(u64 streamid)
+{
+	return hash_64(streamid, 32);
+}
+
+static inline unsigned int mse_packet_ctrl_write_pos(
+	struct mse_packet_ctrl *dma)
+{
+	return smp_load_acquire(&dma->write_p);
+}
+
 int mse_packet_ctrl_check_packet_remain(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_check_packet_unsent(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_check_packet_inflight(struct mse_packet_ctrl *dma);
+bool mse_packet_ctrl_is_completed(struct mse_packet_ctrl *dma,
+				  unsigned int pos);
+bool mse_packet_ctrl_get_head_timestamp(struct mse_packet_ctrl *dma,
+					u32 *timestamp);
 int mse_packet_ctrl_check_packet_remain_wait(struct mse_packet_ctrl *dma);
 void mse_packet_ctrl_release_all_wait(struct mse_packet_ctrl *dma);
+void mse_packet_ctrl_release_wait(struct mse_packet_ctrl *dma,
+				  unsigned int release_p);
 struct mse_packet_ctrl *mse_packet_ctrl_alloc(struct device *dev,
 					      int max_packet,
-					      int max_packet_size);
+					      int max_packet_size,
+					      struct mse_packet_buffer_config *config,
+					      bool tx);
 void mse_packet_ctrl_free(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_set_local(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_set_packet_size(struct mse_packet_ctrl *dma,
+				    int max_packet_size);
+int mse_packet_ctrl_attach(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_detach(struct mse_packet_ctrl *dma);
+void mse_packet_ctrl_pool_destroy(void);
 int mse_packet_ctrl_make_packet(int index,
 				void *data,
 				size_t size,
@@ -91,6 +236,9 @@ int mse_packet_ctrl_make_packet(int index,
 				struct mse_packet_ctrl *dma,
 				struct mse_packetizer_ops *ops,
 				size_t *processed);
+int mse_packet_ctrl_prepare_packets(int index,
+				    struct mse_packet_ctrl *dma,
+				    struct mse_packetizer_ops *ops);
 int mse_packet_ctrl_send_prepare_packet(int index,
 					struct mse_packet_ctrl *dma,
 					struct mse_adapter_network_ops *ops);
@@ -100,6 +248,9 @@ int mse_packet_ctrl_send_packet(int index,
 int mse_packet_ctrl_send_packet_wait(int index,
 				     struct mse_packet_ctrl *dma,
 				     struct mse_adapter_network_ops *ops);
+int mse_packet_ctrl_reap_packet(int index,
+				struct mse_packet_ctrl *dma,
+				struct mse_adapter_network_ops *ops);
 int mse_packet_ctrl_receive_prepare_packet(int index,
 					   struct mse_packet_ctrl *dma,
 					   struct mse_adapter_network_ops *ops);
@@ -107,10 +258,6 @@ int mse_packet_ctrl_receive_packet(int index,
 				   int max_size,
 				   struct mse_packet_ctrl *dma,
 				   struct mse_adapter_network_ops *ops);
-int mse_packet_ctrl_receive_packet_crf(int index,
-				       int max_size,
-				       struct mse_packet_ctrl *dma,
-				       struct mse_adapter_network_ops *ops);
 int mse_packet_ctrl_take_out_packet(int index,
 				    void *data,
 				    size_t size,
@@ -128,6 +275,20 @@ int mse_packet_ctrl_take_out_packet_crf(int index,
 					u64 *timestamps,
 					int timestamps_size,
 					struct mse_packet_ctrl *dma);
-void mse_packet_ctrl_discard_packet(struct mse_packet_ctrl *dma);
+int mse_packet_ctrl_discard_packet(struct mse_packet_ctrl *dma);
+void mse_packet_ctrl_demux_init(struct mse_packet_demux *demux);
+void mse_packet_ctrl_demux_add(struct mse_packet_demux *demux,
+			       struct mse_packet_demux_entry *entry,
+			       struct mse_packet_ctrl *dma);
+void mse_packet_ctrl_demux_del(struct mse_packet_demux *demux,
+			       struct mse_packet_demux_entry *entry);
+void mse_packet_ctrl_demux_set_streamid(struct mse_packet_demux *demux,
+					struct mse_packet_demux_entry *entry,
+					u8 streamid[8]);
+void mse_packet_ctrl_demux_enable(struct mse_packet_demux *demux,
+				  struct mse_packet_demux_entry *entry,
+				  bool enable);
+int mse_packet_ctrl_demux_packet(struct mse_packet_ctrl *dma,
+				 struct mse_packet_demux *demux);
 
 #endif /* __MSE_PACKET_CTRL_H__ */
@@ -71,6 +71,9 @@
 
 #define CBS_ADJUSTMENT_FACTOR   (103) /* percent */
 
+/* smaller payload is copied, mapping costs more than copying it */
+#define ZERO_COPY_PAYLOAD_MIN   (256)
+
 /**
  * @brief packetizer status
  */
@@ -149,6 +152,11 @@ struct mse_packetizer_ops {
 	/** @brief calc_cbs function pointer */
 	int (*calc_cbs)(int index, struct mse_cbsparam *cbs);
 
+	/** @brief write static header into all packets, optional */
+	int (*prepare_packets)(int index,
+			       struct mse_packet *packets,
+			       int num_packets);
+
 	/** @brief packetize function pointer */
 	int (*packetize)(int index,
 			 void *packet,
@@ -157,6 +165,38 @@ struct mse_packetizer_ops {
 			 size_t buffer_size,
 			 size_t *buffer_processed,
 			 unsigned int *timestamp);
+	/**
+	 * @brief packetize without copying payload, optional
+	 *
+	 * Only headers are written to packet. Payload is left in buffer
+	 * and reported by payload_offset and payload_size, payload_size
+	 * is 0 when whole packet was written to packet.
+	 */
+	int (*packetize_sg)(int index,
+			    void *packet,
+			    size_t *packet_size,
+			    void *buffer,
+			    size_t buffer_size,
+			    size_t *buffer_processed,
+			    unsigned int *timestamp,
+			    size_t *payload_offset,
+			    size_t *payload_size);
+	/**
+	 * @brief packetize into several packets in one call, optional
+	 *
+	 * Fills packets[] in order, packets[i] is stamped with
+	 * timestamps[i] and its len is set. Stops after num_packets or
+	 * when a packetize step does not return CONTINUE, that status is
+	 * stored in status. Returns the number of packets filled.
+	 */
+	int (*packetize_burst)(int index,
+			       struct mse_packet **packets,
+			       unsigned int *timestamps,
+			       int num_packets,
+			       void *buffer,
+			       size_t buffer_size,
+			       size_t *buffer_processed,
+			       int *status);
 	/** @brief depacketize function pointer */
 	int (*depacketize)(int index,
 			   void *buffer,
@@ -165,6 +205,15 @@ struct mse_packetizer_ops {
 			   unsigned int *timestamp,
 			   void *packet,
 			   size_t packet_size);
+	/** @brief get NAL index of depacketized frame, optional */
+	int (*get_nal_index)(int index, struct mse_nal_index *nal_index);
+	/**
+	 * @brief set marker offsets of next buffer to packetize, optional
+	 *
+	 * markers is NULL when media adapter did not scan the buffer.
+	 */
+	int (*set_jpeg_markers)(int index,
+				const struct mse_jpeg_markers *markers);
 };
 
 /* Audio Packetizer for AAF */
@@ -67,10 +67,11 @@
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <uapi/linux/if_ether.h>
-#include <linux/of_device.h>
+#include <asm/unaligned.h>
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
+#include "mse_sample.h"
 #include "avtp.h"
 
 struct avtp_aaf_param {
@@ -84,6 +85,12 @@ struct avtp_aaf_param {
 	int sample_rate;
 };
 
+/* convert count samples, shift is applied to value of a sample */
+typedef void (*aaf_copy_func)(unsigned char *dest,
+			      const unsigned char *src,
+			      int count,
+			      int shift);
+
 struct aaf_packetizer {
 	bool used_f;
 	bool piece_f;
@@ -99,11 +106,16 @@ struct aaf_packetizer {
 	int avtp_bytes_per_ch;
 	int shift;
 
+	/* sample converters chosen by audio config, NULL is memcpy */
+	aaf_copy_func copy_to_payload;
+	aaf_copy_func copy_to_buffer;
+
 	int class_interval_frames;
 
 	int piece_data_len;
 	bool f_warned;
 	bool f_need_calc_offset;
+	bool f_prestamped;
 	u32 start_time;
 
 	unsigned char packet_template[ETHFRAMELEN_MAX];
@@ -116,6 +128,8 @@ struct aaf_packetizer {
 
 struct aaf_packetizer aaf_packetizer_table[MSE_INSTANCE_MAX];
 
+static void aaf_select_copy(struct aaf_packetizer *aaf);
+
 static enum AVTP_AAF_FORMAT get_aaf_format(enum MSE_AUDIO_BIT bit_depth)
 {
 	switch (bit_depth) {
@@ -420,6 +434,7 @@ static int mse_packetizer_aaf_set_audio_config(int index,
 	aaf->avtp_format = get_aaf_format(aaf->audio_config.sample_bit_depth);
 	aaf->avtp_bytes_per_ch = get_aaf_format_size(aaf->avtp_format);
 	aaf->shift = get_bit_shift(aaf->audio_config.sample_bit_depth);
+	aaf_select_copy(aaf);
 
 	/* when samples_per_frame is not set */
 	if (!aaf->audio_config.samples_per_frame) {
@@ -456,6 +471,31 @@ static int mse_packetizer_aaf_set_audio_config(int index,
 	param.sample_rate = aaf->audio_config.sample_rate;
 
 	mse_packetizer_aaf_header_build(aaf->packet_template, &param);
+	aaf->f_prestamped = false;
+
+	return 0;
+}
+
+static int mse_packetizer_aaf_prepare_packets(int index,
+					      struct mse_packet *packets,
+					      int num_packets)
+{
+	struct aaf_packetizer *aaf;
+	int i;
+
+	if (index >= ARRAY_SIZE(aaf_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+	aaf = &aaf_packetizer_table[index];
+
+	for (i = 0; i < num_packets; i++)
+		memcpy(packets[i].vaddr, aaf->packet_template,
+		       aaf->avtp_packet_size);
+
+	aaf->f_prestamped = true;
 
 	return 0;
 }
@@ -501,6 +541,154 @@ static int mse_packetizer_aaf_calc_cbs(int index,
 			cbs);
 }
 
+static inline u32 aaf_get_be24(const unsigned char *p)
+{
+	return p[0] << 16 | p[1] << 8 | p[2];
+}
+
+static inline u32 aaf_get_le24(const unsigned char *p)
+{
+	return p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static inline u32 aaf_get_be32(const unsigned char *p)
+{
+	return get_unaligned_be32(p);
+}
+
+static inline void aaf_put_be24(u32 value, unsigned char *p)
+{
+	p[0] = value >> 16;
+	p[1] = value >> 8;
+	p[2] = value;
+}
+
+static inline void aaf_put_le24(u32 value, unsigned char *p)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+}
+
+static inline void aaf_put_be32(u32 value, unsigned char *p)
+{
+	put_unaligned_be32(value, p);
+}
+
+/* buffer to payload, value is shifted left to MSB of AAF format */
+#define DEFINE_AAF_COPY_TO_PAYLOAD(name, src_byte, get, dest_byte, put) \
+	static void name(unsigned char *dest, \
+			 const unsigned char *src, \
+			 int count, \
+			 int shift) \
+	{ \
+		int i; \
+		for (i = 0; i < count; i++) { \
+			put(get(src) << shift, dest); \
+			src += src_byte; \
+			dest += dest_byte; \
+		} \
+	}
+
+DEFINE_AAF_COPY_TO_PAYLOAD(aaf_copy_s24le_to_int24, 3, aaf_get_le24,
+			   3, aaf_put_be24)
+DEFINE_AAF_COPY_TO_PAYLOAD(aaf_copy_s24be_to_int24, 3, aaf_get_be24,
+			   3, aaf_put_be24)
+DEFINE_AAF_COPY_TO_PAYLOAD(aaf_copy_s32be_to_int24, 4, aaf_get_be32,
+			   3, aaf_put_be24)
+
+/* payload to buffer, shift is right when positive, S24 is sign extended */
+#define DEFINE_AAF_COPY_TO_BUFFER(name, src_byte, get, dest_byte, put) \
+	static void name(unsigned char *dest, \
+			 const unsigned char *src, \
+			 int count, \
+			 int shift) \
+	{ \
+		u32 value; \
+		int i; \
+		for (i = 0; i < count; i++) { \
+			value = get(src); \
+			value = shift > 0 ? value >> shift : value << -shift; \
+			if (dest_byte == 4 && src_byte == 3 && \
+			    (value & 0x800000)) \
+				value |= 0xFF000000; \
+			put(value, dest); \
+			src += src_byte; \
+			dest += dest_byte; \
+		} \
+	}
+
+DEFINE_AAF_COPY_TO_BUFFER(aaf_copy_int24_to_s24le, 3, aaf_get_be24,
+			  3, aaf_put_le24)
+DEFINE_AAF_COPY_TO_BUFFER(aaf_copy_int24_to_s24be, 3, aaf_get_be24,
+			  3, aaf_put_be24)
+DEFINE_AAF_COPY_TO_BUFFER(aaf_copy_int24_to_s32be, 3, aaf_get_be24,
+			  4, aaf_put_be32)
+
+/* little endian samples without shift, same for both directions */
+#define DEFINE_AAF_COPY_SAMPLE(name, func) \
+	static void name(unsigned char *dest, \
+			 const unsigned char *src, \
+			 int count, \
+			 int shift) \
+	{ \
+		func(dest, src, count); \
+	}
+
+DEFINE_AAF_COPY_SAMPLE(aaf_copy_swap16, mse_sample_swap16)
+DEFINE_AAF_COPY_SAMPLE(aaf_copy_swap24, mse_sample_swap24)
+DEFINE_AAF_COPY_SAMPLE(aaf_copy_swap32, mse_sample_swap32)
+DEFINE_AAF_COPY_SAMPLE(aaf_copy_pack24, mse_sample_pack24)
+DEFINE_AAF_COPY_SAMPLE(aaf_copy_unpack24, mse_sample_unpack24)
+
+/*
+ * choose converters for bytes_per_sample, AAF format, shift and endian.
+ * same size of big endian samples without shift is copied by memcpy.
+ */
+static void aaf_select_copy(struct aaf_packetizer *aaf)
+{
+	struct mse_audio_config *config = &aaf->audio_config;
+	bool big_endian = config->is_big_endian;
+
+	aaf->copy_to_payload = NULL;
+	aaf->copy_to_buffer = NULL;
+
+	switch (config->bytes_per_sample) {
+	case 2:
+		if (!big_endian) {
+			aaf->copy_to_payload = aaf_copy_swap16;
+			aaf->copy_to_buffer = aaf_copy_swap16;
+		}
+		break;
+	case 3:
+		if (aaf->shift) {
+			aaf->copy_to_payload = big_endian ?
+				aaf_copy_s24be_to_int24 :
+				aaf_copy_s24le_to_int24;
+			aaf->copy_to_buffer = big_endian ?
+				aaf_copy_int24_to_s24be :
+				aaf_copy_int24_to_s24le;
+		} else if (!big_endian) {
+			aaf->copy_to_payload = aaf_copy_swap24;
+			aaf->copy_to_buffer = aaf_copy_swap24;
+		}
+		break;
+	case 4:
+		if (aaf->avtp_format == AVTP_AAF_FORMAT_INT_24BIT) {
+			aaf->copy_to_payload = big_endian ?
+				aaf_copy_s32be_to_int24 : aaf_copy_pack24;
+			aaf->copy_to_buffer = big_endian ?
+				aaf_copy_int24_to_s32be : aaf_copy_unpack24;
+		} else if (!big_endian) {
+			aaf->copy_to_payload = aaf_copy_swap32;
+			aaf->copy_to_buffer = aaf_copy_swap32;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 static void copy_bit_to_payload(unsigned char *dest, int dest_type,
 				unsigned char *src, int src_byte, int shift,
 				bool big_endian)
@@ -549,8 +737,17 @@ static void copy_payload(unsigned char *payload,
 {
 	int i;
 
-	*payload_stored = 0;
-	*buffer_stored = 0;
+	*payload_stored = count * aaf->avtp_bytes_per_ch;
+	*buffer_stored = count * aaf->audio_config.bytes_per_sample;
+
+	if (aaf->copy_to_payload) {
+		aaf->copy_to_payload(payload, buffer, count, aaf->shift);
+		return;
+	} else if (aaf->avtp_bytes_per_ch ==
+		   aaf->audio_config.bytes_per_sample) {
+		memcpy(payload, buffer, *payload_stored);
+		return;
+	}
 
 	for (i = 0; i < count; i++) {
 		copy_bit_to_payload(payload,
@@ -562,8 +759,6 @@ static void copy_payload(unsigned char *payload,
 
 		payload += aaf->avtp_bytes_per_ch;
 		buffer += aaf->audio_config.bytes_per_sample;
-		*payload_stored += aaf->avtp_bytes_per_ch;
-		*buffer_stored += aaf->audio_config.bytes_per_sample;
 	}
 }
 
@@ -626,6 +821,23 @@ static void copy_buffer(unsigned char *buffer,
 			* 8 + aaf->shift;
 	}
 
+	/* converter is chosen for AAF format of audio config */
+	if (aaf_byte_per_ch == aaf->avtp_bytes_per_ch) {
+		if (aaf->copy_to_buffer) {
+			aaf->copy_to_buffer(buffer, payload, count, shift);
+			*buffer_stored = count *
+					 aaf->audio_config.bytes_per_sample;
+			return;
+		}
+
+		if (!shift &&
+		    aaf_byte_per_ch == aaf->audio_config.bytes_per_sample) {
+			*buffer_stored = count * aaf_byte_per_ch;
+			memcpy(buffer, payload, *buffer_stored);
+			return;
+		}
+	}
+
 	for (i = 0; i < count; i++) {
 		copy_bit_to_buffer(buffer,
 				   aaf->audio_config.bytes_per_sample,
@@ -639,31 +851,24 @@ static void copy_buffer(unsigned char *buffer,
 	}
 }
 
-static int mse_packetizer_aaf_packetize(int index,
-					void *packet,
-					size_t *packet_size,
-					void *buffer,
-					size_t buffer_size,
-					size_t *buffer_processed,
-					unsigned int *timestamp)
+static int aaf_packetize(struct aaf_packetizer *aaf,
+			 void *packet,
+			 size_t *packet_size,
+			 void *buffer,
+			 size_t buffer_size,
+			 size_t *buffer_processed,
+			 unsigned int timestamp)
 {
-	struct aaf_packetizer *aaf;
 	int data_len, data_size;
 	unsigned char  *payload, *data;
 	int piece_count = 0, piece_len = 0;
 	int count, dest_byte, readed_byte;
 	struct mse_audio_config *config;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table)) {
-		mse_err("wrong index: %d\n", index);
-		return -EPERM;
-	}
-
-	aaf = &aaf_packetizer_table[index];
 	config = &aaf->audio_config;
-	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%d\n",
-		  index, aaf->send_seq_num, *buffer_processed,
-		  buffer_size, *timestamp);
+	mse_debug("seqnum=%d process=%zu/%zu t=%u\n",
+		  aaf->send_seq_num, *buffer_processed,
+		  buffer_size, timestamp);
 
 	/* header */
 	if (aaf->piece_f) {
@@ -672,7 +877,7 @@ static int mse_packetizer_aaf_packetize(int index,
 		aaf->piece_f = false;
 		aaf->piece_data_len = 0;
 		memcpy(packet, aaf->packet_piece, aaf->avtp_packet_size);
-	} else {
+	} else if (!aaf->f_prestamped) {
 		memcpy(packet, aaf->packet_template, aaf->avtp_packet_size);
 	}
 
@@ -708,7 +913,7 @@ static int mse_packetizer_aaf_packetize(int index,
 
 	/* variable header */
 	avtp_set_sequence_num(packet, aaf->send_seq_num++);
-	avtp_set_timestamp(packet, (u32)*timestamp);
+	avtp_set_timestamp(packet, (u32)timestamp);
 	avtp_set_stream_data_length(packet,
 				    data_size * aaf->avtp_bytes_per_ch);
 	avtp_set_aaf_format(packet, aaf->avtp_format);
@@ -722,6 +927,61 @@ static int mse_packetizer_aaf_packetize(int index,
 		return MSE_PACKETIZE_STATUS_CONTINUE;
 }
 
+static int mse_packetizer_aaf_packetize(int index,
+					void *packet,
+					size_t *packet_size,
+					void *buffer,
+					size_t buffer_size,
+					size_t *buffer_processed,
+					unsigned int *timestamp)
+{
+	if (index >= ARRAY_SIZE(aaf_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	return aaf_packetize(&aaf_packetizer_table[index], packet,
+			     packet_size, buffer, buffer_size,
+			     buffer_processed, *timestamp);
+}
+
+static int mse_packetizer_aaf_packetize_burst(int index,
+					      struct mse_packet **packets,
+					      unsigned int *timestamps,
+					      int num_packets,
+					      void *buffer,
+					      size_t buffer_size,
+					      size_t *buffer_processed,
+					      int *status)
+{
+	struct aaf_packetizer *aaf;
+	size_t packet_size = 0;
+	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
+	int count = 0;
+
+	if (index >= ARRAY_SIZE(aaf_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	aaf = &aaf_packetizer_table[index];
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	while (ret == MSE_PACKETIZE_STATUS_CONTINUE && count < num_packets) {
+		ret = aaf_packetize(aaf, packets[count]->vaddr, &packet_size,
+				    buffer, buffer_size, buffer_processed,
+				    timestamps[count]);
+		if (ret < 0 || ret == MSE_PACKETIZE_STATUS_NOT_ENOUGH)
+			break;
+
+		packets[count++]->len = packet_size;
+	}
+
+	*status = ret;
+
+	return count;
+}
+
 static int mse_packetizer_aaf_depacketize(int index,
 					  void *buffer,
 					  size_t buffer_size,
@@ -731,15 +991,16 @@ static int mse_packetizer_aaf_depacketize(int index,
 					  size_t packet_size)
 {
 	struct aaf_packetizer *aaf;
-	int payload_size, piece_size = 0;
+	int payload_size;
 	u32 offset;
-	unsigned char *buf, tmp_buffer[ETHFRAMEMTU_MAX] = {0};
+	unsigned char *payload;
 	int aaf_format;
 	int aaf_bit_depth;
 	int aaf_byte_per_ch;
 	int aaf_sample_rate;
 	int channels;
-	int count, stored;
+	int count, stored, remain, fit, tail;
+	int bytes_per_sample;
 	int ret;
 	bool tv;
 	u32 avtp_timestamp;
@@ -749,6 +1010,7 @@ static int mse_packetizer_aaf_depacketize(int index,
 
 	mse_debug("index=%d\n", index);
 	aaf = &aaf_packetizer_table[index];
+	bytes_per_sample = aaf->audio_config.bytes_per_sample;
 
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_AAF) {
 		mse_err("error subtype=%d\n", avtp_get_subtype(packet));
@@ -821,43 +1083,50 @@ static int mse_packetizer_aaf_depacketize(int index,
 		*buffer_processed += offset;
 	}
 
-	/* buffer over check */
-	count = payload_size / aaf_byte_per_ch;
-	if (*buffer_processed + count * aaf->audio_config.bytes_per_sample >
-	    buffer_size)
-		buf = tmp_buffer;
-	else
-		buf = buffer + *buffer_processed;
-
 	/* seq_num check */
 	ret = mse_packetizer_stats_seqnum(&aaf->stats, avtp_get_sequence_num(packet));
 	if (ret < 0)
 		mse_err("packet seq num check error, ret=%d\n", ret);
 
-	copy_buffer(buf, &stored,
-		    packet + AVTP_AAF_PAYLOAD_OFFSET,
-		    aaf_byte_per_ch, aaf,
-		    count);
+	count = payload_size / aaf_byte_per_ch;
+	payload = packet + AVTP_AAF_PAYLOAD_OFFSET;
+	remain = buffer_size - *buffer_processed;
+
+	/* buffer over check */
+	if (count * bytes_per_sample <= remain) {
+		copy_buffer(buffer + *buffer_processed, &stored,
+			    payload, aaf_byte_per_ch, aaf, count);
+		*buffer_processed += stored;
+	} else {
+		/* samples over the buffer are kept in piece for next one */
+		fit = remain / bytes_per_sample;
+		count = min_t(int, count, fit + sizeof(aaf->packet_piece) /
+					  bytes_per_sample);
+
+		copy_buffer(buffer + *buffer_processed, &stored,
+			    payload, aaf_byte_per_ch, aaf, fit);
+		copy_buffer(aaf->packet_piece, &aaf->piece_data_len,
+			    payload + fit * aaf_byte_per_ch, aaf_byte_per_ch,
+			    aaf, count - fit);
+
+		/* a sample over the boundary is split */
+		tail = remain - stored;
+		if (tail) {
+			memcpy(buffer + *buffer_processed + stored,
+			       aaf->packet_piece, tail);
+			aaf->piece_data_len -= tail;
+			memmove(aaf->packet_piece, aaf->packet_piece + tail,
+				aaf->piece_data_len);
+		}
 
-	if (*buffer_processed + count * aaf->audio_config.bytes_per_sample >
-	    buffer_size) {
 		aaf->piece_f = true;
-		piece_size = buffer_size - *buffer_processed;
-		aaf->piece_data_len = stored - piece_size;
-		memcpy(buffer + *buffer_processed, buf, piece_size);
-		memcpy(aaf->packet_piece, buf + piece_size,
-		       aaf->piece_data_len);
+		*buffer_processed = buffer_size;
 		mse_debug("piece %d - %02x %02x %02x %02x\n",
 			  aaf->piece_data_len,
 			  aaf->packet_piece[0], aaf->packet_piece[1],
 			  aaf->packet_piece[2], aaf->packet_piece[3]);
 	}
 
-	if (*buffer_processed + stored > buffer_size)
-		*buffer_processed = buffer_size;
-	else
-		*buffer_processed += stored;
-
 	*timestamp = avtp_timestamp;
 
 	/* buffer over check */
@@ -909,6 +1178,8 @@ struct mse_packetizer_ops mse_packetizer_aaf_ops = {
 	.set_start_time = mse_packetizer_aaf_set_start_time,
 	.set_need_calc_offset = mse_packetizer_aaf_set_need_calc_offset,
 	.calc_cbs = mse_packetizer_aaf_calc_cbs,
+	.prepare_packets = mse_packetizer_aaf_prepare_packets,
 	.packetize = mse_packetizer_aaf_packetize,
+	.packetize_burst = mse_packetizer_aaf_packetize_burst,
 	.depacketize = mse_packetizer_aaf_depacketize,
 };
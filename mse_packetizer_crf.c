@@ -255,6 +255,7 @@ static int mse_packetizer_crf_audio_get_audio_info(
 
 	crf = &crf_packetizer_table[index];
 
+	info->avtp_packet_size = crf->crf_packet_size;
 	info->frame_interval_time = crf->frame_interval_time;
 
 	return 0;
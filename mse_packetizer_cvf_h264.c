@@ -67,6 +67,7 @@
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <uapi/linux/if_ether.h>
+#include <asm/unaligned.h>
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
@@ -86,7 +87,14 @@
 #define FU_H_E_BIT        (0x40)
 #define NALU_TYPE_MASK    (0x1F)
 
+#define STAP_A_HEADER_LEN (1)
+#define STAP_A_NALU_SIZE_LEN (2)
+
 #define START_CODE        (0x00000001)
+#define START_CODE_LEN_3B (3)
+
+/* a NAL which did not fit STAP-A and the one before it */
+#define NAL_PEEK_NUM      (2)
 
 enum NALU_TYPE {
 	NALU_TYPE_UNSPECIFIED0  = 0,
@@ -132,6 +140,11 @@ struct avtp_cvf_h264_param {
 	int vid;
 };
 
+struct cvf_h264_nal_peek {
+	unsigned char *nal;
+	unsigned char *nal_end;
+};
+
 struct cvf_h264_packetizer {
 	bool used_f;
 	bool f_start_code;
@@ -144,6 +157,8 @@ struct cvf_h264_packetizer {
 
 	unsigned char *vcl_start;
 	unsigned char *next_nal;
+	struct cvf_h264_nal_peek peek[NAL_PEEK_NUM];
+	int peek_lru;
 	unsigned char fu_indicator;
 	unsigned char fu_header;
 	size_t nal_header_offset;
@@ -152,6 +167,7 @@ struct cvf_h264_packetizer {
 	struct mse_network_config net_config;
 	struct mse_video_config video_config;
 	struct mse_packetizer_stats stats;
+	struct mse_nal_index nal_index;
 };
 
 struct cvf_h264_packetizer cvf_h264_packetizer_table[MSE_INSTANCE_MAX];
@@ -392,19 +408,175 @@ static inline bool is_single_nal(u8 fu_indicator)
 	       nalu_type < NALU_TYPE_STAP_A;
 }
 
-static int mse_packetizer_cvf_h264_packetize(int index,
-					     void *packet,
-					     size_t *packet_size,
-					     void *buffer,
-					     size_t buffer_size,
-					     size_t *buffer_processed,
-					     unsigned int *timestamp)
+/* length of the start code at p, 3 bytes 00 00 01 or 4 bytes */
+static inline int start_code_len(const unsigned char *p,
+				 const unsigned char *end)
+{
+	if (end - p >= START_CODE_LEN_3B && !p[0] && !p[1] && p[2] == 0x01)
+		return START_CODE_LEN_3B;
+
+	return sizeof(u32);
+}
+
+/*
+ * Find the next start code after the NAL starting at nal. memchr() looks
+ * for 0x01 of 00 00 01 and two zero bytes before it are checked, so each
+ * byte is scanned once. Returns the start code position including the
+ * zero byte of the 4 bytes one, or end.
+ */
+static unsigned char *find_start_code(unsigned char *nal,
+				      unsigned char *end)
+{
+	unsigned char *p, *q;
+
+	for (p = nal + 2; p < end; p = q + 1) {
+		q = memchr(p, 0x01, end - p);
+		if (!q)
+			break;
+
+		if (!q[-1] && !q[-2]) {
+			q -= START_CODE_LEN_3B - 1;
+			if (q > nal && !q[-1])
+				q--;
+
+			return q;
+		}
+	}
+
+	return end;
+}
+
+/* NAL at p, returns the NAL header and sets the end of the NAL */
+static unsigned char *parse_nal(struct cvf_h264_packetizer *h264,
+				unsigned char *p,
+				unsigned char *end,
+				unsigned char **nal_end)
+{
+	u32 nal_header;
+	int i;
+
+	if (!h264->f_start_code) {
+		memcpy(&nal_header, p, sizeof(nal_header));
+		p += sizeof(u32);
+		*nal_end = p + ntohl(nal_header);
+
+		return p;
+	}
+
+	/*
+	 * NALs scanned for STAP-A are not scanned again. When STAP-A gives
+	 * up, e.g. AUD and a large slice, the single NAL path parses both.
+	 */
+	p += start_code_len(p, end);
+	for (i = 0; i < NAL_PEEK_NUM; i++)
+		if (h264->peek[i].nal == p)
+			break;
+
+	if (i == NAL_PEEK_NUM) {
+		i = h264->peek_lru;
+		h264->peek[i].nal = p;
+		h264->peek[i].nal_end = find_start_code(p, end);
+	}
+	/* two entries, the other one is least recently used */
+	h264->peek_lru = !i;
+	*nal_end = h264->peek[i].nal_end;
+
+	return p;
+}
+
+/* set M bit at the end of access unit */
+static int cvf_h264_set_mbit(void *packet, bool au_end)
+{
+	if (au_end) {
+		((unsigned char *)packet)[MBIT_ADDR] |= MBIT_SET;
+
+		return MSE_PACKETIZE_STATUS_COMPLETE;
+	}
+
+	((unsigned char *)packet)[MBIT_ADDR] &= ~MBIT_SET;
+
+	return MSE_PACKETIZE_STATUS_CONTINUE;
+}
+
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264_STAP_A)
+/*
+ * Aggregate consecutive small NALs into a STAP-A packet. Returns false
+ * when less than two NALs fit in the packet, they are sent as usual.
+ */
+static bool cvf_h264_packetize_stap_a(struct cvf_h264_packetizer *h264,
+				      void *packet,
+				      size_t *packet_size,
+				      unsigned char *buf,
+				      size_t buffer_size,
+				      size_t *buffer_processed,
+				      unsigned int *timestamp)
+{
+	unsigned char *end = buf + buffer_size;
+	unsigned char *cur = buf + *buffer_processed;
+	unsigned char *nal, *nal_end;
+	unsigned char *payload, *data;
+	u8 nal_f = 0, nal_nri = 0;
+	int nal_size, num = 0;
+
+	payload = packet + h264->header_size;
+	data = payload + STAP_A_HEADER_LEN;
+	while (cur < end) {
+		nal = parse_nal(h264, cur, end, &nal_end);
+		nal_size = nal_end - nal;
+		if (nal_end > end || nal_size <= 0 || !is_single_nal(*nal) ||
+		    data + STAP_A_NALU_SIZE_LEN + nal_size >
+		    payload + h264->data_len_max)
+			break;
+
+		put_unaligned_be16(nal_size, data);
+		memcpy(data + STAP_A_NALU_SIZE_LEN, nal, nal_size);
+		data += STAP_A_NALU_SIZE_LEN + nal_size;
+
+		/* F is OR of NALs, NRI is the maximum of NALs */
+		nal_f |= *nal & FU_I_F_MASK;
+		nal_nri = max_t(u8, nal_nri, *nal & FU_I_NRI_MASK);
+		cur = nal_end;
+		num++;
+	}
+
+	if (num < 2)
+		return false;
+
+	mse_debug("stap-a nal=%d size=%zu\n", num, (size_t)(data - payload));
+
+	/* header */
+	memcpy(packet, h264->packet_template, h264->header_size);
+
+	/* variable header */
+	avtp_set_sequence_num(packet, h264->send_seq_num++);
+	avtp_set_timestamp(packet, (u32)*timestamp);
+	avtp_set_stream_data_length(packet,
+				    data - payload +
+				    h264->additional_header_size);
+
+	payload[FU_ADDR_INDICATOR] = nal_f | nal_nri | NALU_TYPE_STAP_A;
+	*packet_size = data - (unsigned char *)packet;
+	*buffer_processed = cur - buf;
+
+	return true;
+}
+#endif
+
+static int cvf_h264_packetize(int index,
+			      void *packet,
+			      size_t *packet_size,
+			      void *buffer,
+			      size_t buffer_size,
+			      size_t *buffer_processed,
+			      unsigned int *timestamp,
+			      size_t *payload_offset,
+			      size_t *payload_size)
 {
 	struct cvf_h264_packetizer *h264;
 	int data_len;
 	u32 data_offset;
-	u32 nal_size, nal_header;
-	u32 start_code = htonl(START_CODE);
+	u32 nal_size;
+	int header_len;
 	unsigned char *buf = (unsigned char *)buffer;
 	unsigned char *cur_nal;
 	unsigned char *payload;
@@ -419,27 +591,27 @@ static int mse_packetizer_cvf_h264_packetize(int index,
 		  index, h264->send_seq_num, *buffer_processed,
 		  buffer_size, *timestamp);
 
+	if (payload_size)
+		*payload_size = 0;
+
+	/* NAL scanned in the previous buffer is not valid */
+	if (!*buffer_processed)
+		memset(h264->peek, 0, sizeof(h264->peek));
+
 	/* search NAL */
 	cur_nal = buf + *buffer_processed;
 	if (!h264->next_nal) {            /* nal first  */
-		if (h264->f_start_code) {
-			for (h264->next_nal = cur_nal + 1;
-			     h264->next_nal < buf + buffer_size - sizeof(u32);
-			     h264->next_nal++) {
-				if (!memcmp(h264->next_nal, &start_code,
-					    sizeof(u32)))
-					break;
-			}
-			if (h264->next_nal >= buf + buffer_size - sizeof(u32))
-				h264->next_nal = buf + buffer_size;
-			cur_nal += sizeof(u32);
-			nal_size = h264->next_nal - cur_nal;
-		} else {
-			memcpy(&nal_header, cur_nal, sizeof(nal_header));
-			nal_size = ntohl(nal_header);
-			cur_nal += sizeof(u32);
-			h264->next_nal = cur_nal + nal_size;
-		}
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264_STAP_A)
+		if (cvf_h264_packetize_stap_a(h264, packet, packet_size,
+					      buf, buffer_size,
+					      buffer_processed, timestamp))
+			return cvf_h264_set_mbit(packet, *buffer_processed >=
+						 buffer_size);
+#endif
+		cur_nal = parse_nal(h264, cur_nal, buf + buffer_size,
+				    &h264->next_nal);
+		header_len = cur_nal - (buf + *buffer_processed);
+		nal_size = h264->next_nal - cur_nal;
 		mse_debug("seqnum=%d process=%zu/%zu t=%u nal=%d\n",
 			  h264->send_seq_num, *buffer_processed,
 			  buffer_size, *timestamp, nal_size);
@@ -468,7 +640,7 @@ static int mse_packetizer_cvf_h264_packetize(int index,
 #endif
 
 		cur_nal++;
-		(*buffer_processed) += sizeof(u32) + 1;
+		(*buffer_processed) += header_len + 1;
 	} else {
 		h264->fu_header &= ~FU_H_S_BIT;  /* remove start */
 	}
@@ -498,22 +670,67 @@ static int mse_packetizer_cvf_h264_packetize(int index,
 	if (data_offset == FU_HEADER_LEN)
 		payload[FU_ADDR_HEADER] = h264->fu_header;
 
-	memcpy(payload + data_offset, cur_nal, data_len);
-	*packet_size = h264->header_size + data_offset + data_len;
+	if (payload_size && data_len >= ZERO_COPY_PAYLOAD_MIN) {
+		/* NAL fragment is sent from buffer */
+		*payload_offset = cur_nal - buf;
+		*payload_size = data_len;
+		*packet_size = h264->header_size + data_offset;
+	} else {
+		memcpy(payload + data_offset, cur_nal, data_len);
+		*packet_size = h264->header_size + data_offset + data_len;
+	}
 	(*buffer_processed) += data_len;
 
-	if (*buffer_processed >= buffer_size &&
-	    h264->fu_header & FU_H_E_BIT) {
-		/* set M bit */
-		((unsigned char *)packet)[MBIT_ADDR] |= MBIT_SET;
+	return cvf_h264_set_mbit(packet,
+				 *buffer_processed >= buffer_size &&
+				 h264->fu_header & FU_H_E_BIT);
+}
 
-		return MSE_PACKETIZE_STATUS_COMPLETE;
-	}
+static int mse_packetizer_cvf_h264_packetize(int index,
+					     void *packet,
+					     size_t *packet_size,
+					     void *buffer,
+					     size_t buffer_size,
+					     size_t *buffer_processed,
+					     unsigned int *timestamp)
+{
+	return cvf_h264_packetize(index, packet, packet_size,
+				  buffer, buffer_size, buffer_processed,
+				  timestamp, NULL, NULL);
+}
 
-	/* remove M bit */
-	((unsigned char *)packet)[MBIT_ADDR] &= ~MBIT_SET;
+static int mse_packetizer_cvf_h264_packetize_sg(int index,
+						void *packet,
+						size_t *packet_size,
+						void *buffer,
+						size_t buffer_size,
+						size_t *buffer_processed,
+						unsigned int *timestamp,
+						size_t *payload_offset,
+						size_t *payload_size)
+{
+	return cvf_h264_packetize(index, packet, packet_size,
+				  buffer, buffer_size, buffer_processed,
+				  timestamp, payload_offset, payload_size);
+}
 
-	return MSE_PACKETIZE_STATUS_CONTINUE;
+static void add_nal_index(struct cvf_h264_packetizer *h264,
+			  unsigned char *buf,
+			  size_t data_len)
+{
+	struct mse_nal_index *nal_index = &h264->nal_index;
+	struct mse_nal_entry *entry;
+
+	if (nal_index->num >= MSE_NAL_INDEX_MAX) {
+		nal_index->overflow = true;
+		return;
+	}
+
+	entry = &nal_index->entry[nal_index->num++];
+	entry->offset = h264->nal_header_offset;
+	entry->size = data_len - h264->nal_header_offset - sizeof(u32);
+	entry->type = buf[h264->nal_header_offset + sizeof(u32)] &
+		      NALU_TYPE_MASK;
 }
 
 static void set_nal_header(struct cvf_h264_packetizer *h264,
@@ -529,6 +746,7 @@ static void set_nal_header(struct cvf_h264_packetizer *h264,
 				   sizeof(u32));
 
 	memcpy(buf + h264->nal_header_offset, &nal_header, sizeof(u32));
+	add_nal_index(h264, buf, data_len);
 }
 
 static bool check_pic_end(struct cvf_h264_packetizer *h264,
@@ -603,6 +821,12 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 	mse_packetizer_stats_seqnum(&h264->stats,
 				    avtp_get_sequence_num(packet));
 
+	/* new frame */
+	if (!data_len) {
+		h264->nal_index.num = 0;
+		h264->nal_index.overflow = false;
+	}
+
 	payload_size = avtp_get_stream_data_length(packet) -
 		h264->additional_header_size;
 	payload = (unsigned char *)packet + h264->header_size;
@@ -662,6 +886,47 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 
 		pic_end = check_pic_end(h264, buf, nalu_type);
 		set_nal_header(h264, buf, data_len);
+	} else if ((fu_indicator & NALU_TYPE_MASK) == NALU_TYPE_STAP_A) {
+		mse_debug("stap-a size=%d\n", payload_size);
+
+		data_offset = STAP_A_HEADER_LEN;
+		while (data_offset < payload_size) {
+			if (data_offset + STAP_A_NALU_SIZE_LEN > payload_size) {
+				mse_err("STAP-A format error\n");
+				return -EINVAL;
+			}
+
+			fu_size = get_unaligned_be16(payload + data_offset);
+			data_offset += STAP_A_NALU_SIZE_LEN;
+			if (!fu_size || data_offset + fu_size > payload_size) {
+				mse_err("STAP-A nal size error %d\n", fu_size);
+				return -EINVAL;
+			}
+
+			if (data_len + sizeof(u32) + fu_size >= buffer_size) {
+				mse_err("buffer overrun %zu/%zu\n",
+					data_len, buffer_size);
+
+				(*buffer_processed) = data_len;
+				h264->vcl_start = NULL;
+
+				return MSE_PACKETIZE_STATUS_COMPLETE;
+			}
+
+			h264->nal_header_offset = data_len;
+
+			/* Increase data_len by 4 bytes for nal_header */
+			data_len += sizeof(u32);
+
+			nalu_type = payload[data_offset] & NALU_TYPE_MASK;
+			memcpy(buf + data_len, payload + data_offset, fu_size);
+			data_len += fu_size;
+			data_offset += fu_size;
+
+			set_nal_header(h264, buf, data_len);
+			if (check_pic_end(h264, buf, nalu_type))
+				pic_end = true;
+		}
 	} else {
 		mse_err("unkonwon nal unit = %02x\n",
 			fu_indicator & NALU_TYPE_MASK);
@@ -686,6 +951,23 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 	return MSE_PACKETIZE_STATUS_COMPLETE;
 }
 
+static int mse_packetizer_cvf_h264_get_nal_index(
+					int index,
+					struct mse_nal_index *nal_index)
+{
+	struct cvf_h264_packetizer *h264;
+
+	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	h264 = &cvf_h264_packetizer_table[index];
+	*nal_index = h264->nal_index;
+
+	return 0;
+}
+
 struct mse_packetizer_ops mse_packetizer_cvf_h264_d13_ops = {
 	.open = mse_packetizer_cvf_h264_d13_open,
 	.release = mse_packetizer_cvf_h264_release,
@@ -694,7 +976,9 @@ struct mse_packetizer_ops mse_packetizer_cvf_h264_d13_ops = {
 	.set_video_config = mse_packetizer_cvf_h264_set_video_config,
 	.calc_cbs = mse_packetizer_cvf_h264_calc_cbs,
 	.packetize = mse_packetizer_cvf_h264_packetize,
+	.packetize_sg = mse_packetizer_cvf_h264_packetize_sg,
 	.depacketize = mse_packetizer_cvf_h264_depacketize,
+	.get_nal_index = mse_packetizer_cvf_h264_get_nal_index,
 };
 
 struct mse_packetizer_ops mse_packetizer_cvf_h264_ops = {
@@ -705,5 +989,7 @@ struct mse_packetizer_ops mse_packetizer_cvf_h264_ops = {
 	.set_video_config = mse_packetizer_cvf_h264_set_video_config,
 	.calc_cbs = mse_packetizer_cvf_h264_calc_cbs,
 	.packetize = mse_packetizer_cvf_h264_packetize,
+	.packetize_sg = mse_packetizer_cvf_h264_packetize_sg,
 	.depacketize = mse_packetizer_cvf_h264_depacketize,
+	.get_nal_index = mse_packetizer_cvf_h264_get_nal_index,
 };
@@ -73,6 +73,11 @@
 #include "avtp.h"
 #include "jpeg.h"
 
+#define JPEG_HEADER_CACHE_SIZE (1024)
+#define JPEG_QHEADER_SIZE_MAX  (sizeof(struct mjpeg_quant_header) + \
+				JPEG_COMP_NUM * JPEG_DQT_QUANT_SIZE16)
+#define JPEG_MAKE_HEADER_SIZE  (1024)
+
 struct avtp_cvf_mjpeg_param {
 	char dest_addr[MSE_MAC_LEN_MAX];
 	char source_addr[MSE_MAC_LEN_MAX];
@@ -99,10 +104,42 @@ struct jpeg_info {
 	bool eoi_f;
 };
 
+/* last parsed JPEG header, reused while the encoder repeats it */
+struct jpeg_header_cache {
+	size_t header_len;
+	u8 header[JPEG_HEADER_CACHE_SIZE];
+
+	struct jpeg_info jpeg;
+	enum MJPEG_TYPE type;
+	int width;
+	int height;
+
+	size_t qheader_len;
+	u8 qheader[JPEG_QHEADER_SIZE_MAX];
+};
+
+/* last JPEG header made on receive, valid while its parameters match */
+struct jpeg_header_memo {
+	bool valid_f;
+
+	enum MJPEG_TYPE type;
+	u8 quant;
+	u32 width;
+	u32 height;
+	u16 dri;
+	struct mjpeg_quant_header qheader;
+	u8 qt[JPEG_QUANT_NUM * JPEG_DQT_QUANT_SIZE16];
+
+	u32 header_len;
+	u8 header[JPEG_MAKE_HEADER_SIZE];
+};
+
 struct cvf_mjpeg_packetizer {
 	bool used_f;
 
 	struct jpeg_info jpeg;
+	struct jpeg_header_cache hcache;
+	struct jpeg_header_memo hmemo;
 
 	int send_seq_num;
 	int payload_max;
@@ -116,6 +153,9 @@ struct cvf_mjpeg_packetizer {
 	size_t piece_data_len;
 	u8 piece_data[ETHFRAMELEN_MAX];
 
+	/* marker offsets of buffer from media adapter, eoi_offset 0 if none */
+	struct mse_jpeg_markers markers;
+
 	u8 packet_template[ETHFRAMELEN_MAX];
 
 	struct mse_network_config net_config;
@@ -196,6 +236,8 @@ static int mse_packetizer_cvf_mjpeg_packet_init(int index)
 	cvf_mjpeg->type = MJPEG_TYPE_420;
 
 	mse_packetizer_cvf_mjpeg_flag_init(cvf_mjpeg);
+	cvf_mjpeg->hcache.header_len = 0;
+	cvf_mjpeg->hmemo.valid_f = false;
 	mse_packetizer_stats_init(&cvf_mjpeg->stats);
 
 	return 0;
@@ -334,17 +376,91 @@ static int mse_packetizer_cvf_mjpeg_calc_cbs(int index,
 			cbs);
 }
 
+static bool jpeg_header_cache_lookup(struct cvf_mjpeg_packetizer *cvf_mjpeg,
+				     const u8 *buf,
+				     size_t data_len)
+{
+	struct jpeg_header_cache *hcache = &cvf_mjpeg->hcache;
+
+	if (!hcache->header_len || hcache->header_len > data_len)
+		return false;
+
+	if (memcmp(buf, hcache->header, hcache->header_len))
+		return false;
+
+	/* same as parsing, the header starts with SOI */
+	mse_packetizer_cvf_mjpeg_flag_init(cvf_mjpeg);
+	cvf_mjpeg->jpeg = hcache->jpeg;
+	cvf_mjpeg->type = hcache->type;
+	cvf_mjpeg->width = hcache->width;
+	cvf_mjpeg->height = hcache->height;
+
+	return true;
+}
+
+static void jpeg_header_cache_update(struct cvf_mjpeg_packetizer *cvf_mjpeg,
+				     const u8 *buf,
+				     size_t header_len)
+{
+	struct jpeg_header_cache *hcache = &cvf_mjpeg->hcache;
+	struct jpeg_info *jpeg = &cvf_mjpeg->jpeg;
+	struct mjpeg_quant_table *q;
+	struct mjpeg_quant_header qheader;
+	u8 *p;
+	size_t qlen = 0;
+	int i;
+
+	/* make Q header and Q Table data */
+	qheader.mbz = 0;
+	qheader.precision = 0;
+	p = hcache->qheader + sizeof(qheader);
+	for (i = 0; i <= jpeg->max_comp; i++) {
+		q = &jpeg->qtable[jpeg->comp[i].qt];
+		qheader.precision |= (q->precision << i);
+		memcpy(p, q->data, q->size);
+		p += q->size;
+		qlen += q->size;
+	}
+	qheader.length = htons(qlen);
+	memcpy(hcache->qheader, &qheader, sizeof(qheader));
+	hcache->qheader_len = qlen + sizeof(qheader);
+
+	/*
+	 * Only a header starting with SOI is reusable, the bytes up to the
+	 * end of SOS header determine everything parsed from it.
+	 */
+	hcache->header_len = 0;
+	if (jpeg->eoi_f ||
+	    header_len < JPEG_MARKER_SIZE_LENGTH ||
+	    header_len > sizeof(hcache->header) ||
+	    buf[0] != JPEG_MARKER || buf[1] != JPEG_MARKER_KIND_SOI)
+		return;
+
+	memcpy(hcache->header, buf, header_len);
+	hcache->header_len = header_len;
+	hcache->jpeg = *jpeg;
+	hcache->type = cvf_mjpeg->type;
+	hcache->width = cvf_mjpeg->width;
+	hcache->height = cvf_mjpeg->height;
+}
+
 static ssize_t parse_jpeg_headers(struct cvf_mjpeg_packetizer *cvf_mjpeg,
 				  u8 *buf,
 				  size_t data_len)
 {
 	struct jpeg_info *jpeg = &cvf_mjpeg->jpeg;
+	struct mse_jpeg_markers *markers = &cvf_mjpeg->markers;
 	size_t offset = 0;
 	u8 mk, qid, qlen;
 	int header_len = 0;
 	int ret;
 	int i;
 
+	if (jpeg_header_cache_lookup(cvf_mjpeg, buf, data_len)) {
+		header_len = cvf_mjpeg->hcache.header_len;
+		goto search_eoi;
+	}
+
 	while (offset < data_len && !jpeg->sos_f) {
 		mk = jpeg_get_marker(buf, data_len, &offset);
 		switch (mk) {
@@ -403,10 +519,8 @@ static ssize_t parse_jpeg_headers(struct cvf_mjpeg_packetizer *cvf_mjpeg,
 				return ret;
 			}
 
-			if (jpeg->rheader.restart_interval) {
+			if (jpeg->rheader.restart_interval)
 				jpeg->dri_f = true;
-				cvf_mjpeg->type |= MJPEG_TYPE_RESTART_BIT;
-			}
 			break;
 
 		default:
@@ -423,6 +537,10 @@ static ssize_t parse_jpeg_headers(struct cvf_mjpeg_packetizer *cvf_mjpeg,
 		return -EINVAL;
 	}
 
+	/* SOF sets type, DRI usually comes before it */
+	if (jpeg->dri_f)
+		cvf_mjpeg->type |= MJPEG_TYPE_RESTART_BIT;
+
 	/* check Q-Table */
 	for (i = 0; i <= jpeg->max_comp; i++) {
 		qid = jpeg->comp[i].qt;
@@ -442,28 +560,48 @@ static ssize_t parse_jpeg_headers(struct cvf_mjpeg_packetizer *cvf_mjpeg,
 
 	jpeg->header_f = true;
 
+	jpeg_header_cache_update(cvf_mjpeg, buf, header_len);
+
+search_eoi:
+	/*
+	 * Take EOI found by media adapter when it agrees on the header,
+	 * otherwise continue the same walk over the entropy coded data.
+	 */
+	if (!jpeg->eoi_f) {
+		if (markers->eoi_offset &&
+		    markers->header_len == header_len &&
+		    markers->eoi_offset <= data_len)
+			jpeg->eoi_offset = markers->eoi_offset;
+		else
+			jpeg->eoi_offset = jpeg_search_eoi(buf, data_len,
+							   header_len);
+		jpeg->eoi_f = true;
+		/* only for the frame at start of buffer */
+		markers->eoi_offset = 0;
+		mse_debug("Found EOI offset=%zu\n", jpeg->eoi_offset);
+	}
+
 	return header_len;
 }
 
-static int mse_packetizer_cvf_mjpeg_packetize(int index,
-					      void *packet,
-					      size_t *packet_size,
-					      void *buffer,
-					      size_t buffer_size,
-					      size_t *buffer_processed,
-					      unsigned int *timestamp)
+static int cvf_mjpeg_packetize(int index,
+			       void *packet,
+			       size_t *packet_size,
+			       void *buffer,
+			       size_t buffer_size,
+			       size_t *buffer_processed,
+			       unsigned int *timestamp,
+			       size_t *sg_offset,
+			       size_t *sg_size)
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 	struct jpeg_info *jpeg;
-	struct mjpeg_quant_table *q;
-	struct mjpeg_quant_header qheader;
 	size_t qlen;
 	ssize_t offset;
 	u8 *buf, *payload;
 	size_t data_len, end_len;
 	size_t payload_size;
 	u32 header_len = 0;
-	int i;
 	bool pic_end = false;
 
 	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table)) {
@@ -478,6 +616,9 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 		  index, cvf_mjpeg->send_seq_num, *buffer_processed,
 		  buffer_size, *timestamp);
 
+	if (sg_size)
+		*sg_size = 0;
+
 	if (!*buffer_processed)
 		jpeg->eoi_f = false;
 
@@ -492,18 +633,6 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 			return offset;
 		}
 		header_len = offset;
-	} else {
-		offset = *buffer_processed;
-	}
-
-	/* Search EOI */
-	if (!jpeg->eoi_f) {
-		offset = jpeg_search_eoi(buf, data_len, offset);
-		if (offset <= data_len) {
-			jpeg->eoi_offset = offset;
-			jpeg->eoi_f = true;
-			mse_debug("Found EOI offset=%zu\n", jpeg->eoi_offset);
-		}
 	}
 
 	payload = packet + AVTP_CVF_MJPEG_PAYLOAD_OFFSET;
@@ -521,28 +650,10 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 	if ((!cvf_mjpeg->jpeg_offset) &&
 	    (cvf_mjpeg->quant >= MJPEG_QUANT_QTABLE_BIT) &&
 	    (jpeg->max_comp)) {
-		qlen = 0;
-		qheader.mbz = 0;
-		qheader.precision = 0;
-
-		/* make Q header */
-		for (i = 0; i <= jpeg->max_comp; i++) {
-			q = &jpeg->qtable[jpeg->comp[i].qt];
-			qheader.precision |= (q->precision << i);
-			qlen += q->size;
-		}
-		qheader.length = htons(qlen);
-		qlen += sizeof(qheader);
-
-		memcpy(payload, &qheader, sizeof(qheader));
-		payload += sizeof(qheader);
-
-		/* copy Q Table data */
-		for (i = 0; i <= jpeg->max_comp; i++) {
-			q = &jpeg->qtable[jpeg->comp[i].qt];
-			memcpy(payload, q->data, q->size);
-			payload += q->size;
-		}
+		/* copy Q header and Q Table data made at header parse */
+		qlen = cvf_mjpeg->hcache.qheader_len;
+		memcpy(payload, cvf_mjpeg->hcache.qheader, qlen);
+		payload += qlen;
 
 		/* adjust paylod size */
 		if (qlen + data_len > JPEG_PAYLOAD_MAX) {
@@ -615,13 +726,20 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 
 	avtp_set_stream_data_length(packet, payload_size);
 
-	/* set jpeg data */
-	memcpy(payload, buf, data_len);
-
 	/* set packet length */
 	*packet_size = AVTP_CVF_MJPEG_PAYLOAD_OFFSET - AVTP_JPEG_HEADER_SIZE +
 		avtp_get_stream_data_length(packet);
 
+	/* set jpeg data */
+	if (sg_size && data_len >= ZERO_COPY_PAYLOAD_MIN) {
+		/* scan data is sent from buffer */
+		*sg_offset = buf - (u8 *)buffer;
+		*sg_size = data_len;
+		*packet_size -= data_len;
+	} else {
+		memcpy(payload, buf, data_len);
+	}
+
 	cvf_mjpeg->jpeg_offset += data_len;
 
 	if (pic_end) {
@@ -642,6 +760,102 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 		return MSE_PACKETIZE_STATUS_COMPLETE;
 }
 
+static int mse_packetizer_cvf_mjpeg_set_jpeg_markers(
+	int index,
+	const struct mse_jpeg_markers *markers)
+{
+	struct cvf_mjpeg_packetizer *cvf_mjpeg;
+
+	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+
+	if (markers)
+		cvf_mjpeg->markers = *markers;
+	else
+		cvf_mjpeg->markers.eoi_offset = 0;
+
+	return 0;
+}
+
+static int mse_packetizer_cvf_mjpeg_packetize(int index,
+					      void *packet,
+					      size_t *packet_size,
+					      void *buffer,
+					      size_t buffer_size,
+					      size_t *buffer_processed,
+					      unsigned int *timestamp)
+{
+	return cvf_mjpeg_packetize(index, packet, packet_size,
+				   buffer, buffer_size, buffer_processed,
+				   timestamp, NULL, NULL);
+}
+
+static int mse_packetizer_cvf_mjpeg_packetize_sg(int index,
+						 void *packet,
+						 size_t *packet_size,
+						 void *buffer,
+						 size_t buffer_size,
+						 size_t *buffer_processed,
+						 unsigned int *timestamp,
+						 size_t *payload_offset,
+						 size_t *payload_size)
+{
+	return cvf_mjpeg_packetize(index, packet, packet_size,
+				   buffer, buffer_size, buffer_processed,
+				   timestamp, payload_offset, payload_size);
+}
+
+static const u8 *jpeg_header_memo_get(struct cvf_mjpeg_packetizer *cvf_mjpeg,
+				      u32 width,
+				      u32 height,
+				      u8 *qt,
+				      struct mjpeg_quant_header *qheader,
+				      u16 dri)
+{
+	struct jpeg_header_memo *hmemo = &cvf_mjpeg->hmemo;
+	size_t qlen = ntohs(qheader->length);
+
+	if (hmemo->valid_f &&
+	    hmemo->type == cvf_mjpeg->type &&
+	    hmemo->quant == cvf_mjpeg->quant &&
+	    hmemo->width == width &&
+	    hmemo->height == height &&
+	    hmemo->dri == dri &&
+	    !memcmp(&hmemo->qheader, qheader, sizeof(*qheader)) &&
+	    (!qlen || !memcmp(hmemo->qt, qt, qlen)))
+		return hmemo->header;
+
+	memset(hmemo->header, 0, sizeof(hmemo->header));
+	hmemo->header_len = jpeg_make_header(cvf_mjpeg->type,
+					     cvf_mjpeg->quant,
+					     hmemo->header,
+					     width,
+					     height,
+					     qt,
+					     qheader,
+					     dri);
+
+	/* Q Table too long to keep, make the header again next time */
+	hmemo->valid_f = (qlen <= sizeof(hmemo->qt));
+	if (!hmemo->valid_f)
+		return hmemo->header;
+
+	hmemo->type = cvf_mjpeg->type;
+	hmemo->quant = cvf_mjpeg->quant;
+	hmemo->width = width;
+	hmemo->height = height;
+	hmemo->dri = dri;
+	hmemo->qheader = *qheader;
+	if (qlen)
+		memcpy(hmemo->qt, qt, qlen);
+
+	return hmemo->header;
+}
+
 static int mse_packetizer_cvf_mjpeg_depacketize(int index,
 						void *buffer,
 						size_t buffer_size,
@@ -733,18 +947,12 @@ static int mse_packetizer_cvf_mjpeg_depacketize(int index,
 
 	/* make header for first data */
 	if (!offset) {
-		u8 header[1024];
+		const u8 *header;
 		u32 len;
 
-		memset(header, 0, sizeof(header));
-		len = jpeg_make_header(cvf_mjpeg->type,
-				       cvf_mjpeg->quant,
-				       header,
-				       width,
-				       height,
-				       qt,
-				       &qheader,
-				       dri);
+		header = jpeg_header_memo_get(cvf_mjpeg, width, height,
+					      qt, &qheader, dri);
+		len = cvf_mjpeg->hmemo.header_len;
 
 		if (*buffer_processed + len >= buffer_size) {
 			mse_err("buffer overrun header\n");
@@ -787,5 +995,7 @@ struct mse_packetizer_ops mse_packetizer_cvf_mjpeg_ops = {
 	.set_video_config = mse_packetizer_cvf_mjpeg_set_video_config,
 	.calc_cbs = mse_packetizer_cvf_mjpeg_calc_cbs,
 	.packetize = mse_packetizer_cvf_mjpeg_packetize,
+	.packetize_sg = mse_packetizer_cvf_mjpeg_packetize_sg,
 	.depacketize = mse_packetizer_cvf_mjpeg_depacketize,
+	.set_jpeg_markers = mse_packetizer_cvf_mjpeg_set_jpeg_markers,
 };
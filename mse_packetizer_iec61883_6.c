@@ -70,6 +70,7 @@
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
+#include "mse_sample.h"
 #include "avtp.h"
 
 #define AM824_DATA_SIZE         (sizeof(u32))
@@ -102,6 +103,7 @@ struct iec61883_6_packetizer {
 	int piece_data_len;
 	bool f_warned;
 	bool f_need_calc_offset;
+	bool f_prestamped;
 	u32 start_time;
 
 	unsigned char packet_template[ETHFRAMELEN_MAX];
@@ -110,6 +112,7 @@ struct iec61883_6_packetizer {
 	struct mse_network_config net_config;
 	struct mse_audio_config audio_config;
 	struct mse_packetizer_stats stats;
+	struct mse_sample_am824 am824;
 };
 
 struct iec61883_6_packetizer iec61883_6_packetizer_table[MSE_INSTANCE_MAX];
@@ -365,6 +368,14 @@ static int mse_packetizer_iec61883_6_set_audio_config(
 		return ret;
 
 	audio_config = &iec61883_6->audio_config;
+	ret = mse_sample_am824_init(
+			&iec61883_6->am824,
+			mse_get_bit_depth(audio_config->sample_bit_depth),
+			audio_config->bytes_per_sample,
+			audio_config->is_big_endian);
+	if (ret < 0)
+		return ret;
+
 	/* when samples_per_frame is not set */
 	if (!audio_config->samples_per_frame) {
 		iec61883_6->class_interval_frames = DEFAULT_INTERVAL_FRAMES;
@@ -404,6 +415,32 @@ static int mse_packetizer_iec61883_6_set_audio_config(
 
 	mse_packetizer_iec61883_6_header_build(iec61883_6->packet_template,
 					       &param);
+	iec61883_6->f_prestamped = false;
+
+	return 0;
+}
+
+static int mse_packetizer_iec61883_6_prepare_packets(
+					int index,
+					struct mse_packet *packets,
+					int num_packets)
+{
+	struct iec61883_6_packetizer *iec61883_6;
+	int i;
+
+	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+	iec61883_6 = &iec61883_6_packetizer_table[index];
+
+	for (i = 0; i < num_packets; i++)
+		memcpy(packets[i].vaddr, iec61883_6->packet_template,
+		       iec61883_6->avtp_packet_size);
+
+	iec61883_6->f_prestamped = true;
 
 	return 0;
 }
@@ -450,149 +487,34 @@ static int mse_packetizer_iec61883_6_calc_cbs(int index,
 			cbs);
 }
 
-#define SET_AM824_MBLA_24BIT(_data) \
-	htonl(0x40000000 | ((_data) & 0xFFFFFF))
-#define SET_AM824_MBLA_20BIT(_data) \
-	htonl(0x41000000 | (((_data) << 4) & 0xFFFFFF))
-#define SET_AM824_MBLA_18BIT(_data) \
-	htonl(0x41000000 | (((_data) << 6) & 0xFFFFFF))
-#define SET_AM824_MBLA_16BIT(_data) \
-	htonl(0x42000000 | (((_data) << 8) & 0xFFFFFF))
-
-#define SET_AM824_MBLA_24BIT_BE(_data) \
-	(0x00000040 | ((_data) & 0xFFFFFF00))
-#define SET_AM824_MBLA_16BIT_BE(_data) \
-	(0x00000042 | (((_data) << 8) & 0xFFFF00))
-
-static void mse_packetizer_iec61883_6_set_payload(int index,
-						  int data_num,
-						  u32 *sample,
-						  void *buffer,
-						  size_t buffer_processed)
+static void mse_packetizer_iec61883_6_set_payload(
+				struct iec61883_6_packetizer *iec61883_6,
+				int data_num,
+				u32 *sample,
+				void *buffer,
+				size_t buffer_processed)
 {
-	struct iec61883_6_packetizer *iec61883_6;
-	int i, j = 0, count;
-	u32 tmp;
-	union {
-		u8 *d8;
-		u16 *d16;
-		u32 *d32;
-	} data;
-
-	iec61883_6 = &iec61883_6_packetizer_table[index];
-	data.d16 = (u16 *)(buffer + buffer_processed);
-	count = data_num / iec61883_6->audio_config.bytes_per_sample;
-
-	if (iec61883_6->audio_config.is_big_endian) {
-		if (iec61883_6->audio_config.bytes_per_sample == 4) {
-			for (i = 0; i < count; i++) {
-				*(sample + i) = SET_AM824_MBLA_24BIT_BE(
-					*(data.d32 + i));
-			}
-			return;
-		}
-		switch (iec61883_6->audio_config.sample_bit_depth) {
-		case MSE_AUDIO_BIT_16:
-			for (i = 0; i < count; i++) {
-				*(sample + i) = SET_AM824_MBLA_16BIT_BE(
-					*(data.d16 + i));
-			}
-			return;
-		case MSE_AUDIO_BIT_18:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i) << 16
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2);
-				*(sample + j++) = SET_AM824_MBLA_18BIT(tmp);
-			}
-			return;
-		case MSE_AUDIO_BIT_20:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i) << 16
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2);
-				*(sample + j++) = SET_AM824_MBLA_20BIT(tmp);
-			}
-			return;
-		case MSE_AUDIO_BIT_24:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i) << 16
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2);
-				*(sample + j++) = SET_AM824_MBLA_24BIT(tmp);
-			}
-			return;
-		default:
-			return;
-		}
-	} else {
-		if (iec61883_6->audio_config.bytes_per_sample == 4) {
-			for (i = 0; i < count; i++) {
-				*(sample + i) =
-					SET_AM824_MBLA_24BIT(*(data.d32 + i));
-			}
-			return;
-		}
-		switch (iec61883_6->audio_config.sample_bit_depth) {
-		case MSE_AUDIO_BIT_16:
-			for (i = 0; i < count; i++) {
-				*(sample + i) =
-					SET_AM824_MBLA_16BIT(*(data.d16 + i));
-			}
-			return;
-		case MSE_AUDIO_BIT_18:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i)
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2) << 16;
-				*(sample + j++) = SET_AM824_MBLA_18BIT(tmp);
-			}
-			return;
-		case MSE_AUDIO_BIT_20:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i)
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2) << 16;
-				*(sample + j++) = SET_AM824_MBLA_20BIT(tmp);
-			}
-			return;
-		case MSE_AUDIO_BIT_24:
-			for (i = 0; i < data_num; i += 3) {
-				tmp = *(data.d8 + i)
-					| *(data.d8 + i + 1) << 8
-					| *(data.d8 + i + 2) << 16;
-				*(sample + j++) = SET_AM824_MBLA_24BIT(tmp);
-			}
-			return;
-		default:
-			return;
-		}
-	}
+	mse_sample_am824_encode(
+		&iec61883_6->am824, sample, buffer + buffer_processed,
+		data_num / iec61883_6->audio_config.bytes_per_sample);
 }
 
-static int mse_packetizer_iec61883_6_packetize(int index,
-					       void *packet,
-					       size_t *packet_size,
-					       void *buffer,
-					       size_t buffer_size,
-					       size_t *buffer_processed,
-					       unsigned int *timestamp)
+static int iec61883_6_packetize(struct iec61883_6_packetizer *iec61883_6,
+				void *packet,
+				size_t *packet_size,
+				void *buffer,
+				size_t buffer_size,
+				size_t *buffer_processed,
+				unsigned int timestamp)
 {
-	struct iec61883_6_packetizer *iec61883_6;
 	struct mse_audio_config *audio_config;
 	int payload_len, data_size;
 	u32 *sample;
 	int piece_size = 0, piece_len = 0;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table)) {
-		mse_err("wrong index: %d\n", index);
-		return -EPERM;
-	}
-
-	iec61883_6 = &iec61883_6_packetizer_table[index];
-	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%d\n",
-		  index, iec61883_6->send_seq_num, *buffer_processed,
-		  buffer_size, *timestamp);
+	mse_debug("seqnum=%d process=%zu/%zu t=%u\n",
+		  iec61883_6->send_seq_num, *buffer_processed,
+		  buffer_size, timestamp);
 
 	audio_config = &iec61883_6->audio_config;
 	/* header */
@@ -604,7 +526,7 @@ static int mse_packetizer_iec61883_6_packetize(int index,
 		iec61883_6->piece_data_len = 0;
 		memcpy(packet, iec61883_6->packet_piece,
 		       iec61883_6->avtp_packet_size);
-	} else {
+	} else if (!iec61883_6->f_prestamped) {
 		memcpy(packet, iec61883_6->packet_template,
 		       iec61883_6->avtp_packet_size);
 	}
@@ -629,7 +551,7 @@ static int mse_packetizer_iec61883_6_packetize(int index,
 		*packet_size = iec61883_6->avtp_packet_size;
 	}
 
-	mse_packetizer_iec61883_6_set_payload(index,
+	mse_packetizer_iec61883_6_set_payload(iec61883_6,
 					      data_size - piece_size,
 					      sample,
 					      buffer,
@@ -646,7 +568,7 @@ static int mse_packetizer_iec61883_6_packetize(int index,
 
 	/* variable header */
 	avtp_set_sequence_num(packet, iec61883_6->send_seq_num++);
-	avtp_set_timestamp(packet, (u32)*timestamp);
+	avtp_set_timestamp(packet, (u32)timestamp);
 	avtp_set_iec61883_dbc(packet, iec61883_6->local_total_samples);
 	iec61883_6->local_total_samples += iec61883_6->sample_per_packet;
 
@@ -657,6 +579,62 @@ static int mse_packetizer_iec61883_6_packetize(int index,
 		return MSE_PACKETIZE_STATUS_CONTINUE;
 }
 
+static int mse_packetizer_iec61883_6_packetize(int index,
+					       void *packet,
+					       size_t *packet_size,
+					       void *buffer,
+					       size_t buffer_size,
+					       size_t *buffer_processed,
+					       unsigned int *timestamp)
+{
+	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	return iec61883_6_packetize(&iec61883_6_packetizer_table[index],
+				    packet, packet_size, buffer, buffer_size,
+				    buffer_processed, *timestamp);
+}
+
+static int mse_packetizer_iec61883_6_packetize_burst(
+					int index,
+					struct mse_packet **packets,
+					unsigned int *timestamps,
+					int num_packets,
+					void *buffer,
+					size_t buffer_size,
+					size_t *buffer_processed,
+					int *status)
+{
+	struct iec61883_6_packetizer *iec61883_6;
+	size_t packet_size = 0;
+	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
+	int count = 0;
+
+	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table)) {
+		mse_err("wrong index: %d\n", index);
+		return -EPERM;
+	}
+
+	iec61883_6 = &iec61883_6_packetizer_table[index];
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	while (ret == MSE_PACKETIZE_STATUS_CONTINUE && count < num_packets) {
+		ret = iec61883_6_packetize(iec61883_6, packets[count]->vaddr,
+					   &packet_size, buffer, buffer_size,
+					   buffer_processed, timestamps[count]);
+		if (ret < 0 || ret == MSE_PACKETIZE_STATUS_NOT_ENOUGH)
+			break;
+
+		packets[count++]->len = packet_size;
+	}
+
+	*status = ret;
+
+	return count;
+}
+
 #define GET_AM824_MBLA_VBL(_data) \
 	(((_data) & 0x03000000) >> 24)
 
@@ -688,15 +666,21 @@ static int mse_packetizer_iec61883_6_data_convert(int index,
 	u32 *payload;
 	struct iec61883_6_packetizer *iec61883_6;
 	struct mse_audio_config *audio_config;
-	int i;
+	int i, count;
 	int buf_bit_depth;
 
 	iec61883_6 = &iec61883_6_packetizer_table[index];
 	audio_config = &iec61883_6->audio_config;
 	payload = packet + AVTP_IEC61883_6_PAYLOAD_OFFSET;
 	buf_bit_depth = mse_get_bit_depth(audio_config->sample_bit_depth);
+	count = data_num / audio_config->bytes_per_sample;
+
+	i = mse_sample_am824_decode(&iec61883_6->am824, buf, payload, count);
+	buf += i * audio_config->bytes_per_sample;
+	payload += i;
 
-	for (i = 0; i < (data_num / audio_config->bytes_per_sample); i++) {
+	/* quadlets with other bit depth than the configured one */
+	for (; i < count; i++) {
 		int bit_depth, shift;
 		int value = get_am824_mbla_value(payload++, &bit_depth);
 
@@ -921,6 +905,8 @@ struct mse_packetizer_ops mse_packetizer_iec61883_6_ops = {
 	.set_start_time = mse_packetizer_iec61883_6_set_start_time,
 	.set_need_calc_offset = mse_packetizer_iec61883_6_set_need_calc_offset,
 	.calc_cbs = mse_packetizer_iec61883_6_calc_cbs,
+	.prepare_packets = mse_packetizer_iec61883_6_prepare_packets,
 	.packetize = mse_packetizer_iec61883_6_packetize,
+	.packetize_burst = mse_packetizer_iec61883_6_packetize_burst,
 	.depacketize = mse_packetizer_iec61883_6_depacketize,
 };
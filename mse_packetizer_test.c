@@ -0,0 +1,1203 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "ravb_mse_kernel.h"
+#include "mse_packetizer.h"
+#include "avtp.h"
+#if defined(CONFIG_MSE_PACKETIZER_CVF_MJPEG)
+#include "jpeg.h"
+#endif
+
+/*
+ * Each case opens a talker and a listener instance of a packetizer,
+ * packetizes synthetic media buffers by the talker, depacketizes every
+ * packet by the listener and compares the result with the input bit by
+ * bit. The bench case only reports time per packet and never fails on
+ * speed.
+ */
+#define MSE_PACKETIZER_TEST_PACKET_SIZE (2048)
+#define MSE_PACKETIZER_TEST_PACKETS_MAX (512)
+#define MSE_PACKETIZER_TEST_BURST       (8)
+#define MSE_PACKETIZER_TEST_INTERVAL    (125000)
+#define MSE_PACKETIZER_TEST_BENCH_LOOPS (100)
+#define MSE_PACKETIZER_TEST_VIDEO_SIZE  (128 * 1024)
+
+struct mse_packetizer_test_stream {
+	struct mse_packetizer_ops *ops;
+	int tx;
+	int rx;
+};
+
+struct mse_packetizer_test_buffers {
+	u8 *packets;
+	size_t *sizes;
+	int count;
+	unsigned int timestamp;
+	u8 *dest;
+	size_t dest_size;
+};
+
+static int mse_packetizer_test_open_one(struct mse_packetizer_ops *ops,
+					struct mse_audio_config *audio,
+					struct mse_video_config *video,
+					struct mse_mpeg2ts_config *mpeg2ts)
+{
+	struct mse_network_config net = {
+		.dest_addr = { 0x91, 0xe0, 0xf0, 0x00, 0x0e, 0x80 },
+		.source_addr = { 0x76, 0x90, 0x50, 0x00, 0x00, 0x01 },
+		.priority = 3,
+		.vlanid = 2,
+		.port_transmit_rate = 1000000000,
+	};
+	int index, ret;
+
+	index = ops->open();
+	if (index < 0)
+		return index;
+
+	ret = ops->init(index);
+	if (!ret)
+		ret = ops->set_network_config(index, &net);
+	if (!ret && audio)
+		ret = ops->set_audio_config(index, audio);
+	if (!ret && video)
+		ret = ops->set_video_config(index, video);
+	if (!ret && mpeg2ts)
+		ret = ops->set_mpeg2ts_config(index, mpeg2ts);
+	if (ret < 0) {
+		ops->release(index);
+		return ret;
+	}
+
+	return index;
+}
+
+static int mse_packetizer_test_open(struct mse_packetizer_test_stream *s,
+				    struct mse_packetizer_ops *ops,
+				    struct mse_audio_config *audio,
+				    struct mse_video_config *video,
+				    struct mse_mpeg2ts_config *mpeg2ts)
+{
+	s->ops = ops;
+	s->tx = mse_packetizer_test_open_one(ops, audio, video, mpeg2ts);
+	if (s->tx < 0)
+		return s->tx;
+
+	s->rx = mse_packetizer_test_open_one(ops, audio, video, mpeg2ts);
+	if (s->rx < 0) {
+		ops->release(s->tx);
+		return s->rx;
+	}
+
+	return 0;
+}
+
+static void mse_packetizer_test_close(struct mse_packetizer_test_stream *s)
+{
+	s->ops->release(s->rx);
+	s->ops->release(s->tx);
+}
+
+static int mse_packetizer_test_alloc(struct kunit *test,
+				     struct mse_packetizer_test_buffers *b,
+				     size_t dest_size)
+{
+	memset(b, 0, sizeof(*b));
+	b->packets = kunit_kzalloc(test, MSE_PACKETIZER_TEST_PACKETS_MAX *
+				   MSE_PACKETIZER_TEST_PACKET_SIZE, GFP_KERNEL);
+	b->sizes = kunit_kzalloc(test, MSE_PACKETIZER_TEST_PACKETS_MAX *
+				 sizeof(*b->sizes), GFP_KERNEL);
+	b->dest = kunit_kzalloc(test, dest_size, GFP_KERNEL);
+	b->dest_size = dest_size;
+	if (!b->packets || !b->sizes || !b->dest)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static u8 *mse_packetizer_test_packet(struct mse_packetizer_test_buffers *b,
+				      int i)
+{
+	return b->packets + i * MSE_PACKETIZER_TEST_PACKET_SIZE;
+}
+
+/*
+ * Packetize whole buffer by talker and append packets to b, returns the
+ * last status. NOT_ENOUGH means the rest of buffer is kept by talker
+ * for the next one.
+ */
+static int mse_packetizer_test_packetize(struct mse_packetizer_test_stream *s,
+					 struct mse_packetizer_test_buffers *b,
+					 void *buffer, size_t buffer_size)
+{
+	size_t processed = 0, packet_size;
+	int ret;
+
+	do {
+		if (b->count >= MSE_PACKETIZER_TEST_PACKETS_MAX)
+			return -ENOSPC;
+
+		packet_size = 0;
+		ret = s->ops->packetize(s->tx,
+					mse_packetizer_test_packet(b, b->count),
+					&packet_size, buffer, buffer_size,
+					&processed, &b->timestamp);
+		if (ret < 0 || ret == MSE_PACKETIZE_STATUS_NOT_ENOUGH)
+			return ret;
+
+		b->sizes[b->count++] = packet_size;
+		b->timestamp += MSE_PACKETIZER_TEST_INTERVAL;
+	} while (ret == MSE_PACKETIZE_STATUS_CONTINUE);
+
+	return ret;
+}
+
+/*
+ * Depacketize all packets of b by listener into b->dest, returns status
+ * of the last packet and stores the data length in dest_len.
+ */
+static int mse_packetizer_test_depacketize(
+	struct mse_packetizer_test_stream *s,
+	struct mse_packetizer_test_buffers *b,
+	size_t *dest_len)
+{
+	unsigned int timestamp;
+	int i, ret = -ENODATA;
+
+	*dest_len = 0;
+	for (i = 0; i < b->count; i++) {
+		ret = s->ops->depacketize(s->rx, b->dest, b->dest_size,
+					  dest_len, &timestamp,
+					  mse_packetizer_test_packet(b, i),
+					  b->sizes[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	return ret;
+}
+
+/*
+ * Round trip of src given to talker in num_buffers buffers, returns the
+ * number of packets. b->dest holds depacketized data of dest_len bytes
+ * and rx_status is status of the last packet.
+ */
+static int mse_packetizer_test_roundtrip(
+	struct kunit *test,
+	struct mse_packetizer_test_stream *s,
+	struct mse_packetizer_test_buffers *b,
+	u8 *src, size_t src_len, int num_buffers,
+	size_t *dest_len, int *rx_status)
+{
+	size_t len = src_len / num_buffers;
+	int i, ret;
+
+	b->count = 0;
+	b->timestamp = 0;
+	for (i = 0; i < num_buffers; i++) {
+		ret = mse_packetizer_test_packetize(s, b, src + i * len, len);
+		KUNIT_EXPECT_GE(test, ret, 0);
+		if (ret < 0)
+			return ret;
+	}
+
+	KUNIT_EXPECT_GT(test, b->count, 0);
+	*rx_status = mse_packetizer_test_depacketize(s, b, dest_len);
+	KUNIT_EXPECT_GE(test, *rx_status, 0);
+
+	return b->count;
+}
+
+/* time of packetize and depacketize of src, in ns per packet */
+static void mse_packetizer_test_bench_one(
+	struct kunit *test,
+	const char *name,
+	struct mse_packetizer_test_stream *s,
+	struct mse_packetizer_test_buffers *b,
+	u8 *src, size_t src_len)
+{
+	u64 tx_ns = 0, rx_ns = 0, packets = 0, start;
+	size_t dest_len;
+	int i;
+
+	for (i = 0; i < MSE_PACKETIZER_TEST_BENCH_LOOPS; i++) {
+		b->count = 0;
+		start = ktime_get_ns();
+		mse_packetizer_test_packetize(s, b, src, src_len);
+		tx_ns += ktime_get_ns() - start;
+
+		start = ktime_get_ns();
+		mse_packetizer_test_depacketize(s, b, &dest_len);
+		rx_ns += ktime_get_ns() - start;
+		packets += b->count;
+	}
+
+	KUNIT_EXPECT_GT(test, packets, 0);
+	if (!packets)
+		return;
+
+	kunit_info(test, "%-24s %llu ns/packet tx %llu ns/packet rx\n",
+		   name, div64_u64(tx_ns, packets), div64_u64(rx_ns, packets));
+}
+
+#if defined(CONFIG_MSE_PACKETIZER_AAF) || \
+	defined(CONFIG_MSE_PACKETIZER_IEC61883_6)
+/*
+ * Two periods of 1020 frames. It is not a multiple of frames per packet
+ * at 48 kHz, so a piece of the first period is sent with the second.
+ */
+#define MSE_PACKETIZER_TEST_PCM_FRAMES  (1020)
+#define MSE_PACKETIZER_TEST_PCM_PERIODS (2)
+#define MSE_PACKETIZER_TEST_PCM_SIZE \
+	(MSE_PACKETIZER_TEST_PCM_FRAMES * MSE_PACKETIZER_TEST_PCM_PERIODS * \
+	 8 * 4)
+
+struct mse_packetizer_test_pcm {
+	enum MSE_AUDIO_BIT bit_depth;
+	int bytes_per_sample;
+	int channels;
+	int sample_rate;
+	/* bits of a sample, aligned to LSB of bytes_per_sample */
+	int sample_bits;
+	/* upper bits are sign extension like S24_LE, otherwise 0 */
+	bool sign_extend;
+};
+
+static void mse_packetizer_test_pcm_config(
+	const struct mse_packetizer_test_pcm *pcm,
+	struct mse_audio_config *audio)
+{
+	memset(audio, 0, sizeof(*audio));
+	audio->sample_rate = pcm->sample_rate;
+	audio->channels = pcm->channels;
+	audio->period_size = MSE_PACKETIZER_TEST_PCM_FRAMES;
+	audio->bytes_per_sample = pcm->bytes_per_sample;
+	audio->sample_bit_depth = pcm->bit_depth;
+	audio->samples_per_frame = pcm->sample_rate / 8000;
+}
+
+/* random little endian samples */
+static size_t mse_packetizer_test_pcm_fill(
+	const struct mse_packetizer_test_pcm *pcm, u8 *src)
+{
+	size_t len = MSE_PACKETIZER_TEST_PCM_FRAMES *
+		MSE_PACKETIZER_TEST_PCM_PERIODS * pcm->channels *
+		pcm->bytes_per_sample;
+	u32 mask = GENMASK(pcm->sample_bits - 1, 0);
+	size_t i;
+	u32 v;
+	int j;
+
+	for (i = 0; i < len; i += pcm->bytes_per_sample) {
+		v = get_random_u32() & mask;
+		if (pcm->sign_extend && v & BIT(pcm->sample_bits - 1))
+			v |= ~mask;
+		for (j = 0; j < pcm->bytes_per_sample; j++)
+			src[i + j] = v >> (j * 8);
+	}
+
+	return len;
+}
+
+static void mse_packetizer_test_pcm_roundtrip(
+	struct kunit *test,
+	struct mse_packetizer_ops *ops,
+	const struct mse_packetizer_test_pcm *pcms,
+	int num_pcms)
+{
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_audio_config audio;
+	size_t len, dest_len;
+	int i, count, status;
+	u8 *src;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_PCM_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(
+				test, &b, MSE_PACKETIZER_TEST_PCM_SIZE), 0);
+
+	for (i = 0; i < num_pcms; i++) {
+		mse_packetizer_test_pcm_config(&pcms[i], &audio);
+		KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(&s, ops, &audio,
+							       NULL, NULL), 0);
+
+		len = mse_packetizer_test_pcm_fill(&pcms[i], src);
+		b.dest_size = len;
+		count = mse_packetizer_test_roundtrip(
+				test, &s, &b, src, len,
+				MSE_PACKETIZER_TEST_PCM_PERIODS,
+				&dest_len, &status);
+		KUNIT_EXPECT_EQ_MSG(test, count,
+				    MSE_PACKETIZER_TEST_PCM_FRAMES *
+				    MSE_PACKETIZER_TEST_PCM_PERIODS /
+				    audio.samples_per_frame, "pcm %d", i);
+		KUNIT_EXPECT_EQ_MSG(test, status,
+				    MSE_PACKETIZE_STATUS_COMPLETE, "pcm %d", i);
+		KUNIT_EXPECT_EQ_MSG(test, dest_len, len, "pcm %d", i);
+		KUNIT_EXPECT_MEMEQ_MSG(test, b.dest, src, len, "pcm %d", i);
+
+		mse_packetizer_test_close(&s);
+	}
+}
+
+/*
+ * Talker driven by packetize_burst must make the same packets as the
+ * one driven by packetize, including pieces kept over periods.
+ */
+static void mse_packetizer_test_pcm_burst(
+	struct kunit *test,
+	struct mse_packetizer_ops *ops,
+	const struct mse_packetizer_test_pcm *pcms,
+	int num_pcms)
+{
+	struct mse_packet packets[MSE_PACKETIZER_TEST_BURST];
+	struct mse_packet *ptrs[MSE_PACKETIZER_TEST_BURST];
+	unsigned int timestamps[MSE_PACKETIZER_TEST_BURST];
+	struct mse_packetizer_test_buffers b, burst;
+	struct mse_packetizer_test_stream s;
+	struct mse_audio_config audio;
+	size_t len, period, processed;
+	int i, j, n, period_no, status, single_status;
+	u8 *src;
+
+	KUNIT_ASSERT_TRUE(test, ops->packetize_burst);
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_PCM_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(test, &b, 1), 0);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(test, &burst, 1), 0);
+
+	for (i = 0; i < num_pcms; i++) {
+		mse_packetizer_test_pcm_config(&pcms[i], &audio);
+		/* listener instance is used as the second talker */
+		KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(&s, ops, &audio,
+							       NULL, NULL), 0);
+
+		len = mse_packetizer_test_pcm_fill(&pcms[i], src);
+		period = len / MSE_PACKETIZER_TEST_PCM_PERIODS;
+		b.count = 0;
+		b.timestamp = 0;
+		burst.count = 0;
+
+		for (period_no = 0;
+		     period_no < MSE_PACKETIZER_TEST_PCM_PERIODS;
+		     period_no++) {
+			single_status = mse_packetizer_test_packetize(
+					&s, &b, src + period_no * period,
+					period);
+
+			processed = 0;
+			status = MSE_PACKETIZE_STATUS_CONTINUE;
+			while (status == MSE_PACKETIZE_STATUS_CONTINUE &&
+			       burst.count < MSE_PACKETIZER_TEST_PACKETS_MAX) {
+				n = min_t(int, MSE_PACKETIZER_TEST_BURST,
+					  MSE_PACKETIZER_TEST_PACKETS_MAX -
+					  burst.count);
+				for (j = 0; j < n; j++) {
+					packets[j].vaddr =
+						mse_packetizer_test_packet(
+							&burst,
+							burst.count + j);
+					packets[j].len = 0;
+					ptrs[j] = &packets[j];
+					timestamps[j] = (burst.count + j) *
+						MSE_PACKETIZER_TEST_INTERVAL;
+				}
+
+				n = ops->packetize_burst(
+					s.rx, ptrs, timestamps, n,
+					src + period_no * period, period,
+					&processed, &status);
+				KUNIT_ASSERT_GE(test, n, 0);
+				for (j = 0; j < n; j++)
+					burst.sizes[burst.count++] =
+						packets[j].len;
+			}
+
+			KUNIT_EXPECT_EQ_MSG(test, status, single_status,
+					    "pcm %d period %d", i, period_no);
+			KUNIT_EXPECT_EQ_MSG(test, processed, period,
+					    "pcm %d period %d", i, period_no);
+		}
+
+		KUNIT_EXPECT_EQ_MSG(test, burst.count, b.count, "pcm %d", i);
+		for (j = 0; j < min(burst.count, b.count); j++) {
+			KUNIT_EXPECT_EQ_MSG(test, burst.sizes[j], b.sizes[j],
+					    "pcm %d packet %d", i, j);
+			KUNIT_EXPECT_MEMEQ_MSG(
+				test, mse_packetizer_test_packet(&burst, j),
+				mse_packetizer_test_packet(&b, j), b.sizes[j],
+				"pcm %d packet %d", i, j);
+		}
+
+		mse_packetizer_test_close(&s);
+	}
+}
+
+static void mse_packetizer_test_pcm_bench(
+	struct kunit *test,
+	struct mse_packetizer_ops *ops,
+	const char *name,
+	const struct mse_packetizer_test_pcm *pcm)
+{
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_audio_config audio;
+	size_t len;
+	u8 *src;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_PCM_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(
+				test, &b, MSE_PACKETIZER_TEST_PCM_SIZE), 0);
+
+	mse_packetizer_test_pcm_config(pcm, &audio);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(&s, ops, &audio,
+						       NULL, NULL), 0);
+
+	/* whole periods of packets only, nothing is kept as piece */
+	len = mse_packetizer_test_pcm_fill(pcm, src);
+	b.dest_size = len;
+	mse_packetizer_test_bench_one(test, name, &s, &b, src, len);
+
+	mse_packetizer_test_close(&s);
+}
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+/* all bit depths and sample sizes accepted by AAF */
+static const struct mse_packetizer_test_pcm
+mse_packetizer_test_aaf_pcms[] = {
+	{ MSE_AUDIO_BIT_16, 2, 2, 48000, 16, false },
+	{ MSE_AUDIO_BIT_16, 2, 8, 48000, 16, false },
+	{ MSE_AUDIO_BIT_18, 3, 2, 48000, 18, false },
+	{ MSE_AUDIO_BIT_20, 3, 2, 48000, 20, false },
+	{ MSE_AUDIO_BIT_24, 3, 2, 48000, 24, false },
+	{ MSE_AUDIO_BIT_24, 3, 8, 96000, 24, false },
+	{ MSE_AUDIO_BIT_24, 4, 2, 48000, 24, true },
+	{ MSE_AUDIO_BIT_32, 4, 2, 48000, 32, false },
+	{ MSE_AUDIO_BIT_32, 4, 6, 192000, 32, false },
+};
+
+static void mse_packetizer_test_aaf(struct kunit *test)
+{
+	mse_packetizer_test_pcm_roundtrip(
+		test, &mse_packetizer_aaf_ops, mse_packetizer_test_aaf_pcms,
+		ARRAY_SIZE(mse_packetizer_test_aaf_pcms));
+}
+
+static void mse_packetizer_test_aaf_burst(struct kunit *test)
+{
+	mse_packetizer_test_pcm_burst(
+		test, &mse_packetizer_aaf_ops, mse_packetizer_test_aaf_pcms,
+		ARRAY_SIZE(mse_packetizer_test_aaf_pcms));
+}
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_6)
+static const struct mse_packetizer_test_pcm
+mse_packetizer_test_iec61883_6_pcms[] = {
+	{ MSE_AUDIO_BIT_16, 2, 2, 48000, 16, false },
+	{ MSE_AUDIO_BIT_16, 2, 8, 48000, 16, false },
+	{ MSE_AUDIO_BIT_24, 3, 2, 48000, 24, false },
+	{ MSE_AUDIO_BIT_24, 3, 8, 96000, 24, false },
+	{ MSE_AUDIO_BIT_24, 4, 2, 48000, 24, true },
+};
+
+static void mse_packetizer_test_iec61883_6(struct kunit *test)
+{
+	mse_packetizer_test_pcm_roundtrip(
+		test, &mse_packetizer_iec61883_6_ops,
+		mse_packetizer_test_iec61883_6_pcms,
+		ARRAY_SIZE(mse_packetizer_test_iec61883_6_pcms));
+}
+
+static void mse_packetizer_test_iec61883_6_burst(struct kunit *test)
+{
+	mse_packetizer_test_pcm_burst(
+		test, &mse_packetizer_iec61883_6_ops,
+		mse_packetizer_test_iec61883_6_pcms,
+		ARRAY_SIZE(mse_packetizer_test_iec61883_6_pcms));
+}
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264)
+#define MSE_PACKETIZER_TEST_NAL_FU_A    (28)
+#define MSE_PACKETIZER_TEST_NAL_STAP_A  (24)
+
+/* NAL unit with 4 byte start code or length, no start code emulation */
+static size_t mse_packetizer_test_h264_nal(u8 *p, bool avc, u8 type,
+					   size_t size)
+{
+	size_t i;
+
+	put_unaligned_be32(avc ? size : 1, p);
+	p[4] = 0x60 | type;
+	for (i = 1; i < size; i++)
+		p[4 + i] = 4 + get_random_u32() % 252;
+
+	return 4 + size;
+}
+
+/*
+ * Access unit of AUD, SPS and PPS to be aggregated by STAP-A, slices of
+ * sizes around one and two FU-A payloads, and a few small slices at the
+ * end of the frame.
+ */
+static size_t mse_packetizer_test_h264_frame(u8 *p, bool avc,
+					     int payload_max)
+{
+	static const int deltas[] = { -3, -2, -1, 0, 1, 2, 3 };
+	size_t len = 0;
+	int i;
+
+	len += mse_packetizer_test_h264_nal(p + len, avc, 9, 2);
+	len += mse_packetizer_test_h264_nal(p + len, avc, 7, 16);
+	len += mse_packetizer_test_h264_nal(p + len, avc, 8, 4);
+	for (i = 0; i < ARRAY_SIZE(deltas); i++) {
+		len += mse_packetizer_test_h264_nal(p + len, avc, 5,
+						    payload_max + deltas[i]);
+		len += mse_packetizer_test_h264_nal(p + len, avc, 1,
+						    2 * payload_max +
+						    deltas[i]);
+	}
+	for (i = 0; i < 4; i++)
+		len += mse_packetizer_test_h264_nal(p + len, avc, 1,
+						    1 + get_random_u32() % 40);
+
+	return len;
+}
+
+static void mse_packetizer_test_h264_run(struct kunit *test,
+					 struct mse_packetizer_ops *ops,
+					 size_t payload_offset)
+{
+	static const int bytes_per_frames[] = { 0, 1000, 256 };
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_video_config video = {
+		.fps = { 30, 1 },
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	int i, j, count, status, payload_max, fu_a, stap_a;
+	size_t len, dest_len;
+	bool avc;
+	u8 *src, *p, type;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_VIDEO_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(
+				test, &b, MSE_PACKETIZER_TEST_VIDEO_SIZE), 0);
+
+	for (i = 0; i < ARRAY_SIZE(bytes_per_frames) * 2; i++) {
+		avc = i & 1;
+		video.format = avc ? MSE_VIDEO_FORMAT_H264_AVC :
+			MSE_VIDEO_FORMAT_H264_BYTE_STREAM;
+		video.bytes_per_frame = bytes_per_frames[i / 2];
+		payload_max = video.bytes_per_frame ?: AVTP_PAYLOAD_MAX;
+		KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(&s, ops, NULL,
+							       &video, NULL),
+				0);
+
+		len = mse_packetizer_test_h264_frame(src, avc, payload_max);
+		count = mse_packetizer_test_roundtrip(test, &s, &b, src, len,
+						      1, &dest_len, &status);
+
+		fu_a = 0;
+		stap_a = 0;
+		for (j = 0; j < count; j++) {
+			p = mse_packetizer_test_packet(&b, j);
+			type = p[payload_offset] & 0x1f;
+			if (type == MSE_PACKETIZER_TEST_NAL_FU_A)
+				fu_a++;
+			else if (type == MSE_PACKETIZER_TEST_NAL_STAP_A)
+				stap_a++;
+		}
+
+		KUNIT_EXPECT_GT_MSG(test, fu_a, 0, "config %d", i);
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264_STAP_A)
+		KUNIT_EXPECT_GT_MSG(test, stap_a, 0, "config %d", i);
+#endif
+		KUNIT_EXPECT_EQ_MSG(test, status,
+				    MSE_PACKETIZE_STATUS_COMPLETE,
+				    "config %d", i);
+		KUNIT_EXPECT_EQ_MSG(test, dest_len, len, "config %d", i);
+		KUNIT_EXPECT_MEMEQ_MSG(test, b.dest, src, len,
+				       "config %d", i);
+
+		mse_packetizer_test_close(&s);
+	}
+}
+
+static void mse_packetizer_test_cvf_h264(struct kunit *test)
+{
+	mse_packetizer_test_h264_run(test, &mse_packetizer_cvf_h264_ops,
+				     AVTP_CVF_H264_PAYLOAD_OFFSET);
+}
+
+static void mse_packetizer_test_cvf_h264_d13(struct kunit *test)
+{
+	mse_packetizer_test_h264_run(test, &mse_packetizer_cvf_h264_d13_ops,
+				     AVTP_CVF_H264_D13_PAYLOAD_OFFSET);
+}
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_CVF_MJPEG)
+#define MSE_PACKETIZER_TEST_MJPEG_ECS   (64 * 1024)
+
+struct mse_packetizer_test_mjpeg {
+	enum MJPEG_TYPE type;
+	/* bit n set for 16 bit table n */
+	u8 precision;
+	u16 dri;
+};
+
+static const struct mse_packetizer_test_mjpeg mse_packetizer_test_mjpegs[] = {
+	{ MJPEG_TYPE_420, 0, 0 },
+	{ MJPEG_TYPE_422, 0, 0 },
+	{ MJPEG_TYPE_420, 0, 4 },
+	{ MJPEG_TYPE_422, 0, 40 },
+	{ MJPEG_TYPE_420, 1, 0 },
+	{ MJPEG_TYPE_420, 3, 8 },
+};
+
+/*
+ * JPEG frame of 640x480 with dynamic Q tables, and optionally DRI with
+ * RST markers in entropy coded segment. The header is made by the same
+ * function as listener uses, so the frame is recovered bit by bit.
+ */
+static size_t mse_packetizer_test_mjpeg_frame(
+	const struct mse_packetizer_test_mjpeg *mjpeg, u8 *p)
+{
+	struct mjpeg_quant_header qheader = { 0 };
+	u8 qt[JPEG_DQT_QUANT_SIZE16 * 2];
+	size_t len, i, qlen = 0;
+	int rst = 0;
+
+	for (i = 0; i < 2; i++)
+		qlen += mjpeg->precision & BIT(i) ?
+			JPEG_DQT_QUANT_SIZE16 : JPEG_DQT_QUANT_SIZE8;
+	for (i = 0; i < qlen; i++)
+		qt[i] = 1 + get_random_u32() % 200;
+	qheader.precision = mjpeg->precision;
+	qheader.length = htons(qlen);
+
+	len = jpeg_make_header(mjpeg->type, MJPEG_QUANT_DYNAMIC, p, 640, 480,
+			       qt, &qheader, mjpeg->dri);
+
+	for (i = 0; i < MSE_PACKETIZER_TEST_MJPEG_ECS; i++) {
+		if (mjpeg->dri && i && !(i % 1000)) {
+			p[len++] = JPEG_MARKER;
+			p[len++] = 0xd0 + rst++ % 8;
+		}
+		p[len] = get_random_u32();
+		if (p[len++] == JPEG_MARKER)
+			p[len++] = 0x00;
+	}
+	p[len++] = JPEG_MARKER;
+	p[len++] = JPEG_MARKER_KIND_EOI;
+
+	return len;
+}
+
+static void mse_packetizer_test_cvf_mjpeg(struct kunit *test)
+{
+	const struct mse_packetizer_test_mjpeg *mjpeg;
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_video_config video = {
+		.format = MSE_VIDEO_FORMAT_MJPEG,
+		.fps = { 30, 1 },
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	size_t len, dest_len;
+	int i, frame, count, status;
+	u8 *src;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_VIDEO_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(
+				test, &b, MSE_PACKETIZER_TEST_VIDEO_SIZE), 0);
+
+	for (i = 0; i < ARRAY_SIZE(mse_packetizer_test_mjpegs); i++) {
+		mjpeg = &mse_packetizer_test_mjpegs[i];
+		KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(&s,
+				&mse_packetizer_cvf_mjpeg_ops, NULL, &video,
+				NULL), 0);
+
+		/* second frame goes through cached headers of both sides */
+		for (frame = 0; frame < 2; frame++) {
+			len = mse_packetizer_test_mjpeg_frame(mjpeg, src);
+			count = mse_packetizer_test_roundtrip(test, &s, &b,
+							      src, len, 1,
+							      &dest_len,
+							      &status);
+			KUNIT_EXPECT_GT(test, count, 1);
+			KUNIT_EXPECT_EQ_MSG(test, status,
+					    MSE_PACKETIZE_STATUS_COMPLETE,
+					    "mjpeg %d frame %d", i, frame);
+			KUNIT_EXPECT_EQ_MSG(test, dest_len, len,
+					    "mjpeg %d frame %d", i, frame);
+			KUNIT_EXPECT_MEMEQ_MSG(test, b.dest, src, len,
+					       "mjpeg %d frame %d", i, frame);
+		}
+
+		mse_packetizer_test_close(&s);
+	}
+}
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_4)
+#define MSE_PACKETIZER_TEST_TS_SIZE     (188)
+#define MSE_PACKETIZER_TEST_M2TS_SIZE   (4 + MSE_PACKETIZER_TEST_TS_SIZE)
+#define MSE_PACKETIZER_TEST_TS_PER_FRAME (7)
+/* not a multiple of TS packets per frame, last ones are left in piece */
+#define MSE_PACKETIZER_TEST_TS_PACKETS  (7 * 20 + 3)
+
+static void mse_packetizer_test_iec61883_4_run(struct kunit *test,
+					       enum MSE_MPEG2TS_TYPE type)
+{
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_mpeg2ts_config mpeg2ts = {
+		.bitrate = 50000000,
+		.tspackets_per_frame = MSE_PACKETIZER_TEST_TS_PER_FRAME,
+		.mpeg2ts_type = type,
+		.transmit_mode = MSE_TRANSMIT_MODE_BITRATE,
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	size_t src_packet_size, len, dest_len, packet_size, processed = 0;
+	int i, status;
+	u8 *src, *expect, *p;
+
+	src_packet_size = type == MSE_MPEG2TS_TYPE_M2TS ?
+		MSE_PACKETIZER_TEST_M2TS_SIZE : MSE_PACKETIZER_TEST_TS_SIZE;
+	len = src_packet_size * MSE_PACKETIZER_TEST_TS_PACKETS;
+
+	src = kunit_kmalloc(test, len, GFP_KERNEL);
+	expect = kunit_kmalloc(test, MSE_PACKETIZER_TEST_TS_SIZE *
+			       MSE_PACKETIZER_TEST_TS_PACKETS, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, expect);
+	/* listener needs room after the last packet */
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(test, &b, len * 2),
+			0);
+
+	/* listener gives TS packets without M2TS timestamps */
+	for (i = 0; i < MSE_PACKETIZER_TEST_TS_PACKETS; i++) {
+		p = src + i * src_packet_size;
+		get_random_bytes(p, src_packet_size);
+		if (type == MSE_MPEG2TS_TYPE_M2TS) {
+			put_unaligned_be32(i * 1000, p);
+			p += 4;
+		}
+		p[0] = 0x47;
+		memcpy(expect + i * MSE_PACKETIZER_TEST_TS_SIZE, p,
+		       MSE_PACKETIZER_TEST_TS_SIZE);
+	}
+
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(
+				&s, &mse_packetizer_iec61883_4_ops, NULL, NULL,
+				&mpeg2ts), 0);
+
+	status = mse_packetizer_test_packetize(&s, &b, src, len);
+	KUNIT_EXPECT_EQ(test, status, MSE_PACKETIZE_STATUS_NOT_ENOUGH);
+	KUNIT_EXPECT_EQ(test, b.count, MSE_PACKETIZER_TEST_TS_PACKETS /
+			MSE_PACKETIZER_TEST_TS_PER_FRAME);
+
+	/* flush the piece kept by talker */
+	packet_size = 0;
+	status = s.ops->packetize(s.tx, mse_packetizer_test_packet(&b, b.count),
+				  &packet_size, NULL, 0, &processed,
+				  &b.timestamp);
+	KUNIT_EXPECT_GE(test, status, 0);
+	KUNIT_EXPECT_GT(test, packet_size, 0);
+	if (packet_size)
+		b.sizes[b.count++] = packet_size;
+
+	status = mse_packetizer_test_depacketize(&s, &b, &dest_len);
+	KUNIT_EXPECT_EQ(test, status, MSE_PACKETIZE_STATUS_MAY_COMPLETE);
+	KUNIT_EXPECT_EQ(test, dest_len, MSE_PACKETIZER_TEST_TS_SIZE *
+			MSE_PACKETIZER_TEST_TS_PACKETS);
+	KUNIT_EXPECT_MEMEQ(test, b.dest, expect, MSE_PACKETIZER_TEST_TS_SIZE *
+			   MSE_PACKETIZER_TEST_TS_PACKETS);
+
+	mse_packetizer_test_close(&s);
+}
+
+static void mse_packetizer_test_iec61883_4_ts(struct kunit *test)
+{
+	mse_packetizer_test_iec61883_4_run(test, MSE_MPEG2TS_TYPE_TS);
+}
+
+static void mse_packetizer_test_iec61883_4_m2ts(struct kunit *test)
+{
+	mse_packetizer_test_iec61883_4_run(test, MSE_MPEG2TS_TYPE_M2TS);
+}
+#endif
+
+/* CRF carries PTP times of media clock edges, up to 6 in a packet */
+#define MSE_PACKETIZER_TEST_CRF_TIMES   (6)
+
+static void mse_packetizer_test_crf(struct kunit *test)
+{
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_audio_config audio = {
+		.sample_rate = 48000,
+		.channels = 2,
+		.samples_per_frame = 6,
+	};
+	u64 times[MSE_PACKETIZER_TEST_CRF_TIMES];
+	size_t dest_len;
+	int i, n, count, status;
+
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(test, &b,
+							sizeof(times)), 0);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(
+				&s, &mse_packetizer_crf_timestamp_audio_ops,
+				&audio, NULL, NULL), 0);
+
+	for (n = 1; n <= MSE_PACKETIZER_TEST_CRF_TIMES; n++) {
+		times[0] = ((u64)get_random_u32() << 32) | get_random_u32();
+		for (i = 1; i < n; i++)
+			times[i] = times[i - 1] + 125000;
+
+		count = mse_packetizer_test_roundtrip(test, &s, &b,
+						      (u8 *)times,
+						      n * sizeof(u64), 1,
+						      &dest_len, &status);
+		KUNIT_EXPECT_EQ_MSG(test, count, 1, "times %d", n);
+		KUNIT_EXPECT_EQ_MSG(test, status,
+				    MSE_PACKETIZE_STATUS_COMPLETE,
+				    "times %d", n);
+		KUNIT_EXPECT_EQ_MSG(test, dest_len, n * sizeof(u64),
+				    "times %d", n);
+		KUNIT_EXPECT_MEMEQ_MSG(test, b.dest, times, n * sizeof(u64),
+				       "times %d", n);
+	}
+
+	mse_packetizer_test_close(&s);
+}
+
+/*
+ * Microbenchmark of packetize and depacketize over a media buffer,
+ * compare runs of the same configuration on the target.
+ */
+static void mse_packetizer_test_bench(struct kunit *test)
+{
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+	static const struct mse_packetizer_test_pcm aaf = {
+		MSE_AUDIO_BIT_24, 3, 8, 48000, 24, false
+	};
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_6)
+	static const struct mse_packetizer_test_pcm iec61883_6 = {
+		MSE_AUDIO_BIT_24, 3, 8, 48000, 24, false
+	};
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264) || \
+	defined(CONFIG_MSE_PACKETIZER_CVF_MJPEG)
+	struct mse_packetizer_test_buffers b;
+	struct mse_packetizer_test_stream s;
+	struct mse_video_config video = {
+		.fps = { 30, 1 },
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	size_t len;
+	u8 *src;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_VIDEO_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_alloc(
+				test, &b, MSE_PACKETIZER_TEST_VIDEO_SIZE), 0);
+#endif
+
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+	mse_packetizer_test_pcm_bench(test, &mse_packetizer_aaf_ops,
+				      "aaf/s24/8ch", &aaf);
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_6)
+	mse_packetizer_test_pcm_bench(test, &mse_packetizer_iec61883_6_ops,
+				      "iec61883-6/s24/8ch", &iec61883_6);
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264)
+	video.format = MSE_VIDEO_FORMAT_H264_BYTE_STREAM;
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(
+				&s, &mse_packetizer_cvf_h264_ops, NULL, &video,
+				NULL), 0);
+	len = mse_packetizer_test_h264_frame(src, false, AVTP_PAYLOAD_MAX);
+	mse_packetizer_test_bench_one(test, "cvf-h264/byte-stream", &s, &b,
+				      src, len);
+	mse_packetizer_test_close(&s);
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_MJPEG)
+	video.format = MSE_VIDEO_FORMAT_MJPEG;
+	KUNIT_ASSERT_EQ(test, mse_packetizer_test_open(
+				&s, &mse_packetizer_cvf_mjpeg_ops, NULL, &video,
+				NULL), 0);
+	len = mse_packetizer_test_mjpeg_frame(&mse_packetizer_test_mjpegs[0],
+					      src);
+	mse_packetizer_test_bench_one(test, "cvf-mjpeg/420", &s, &b,
+				      src, len);
+	mse_packetizer_test_close(&s);
+#endif
+}
+
+#if defined(CONFIG_HAS_DMA)
+/*
+ * Packetize into a ring of DMA memory as mse_packet_ctrl does, to compare
+ * packet buffer types. Coherent memory is uncached where DMA does not
+ * snoop CPU caches, streaming memory is cacheable and each packet is
+ * synced for the device before it would be sent.
+ */
+#define MSE_PACKETIZER_TEST_DMA_SLOTS   (64)
+#define MSE_PACKETIZER_TEST_DMA_SIZE \
+	(MSE_PACKETIZER_TEST_DMA_SLOTS * MSE_PACKETIZER_TEST_PACKET_SIZE)
+
+static void mse_packetizer_test_dma_one(struct kunit *test,
+					struct device *dev,
+					const char *name,
+					struct mse_packetizer_test_stream *s,
+					u8 *src, size_t src_len,
+					bool streaming)
+{
+	size_t processed, packet_size, offset;
+	unsigned int timestamp = 0;
+	u64 packets = 0, start, ns;
+	dma_addr_t paddr;
+	void *vaddr;
+	int i, slot = 0, ret;
+
+	if (streaming)
+		vaddr = dma_alloc_noncoherent(dev,
+					      MSE_PACKETIZER_TEST_DMA_SIZE,
+					      &paddr, DMA_TO_DEVICE,
+					      GFP_KERNEL);
+	else
+		vaddr = dma_alloc_coherent(dev, MSE_PACKETIZER_TEST_DMA_SIZE,
+					   &paddr, GFP_KERNEL);
+	KUNIT_EXPECT_NOT_NULL(test, vaddr);
+	if (!vaddr)
+		return;
+
+	start = ktime_get_ns();
+	for (i = 0; i < MSE_PACKETIZER_TEST_BENCH_LOOPS; i++) {
+		processed = 0;
+		do {
+			offset = slot * MSE_PACKETIZER_TEST_PACKET_SIZE;
+			ret = s->ops->packetize(s->tx, vaddr + offset,
+						&packet_size, src, src_len,
+						&processed, &timestamp);
+			if (ret < 0 || ret == MSE_PACKETIZE_STATUS_NOT_ENOUGH)
+				break;
+
+			if (streaming)
+				dma_sync_single_for_device(dev, paddr + offset,
+							   packet_size,
+							   DMA_TO_DEVICE);
+			slot = (slot + 1) % MSE_PACKETIZER_TEST_DMA_SLOTS;
+			timestamp += MSE_PACKETIZER_TEST_INTERVAL;
+			packets++;
+		} while (ret == MSE_PACKETIZE_STATUS_CONTINUE);
+	}
+	ns = ktime_get_ns() - start;
+
+	if (streaming)
+		dma_free_noncoherent(dev, MSE_PACKETIZER_TEST_DMA_SIZE, vaddr,
+				     paddr, DMA_TO_DEVICE);
+	else
+		dma_free_coherent(dev, MSE_PACKETIZER_TEST_DMA_SIZE, vaddr,
+				  paddr);
+
+	KUNIT_EXPECT_GT(test, packets, 0);
+	if (!packets)
+		return;
+
+	kunit_info(test, "%-24s %-9s %llu ns/packet\n", name,
+		   streaming ? "streaming" : "coherent",
+		   div64_u64(ns, packets));
+}
+
+static void mse_packetizer_test_dma_run(struct kunit *test,
+					struct device *dev,
+					const char *name,
+					struct mse_packetizer_test_stream *s,
+					u8 *src, size_t src_len)
+{
+	mse_packetizer_test_dma_one(test, dev, name, s, src, src_len, false);
+	mse_packetizer_test_dma_one(test, dev, name, s, src, src_len, true);
+}
+
+static void mse_packetizer_test_bench_dma(struct kunit *test)
+{
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+	static const struct mse_packetizer_test_pcm aaf = {
+		MSE_AUDIO_BIT_24, 3, 8, 48000, 24, false
+	};
+	struct mse_audio_config audio;
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264)
+	struct mse_video_config video = {
+		.format = MSE_VIDEO_FORMAT_H264_BYTE_STREAM,
+		.fps = { 30, 1 },
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+#endif
+	struct mse_packetizer_test_stream s;
+	struct device *dev;
+	size_t len;
+	u8 *src;
+	int ret;
+
+	src = kunit_kmalloc(test, MSE_PACKETIZER_TEST_VIDEO_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+
+	/* a device without IOMMU, DMA is direct mapped */
+	dev = root_device_register("mse_packetizer_test");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+	if (dma_coerce_mask_and_coherent(dev, DMA_BIT_MASK(32))) {
+		KUNIT_FAIL(test, "cannot set DMA mask");
+		goto out;
+	}
+
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+	mse_packetizer_test_pcm_config(&aaf, &audio);
+	ret = mse_packetizer_test_open(&s, &mse_packetizer_aaf_ops, &audio,
+				       NULL, NULL);
+	KUNIT_EXPECT_EQ(test, ret, 0);
+	if (!ret) {
+		len = mse_packetizer_test_pcm_fill(&aaf, src);
+		mse_packetizer_test_dma_run(test, dev, "aaf/s24/8ch", &s,
+					    src, len);
+		mse_packetizer_test_close(&s);
+	}
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264)
+	ret = mse_packetizer_test_open(&s, &mse_packetizer_cvf_h264_ops, NULL,
+				       &video, NULL);
+	KUNIT_EXPECT_EQ(test, ret, 0);
+	if (!ret) {
+		len = mse_packetizer_test_h264_frame(src, false,
+						     AVTP_PAYLOAD_MAX);
+		mse_packetizer_test_dma_run(test, dev, "cvf-h264/byte-stream",
+					    &s, src, len);
+		mse_packetizer_test_close(&s);
+	}
+#endif
+
+out:
+	root_device_unregister(dev);
+}
+#endif
+
+static struct kunit_case mse_packetizer_test_cases[] = {
+#if defined(CONFIG_MSE_PACKETIZER_AAF)
+	KUNIT_CASE(mse_packetizer_test_aaf),
+	KUNIT_CASE(mse_packetizer_test_aaf_burst),
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_6)
+	KUNIT_CASE(mse_packetizer_test_iec61883_6),
+	KUNIT_CASE(mse_packetizer_test_iec61883_6_burst),
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_H264)
+	KUNIT_CASE(mse_packetizer_test_cvf_h264),
+	KUNIT_CASE(mse_packetizer_test_cvf_h264_d13),
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_CVF_MJPEG)
+	KUNIT_CASE(mse_packetizer_test_cvf_mjpeg),
+#endif
+#if defined(CONFIG_MSE_PACKETIZER_IEC61883_4)
+	KUNIT_CASE(mse_packetizer_test_iec61883_4_ts),
+	KUNIT_CASE(mse_packetizer_test_iec61883_4_m2ts),
+#endif
+	KUNIT_CASE(mse_packetizer_test_crf),
+	KUNIT_CASE(mse_packetizer_test_bench),
+#if defined(CONFIG_HAS_DMA)
+	KUNIT_CASE(mse_packetizer_test_bench_dma),
+#endif
+	{}
+};
+
+static struct kunit_suite mse_packetizer_test_suite = {
+	.name = "mse_packetizer",
+	.test_cases = mse_packetizer_test_cases,
+};
+
+kunit_test_suite(mse_packetizer_test_suite);
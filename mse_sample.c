@@ -0,0 +1,329 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <asm/unaligned.h>
+#ifdef CONFIG_MSE_SAMPLE_NEON
+#include <asm/neon.h>
+#include <asm/simd.h>
+#endif
+
+#include "mse_sample.h"
+
+static void mse_sample_swap16_generic(u8 *dest, const u8 *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++, dest += 2, src += 2)
+		put_unaligned_be16(get_unaligned_le16(src), dest);
+}
+
+static void mse_sample_swap24_generic(u8 *dest, const u8 *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++, dest += 3, src += 3) {
+		dest[0] = src[2];
+		dest[1] = src[1];
+		dest[2] = src[0];
+	}
+}
+
+static void mse_sample_swap32_generic(u8 *dest, const u8 *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++, dest += 4, src += 4)
+		put_unaligned_be32(get_unaligned_le32(src), dest);
+}
+
+static void mse_sample_pack24_generic(u8 *dest, const u8 *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++, dest += 3, src += 4) {
+		dest[0] = src[2];
+		dest[1] = src[1];
+		dest[2] = src[0];
+	}
+}
+
+static void mse_sample_unpack24_generic(u8 *dest, const u8 *src, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++, dest += 4, src += 3) {
+		dest[0] = src[2];
+		dest[1] = src[1];
+		dest[2] = src[0];
+		dest[3] = (src[0] & 0x80) ? 0xFF : 0x00;
+	}
+}
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+/* shorter runs of samples are not worth saving NEON registers */
+#define MSE_SAMPLE_NEON_MIN     (64)
+
+/* return the number of samples to be converted by NEON */
+static int mse_sample_neon_count(int count)
+{
+	if (count < MSE_SAMPLE_NEON_MIN || !may_use_simd())
+		return 0;
+
+	return round_down(count, MSE_SAMPLE_NEON_STEP);
+}
+
+/* return the number of samples converted by NEON */
+static int mse_sample_neon(void (*func)(void *, const void *, int),
+			   void *dest, const void *src, int count)
+{
+	count = mse_sample_neon_count(count);
+	if (!count)
+		return 0;
+
+	kernel_neon_begin();
+	func(dest, src, count);
+	kernel_neon_end();
+
+	return count;
+}
+#else
+#define mse_sample_neon(func, dest, src, count) (0)
+#endif
+
+#define DEFINE_MSE_SAMPLE_FUNC(name, dest_byte, src_byte) \
+	void mse_sample_##name(void *dest, const void *src, int count) \
+	{ \
+		int done; \
+		done = mse_sample_neon(mse_sample_##name##_neon, \
+				       dest, src, count); \
+		mse_sample_##name##_generic(dest + done * (dest_byte), \
+					    src + done * (src_byte), \
+					    count - done); \
+	}
+
+DEFINE_MSE_SAMPLE_FUNC(swap16, 2, 2)
+DEFINE_MSE_SAMPLE_FUNC(swap24, 3, 3)
+DEFINE_MSE_SAMPLE_FUNC(swap32, 4, 4)
+DEFINE_MSE_SAMPLE_FUNC(pack24, 3, 4)
+DEFINE_MSE_SAMPLE_FUNC(unpack24, 4, 3)
+
+#define AM824_QUADLET_SIZE      (4)
+
+#define AM824_LABEL_MBLA_24BIT  (0x40)
+#define AM824_LABEL_MBLA_20BIT  (0x41)
+#define AM824_LABEL_MBLA_16BIT  (0x42)
+#define AM824_LABEL_VBL_MASK    (0x03)
+
+int mse_sample_am824_init(struct mse_sample_am824 *am824,
+			  int bit_depth,
+			  int bytes_per_sample,
+			  bool is_big_endian)
+{
+	switch (bit_depth) {
+	case 16:
+		am824->label = AM824_LABEL_MBLA_16BIT;
+		am824->shift = 0;
+		break;
+	case 18:
+		am824->label = AM824_LABEL_MBLA_20BIT;
+		am824->shift = 6;
+		break;
+	case 20:
+		am824->label = AM824_LABEL_MBLA_20BIT;
+		am824->shift = 4;
+		break;
+	case 24:
+		am824->label = AM824_LABEL_MBLA_24BIT;
+		am824->shift = 0;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (bytes_per_sample < 2 || bytes_per_sample > 4)
+		return -EINVAL;
+
+	am824->bytes_per_sample = bytes_per_sample;
+	am824->is_big_endian = is_big_endian;
+
+	return 0;
+}
+
+/* sample to 24 bit data, 16 bit sample is put on upper bits */
+static inline u32 am824_get_sample(const u8 *src, int bytes, bool be)
+{
+	switch (bytes) {
+	case 2:
+		return (be ? get_unaligned_be16(src) :
+			get_unaligned_le16(src)) << 8;
+	case 3:
+		return be ? src[0] << 16 | src[1] << 8 | src[2] :
+			src[2] << 16 | src[1] << 8 | src[0];
+	default:
+		return be ? get_unaligned_be32(src) : get_unaligned_le32(src);
+	}
+}
+
+/* 24 bit data to sample, S24 in 32 bit container is sign extended */
+static inline void am824_put_sample(u32 value, u8 *dest, int bytes, bool be)
+{
+	switch (bytes) {
+	case 2:
+		if (be)
+			put_unaligned_be16(value >> 8, dest);
+		else
+			put_unaligned_le16(value >> 8, dest);
+		break;
+	case 3:
+		dest[be ? 0 : 2] = value >> 16;
+		dest[1] = value >> 8;
+		dest[be ? 2 : 0] = value;
+		break;
+	default:
+		value = (value ^ 0x800000) - 0x800000;
+		if (be)
+			put_unaligned_be32(value, dest);
+		else
+			put_unaligned_le32(value, dest);
+		break;
+	}
+}
+
+static void mse_sample_am824_encode_generic(
+	const struct mse_sample_am824 *am824,
+	u8 *dest, const u8 *src, int count)
+{
+	u32 label = am824->label << 24;
+	int bytes = am824->bytes_per_sample;
+	bool be = am824->is_big_endian;
+	u32 value;
+	int i;
+
+	for (i = 0; i < count; i++, dest += AM824_QUADLET_SIZE, src += bytes) {
+		value = am824_get_sample(src, bytes, be) << am824->shift;
+		put_unaligned_be32(label | (value & 0xFFFFFF), dest);
+	}
+}
+
+static int mse_sample_am824_decode_generic(
+	const struct mse_sample_am824 *am824,
+	u8 *dest, const u8 *src, int count)
+{
+	int bytes = am824->bytes_per_sample;
+	bool be = am824->is_big_endian;
+	u32 value;
+	int i;
+
+	for (i = 0; i < count; i++, dest += bytes, src += AM824_QUADLET_SIZE) {
+		if ((src[0] ^ am824->label) & AM824_LABEL_VBL_MASK)
+			break;
+
+		value = get_unaligned_be32(src) & 0xFFFFFF;
+		am824_put_sample(value >> am824->shift, dest, bytes, be);
+	}
+
+	return i;
+}
+
+void mse_sample_am824_encode(const struct mse_sample_am824 *am824,
+			     void *dest, const void *src, int count)
+{
+	int done = 0;
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+	done = mse_sample_neon_count(count);
+	if (done) {
+		kernel_neon_begin();
+		mse_sample_am824_encode_neon(am824, dest, src, done);
+		kernel_neon_end();
+	}
+#endif
+
+	mse_sample_am824_encode_generic(
+		am824,
+		dest + done * AM824_QUADLET_SIZE,
+		src + done * am824->bytes_per_sample,
+		count - done);
+}
+
+int mse_sample_am824_decode(const struct mse_sample_am824 *am824,
+			    void *dest, const void *src, int count)
+{
+	int done = 0;
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+	done = mse_sample_neon_count(count);
+	if (done) {
+		kernel_neon_begin();
+		done = mse_sample_am824_decode_neon(am824, dest, src, done);
+		kernel_neon_end();
+	}
+#endif
+
+	return done + mse_sample_am824_decode_generic(
+		am824,
+		dest + done * am824->bytes_per_sample,
+		src + done * AM824_QUADLET_SIZE,
+		count - done);
+}
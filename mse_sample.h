@@ -0,0 +1,119 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#ifndef __MSE_SAMPLE_H__
+#define __MSE_SAMPLE_H__
+
+#include <linux/types.h>
+
+/*
+ * Audio sample conversion between ALSA formats and network byte order.
+ * count is the number of samples, dest and src must not overlap.
+ */
+
+/* swap byte order of 16, 24 and 32 bit samples */
+void mse_sample_swap16(void *dest, const void *src, int count);
+void mse_sample_swap24(void *dest, const void *src, int count);
+void mse_sample_swap32(void *dest, const void *src, int count);
+/* S24_LE in 32 bit container to 24 bit big endian */
+void mse_sample_pack24(void *dest, const void *src, int count);
+/* 24 bit big endian to S24_LE in 32 bit container, sign extended */
+void mse_sample_unpack24(void *dest, const void *src, int count);
+
+/* AM824 MBLA quadlets of IEC 61883-6 */
+struct mse_sample_am824 {
+	u8 label;               /* MBLA label of the bit depth */
+	u8 shift;               /* left shift of sample in 24 bit data */
+	u8 bytes_per_sample;
+	bool is_big_endian;
+};
+
+int mse_sample_am824_init(struct mse_sample_am824 *am824,
+			  int bit_depth,
+			  int bytes_per_sample,
+			  bool is_big_endian);
+/* samples to quadlets */
+void mse_sample_am824_encode(const struct mse_sample_am824 *am824,
+			     void *dest, const void *src, int count);
+/*
+ * quadlets to samples, stops at the first quadlet which has other VBL
+ * than the label. return the number of decoded samples.
+ */
+int mse_sample_am824_decode(const struct mse_sample_am824 *am824,
+			    void *dest, const void *src, int count);
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+/* NEON processes MSE_SAMPLE_NEON_STEP samples at once */
+#define MSE_SAMPLE_NEON_STEP    (16)
+
+/* called between kernel_neon_begin() and kernel_neon_end() */
+void mse_sample_swap16_neon(void *dest, const void *src, int count);
+void mse_sample_swap24_neon(void *dest, const void *src, int count);
+void mse_sample_swap32_neon(void *dest, const void *src, int count);
+void mse_sample_pack24_neon(void *dest, const void *src, int count);
+void mse_sample_unpack24_neon(void *dest, const void *src, int count);
+void mse_sample_am824_encode_neon(const struct mse_sample_am824 *am824,
+				  void *dest, const void *src, int count);
+int mse_sample_am824_decode_neon(const struct mse_sample_am824 *am824,
+				 void *dest, const void *src, int count);
+#endif
+
+#endif /* __MSE_SAMPLE_H__ */
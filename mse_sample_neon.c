@@ -0,0 +1,270 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/types.h>
+#include <asm/neon-intrinsics.h>
+
+#include "mse_sample.h"
+
+/*
+ * count is multiple of MSE_SAMPLE_NEON_STEP, each loop converts 16
+ * samples. 24 bit samples are deinterleaved into planes of bytes by
+ * vld3q/vld4q, so swap and pack are done by reordering the planes.
+ */
+void mse_sample_swap16_neon(void *dest, const void *src, int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 32, d += 32) {
+		vst1q_u8(d, vrev16q_u8(vld1q_u8(s)));
+		vst1q_u8(d + 16, vrev16q_u8(vld1q_u8(s + 16)));
+	}
+}
+
+void mse_sample_swap24_neon(void *dest, const void *src, int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	uint8x16x3_t v;
+	uint8x16_t tmp;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 48, d += 48) {
+		v = vld3q_u8(s);
+		tmp = v.val[0];
+		v.val[0] = v.val[2];
+		v.val[2] = tmp;
+		vst3q_u8(d, v);
+	}
+}
+
+void mse_sample_swap32_neon(void *dest, const void *src, int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 64, d += 64) {
+		vst1q_u8(d, vrev32q_u8(vld1q_u8(s)));
+		vst1q_u8(d + 16, vrev32q_u8(vld1q_u8(s + 16)));
+		vst1q_u8(d + 32, vrev32q_u8(vld1q_u8(s + 32)));
+		vst1q_u8(d + 48, vrev32q_u8(vld1q_u8(s + 48)));
+	}
+}
+
+void mse_sample_pack24_neon(void *dest, const void *src, int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	uint8x16x4_t v;
+	uint8x16x3_t out;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 64, d += 48) {
+		v = vld4q_u8(s);
+		out.val[0] = v.val[2];
+		out.val[1] = v.val[1];
+		out.val[2] = v.val[0];
+		vst3q_u8(d, out);
+	}
+}
+
+void mse_sample_unpack24_neon(void *dest, const void *src, int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	uint8x16x3_t v;
+	uint8x16x4_t out;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 48, d += 64) {
+		v = vld3q_u8(s);
+		out.val[0] = v.val[2];
+		out.val[1] = v.val[1];
+		out.val[2] = v.val[0];
+		/* sign extend by MSB of the most significant byte */
+		out.val[3] = vreinterpretq_u8_s8(
+			vshrq_n_s8(vreinterpretq_s8_u8(v.val[0]), 7));
+		vst4q_u8(d, out);
+	}
+}
+
+/*
+ * AM824 quadlets are deinterleaved into planes of label and 24 bit data
+ * bytes (h, m, l). Shifts of 18 and 20 bit samples move bits between
+ * the neighbouring planes, the shift count 8 or more gives zero.
+ */
+static inline void am824_load_neon(const u8 *s, int bytes, bool be,
+				   uint8x16_t *h, uint8x16_t *m, uint8x16_t *l)
+{
+	uint8x16x2_t v2;
+	uint8x16x3_t v3;
+	uint8x16x4_t v4;
+
+	switch (bytes) {
+	case 2:
+		v2 = vld2q_u8(s);
+		*h = be ? v2.val[0] : v2.val[1];
+		*m = be ? v2.val[1] : v2.val[0];
+		*l = vdupq_n_u8(0);
+		break;
+	case 3:
+		v3 = vld3q_u8(s);
+		*h = be ? v3.val[0] : v3.val[2];
+		*m = v3.val[1];
+		*l = be ? v3.val[2] : v3.val[0];
+		break;
+	default:
+		v4 = vld4q_u8(s);
+		*h = be ? v4.val[1] : v4.val[2];
+		*m = be ? v4.val[2] : v4.val[1];
+		*l = be ? v4.val[3] : v4.val[0];
+		break;
+	}
+}
+
+static inline void am824_store_neon(u8 *d, int bytes, bool be,
+				    uint8x16_t h, uint8x16_t m, uint8x16_t l)
+{
+	uint8x16x2_t v2;
+	uint8x16x3_t v3;
+	uint8x16x4_t v4;
+	uint8x16_t sign;
+
+	switch (bytes) {
+	case 2:
+		v2.val[0] = be ? h : m;
+		v2.val[1] = be ? m : h;
+		vst2q_u8(d, v2);
+		break;
+	case 3:
+		v3.val[0] = be ? h : l;
+		v3.val[1] = m;
+		v3.val[2] = be ? l : h;
+		vst3q_u8(d, v3);
+		break;
+	default:
+		sign = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(h), 7));
+		v4.val[0] = be ? sign : l;
+		v4.val[1] = be ? h : m;
+		v4.val[2] = be ? m : h;
+		v4.val[3] = be ? l : sign;
+		vst4q_u8(d, v4);
+		break;
+	}
+}
+
+void mse_sample_am824_encode_neon(const struct mse_sample_am824 *am824,
+				  void *dest, const void *src, int count)
+{
+	int bytes = am824->bytes_per_sample;
+	bool be = am824->is_big_endian;
+	int8x16_t shl = vdupq_n_s8(am824->shift);
+	int8x16_t shr = vdupq_n_s8(am824->shift - 8);
+	const u8 *s = src;
+	u8 *d = dest;
+	uint8x16_t h, m, l;
+	uint8x16x4_t q;
+	int i;
+
+	q.val[0] = vdupq_n_u8(am824->label);
+	for (i = 0; i < count; i += 16, s += 16 * bytes, d += 64) {
+		am824_load_neon(s, bytes, be, &h, &m, &l);
+		q.val[1] = vorrq_u8(vshlq_u8(h, shl), vshlq_u8(m, shr));
+		q.val[2] = vorrq_u8(vshlq_u8(m, shl), vshlq_u8(l, shr));
+		q.val[3] = vshlq_u8(l, shl);
+		vst4q_u8(d, q);
+	}
+}
+
+int mse_sample_am824_decode_neon(const struct mse_sample_am824 *am824,
+				 void *dest, const void *src, int count)
+{
+	int bytes = am824->bytes_per_sample;
+	bool be = am824->is_big_endian;
+	int8x16_t shr = vdupq_n_s8(-am824->shift);
+	int8x16_t shl = vdupq_n_s8(8 - am824->shift);
+	uint8x16_t vbl_mask = vdupq_n_u8(0x03);
+	uint8x16_t vbl = vdupq_n_u8(am824->label & 0x03);
+	const u8 *s = src;
+	u8 *d = dest;
+	uint8x16_t h, m, l;
+	uint8x16x4_t q;
+	int i;
+
+	for (i = 0; i < count; i += 16, s += 64, d += 16 * bytes) {
+		q = vld4q_u8(s);
+
+		/* leave the block which has other label to generic one */
+		if (vminvq_u8(vceqq_u8(vandq_u8(q.val[0], vbl_mask), vbl)) !=
+		    0xFF)
+			break;
+
+		h = vshlq_u8(q.val[1], shr);
+		m = vorrq_u8(vshlq_u8(q.val[2], shr), vshlq_u8(q.val[1], shl));
+		l = vorrq_u8(vshlq_u8(q.val[3], shr), vshlq_u8(q.val[2], shl));
+		am824_store_neon(d, bytes, be, h, m, l);
+	}
+
+	return i;
+}
@@ -0,0 +1,539 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#ifdef CONFIG_MSE_SAMPLE_NEON
+#include <asm/neon.h>
+#endif
+
+#include "mse_sample.h"
+
+/*
+ * Sample conversions are compared bit by bit with byte wise references
+ * on random samples. Counts are around NEON threshold and step, so the
+ * NEON body and the generic tail are both covered, and buffers are
+ * shifted to catch unaligned access. Bytes after the last sample must
+ * not be written.
+ */
+#define MSE_SAMPLE_TEST_COUNT_MAX       (1024)
+#define MSE_SAMPLE_TEST_OFFSET          (3)
+#define MSE_SAMPLE_TEST_GUARD           (0x5A)
+
+static const int mse_sample_test_counts[] = {
+	0, 1, 15, 16, 17, 63, 64, 65, 79, 80, 127, 128, 131, 1000, 1024,
+};
+
+typedef void (*mse_sample_test_func)(void *dest, const void *src, int count);
+
+/* references, sample is reversed byte order */
+static void mse_sample_test_swap(u8 *dest, const u8 *src, int count,
+				 int bytes)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++, dest += bytes, src += bytes)
+		for (j = 0; j < bytes; j++)
+			dest[j] = src[bytes - 1 - j];
+}
+
+static void mse_sample_test_swap16_ref(void *dest, const void *src,
+				       int count)
+{
+	mse_sample_test_swap(dest, src, count, 2);
+}
+
+static void mse_sample_test_swap24_ref(void *dest, const void *src,
+				       int count)
+{
+	mse_sample_test_swap(dest, src, count, 3);
+}
+
+static void mse_sample_test_swap32_ref(void *dest, const void *src,
+				       int count)
+{
+	mse_sample_test_swap(dest, src, count, 4);
+}
+
+static void mse_sample_test_pack24_ref(void *dest, const void *src,
+				       int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	int i;
+
+	for (i = 0; i < count; i++, d += 3, s += 4) {
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+	}
+}
+
+static void mse_sample_test_unpack24_ref(void *dest, const void *src,
+					 int count)
+{
+	const u8 *s = src;
+	u8 *d = dest;
+	int i;
+
+	for (i = 0; i < count; i++, d += 4, s += 3) {
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = (s[0] & 0x80) ? 0xFF : 0x00;
+	}
+}
+
+static void mse_sample_test_run(struct kunit *test,
+				mse_sample_test_func func,
+				mse_sample_test_func neon,
+				mse_sample_test_func ref,
+				int dest_bytes,
+				int src_bytes)
+{
+	size_t dest_size, src_size;
+	u8 *dest, *expect, *src;
+	int i, offset, count;
+
+	dest_size = (MSE_SAMPLE_TEST_COUNT_MAX + 1) * dest_bytes +
+		MSE_SAMPLE_TEST_OFFSET;
+	src_size = MSE_SAMPLE_TEST_COUNT_MAX * src_bytes +
+		MSE_SAMPLE_TEST_OFFSET;
+
+	dest = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	expect = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	src = kunit_kmalloc(test, src_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dest);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, expect);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+
+	for (i = 0; i < ARRAY_SIZE(mse_sample_test_counts); i++) {
+		count = mse_sample_test_counts[i];
+
+		for (offset = 0; offset <= MSE_SAMPLE_TEST_OFFSET;
+		     offset += MSE_SAMPLE_TEST_OFFSET) {
+			get_random_bytes(src, src_size);
+			memset(expect, MSE_SAMPLE_TEST_GUARD, dest_size);
+			ref(expect + offset, src + offset, count);
+
+			memset(dest, MSE_SAMPLE_TEST_GUARD, dest_size);
+			func(dest + offset, src + offset, count);
+			KUNIT_EXPECT_EQ_MSG(test,
+					    memcmp(dest, expect, dest_size), 0,
+					    "count=%d offset=%d",
+					    count, offset);
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+			/* NEON body alone, public one may not use it */
+			if (count % MSE_SAMPLE_NEON_STEP)
+				continue;
+
+			memset(dest, MSE_SAMPLE_TEST_GUARD, dest_size);
+			kernel_neon_begin();
+			neon(dest + offset, src + offset, count);
+			kernel_neon_end();
+			KUNIT_EXPECT_EQ_MSG(test,
+					    memcmp(dest, expect, dest_size), 0,
+					    "neon count=%d offset=%d",
+					    count, offset);
+#endif
+		}
+	}
+}
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+#define MSE_SAMPLE_TEST_NEON(name)      mse_sample_##name##_neon
+#else
+#define MSE_SAMPLE_TEST_NEON(name)      NULL
+#endif
+
+#define DEFINE_MSE_SAMPLE_TEST(name, dest_bytes, src_bytes) \
+	static void mse_sample_test_##name(struct kunit *test) \
+	{ \
+		mse_sample_test_run(test, \
+				    mse_sample_##name, \
+				    MSE_SAMPLE_TEST_NEON(name), \
+				    mse_sample_test_##name##_ref, \
+				    dest_bytes, src_bytes); \
+	}
+
+DEFINE_MSE_SAMPLE_TEST(swap16, 2, 2)
+DEFINE_MSE_SAMPLE_TEST(swap24, 3, 3)
+DEFINE_MSE_SAMPLE_TEST(swap32, 4, 4)
+DEFINE_MSE_SAMPLE_TEST(pack24, 3, 4)
+DEFINE_MSE_SAMPLE_TEST(unpack24, 4, 3)
+
+/* AM824 reference, sample is 24 bit data shifted by bit depth */
+static u32 mse_sample_test_am824_get(const u8 *s, int bytes, bool be)
+{
+	switch (bytes) {
+	case 2:
+		return be ? s[0] << 16 | s[1] << 8 : s[1] << 16 | s[0] << 8;
+	case 3:
+		return be ? s[0] << 16 | s[1] << 8 | s[2] :
+			s[2] << 16 | s[1] << 8 | s[0];
+	default:
+		return be ? s[1] << 16 | s[2] << 8 | s[3] :
+			s[2] << 16 | s[1] << 8 | s[0];
+	}
+}
+
+static void mse_sample_test_am824_put(u32 v, u8 *d, int bytes, bool be)
+{
+	u8 sign = (v & 0x800000) ? 0xFF : 0x00;
+
+	switch (bytes) {
+	case 2:
+		d[be ? 0 : 1] = v >> 16;
+		d[be ? 1 : 0] = v >> 8;
+		break;
+	case 3:
+		d[be ? 0 : 2] = v >> 16;
+		d[1] = v >> 8;
+		d[be ? 2 : 0] = v;
+		break;
+	default:
+		d[be ? 0 : 3] = sign;
+		d[be ? 1 : 2] = v >> 16;
+		d[be ? 2 : 1] = v >> 8;
+		d[be ? 3 : 0] = v;
+		break;
+	}
+}
+
+static void mse_sample_test_am824_encode_ref(
+	const struct mse_sample_am824 *am824, u8 *d, const u8 *s, int count)
+{
+	int bytes = am824->bytes_per_sample;
+	u32 v;
+	int i;
+
+	for (i = 0; i < count; i++, d += 4, s += bytes) {
+		v = mse_sample_test_am824_get(s, bytes, am824->is_big_endian);
+		v = (v << am824->shift) & 0xFFFFFF;
+		d[0] = am824->label;
+		d[1] = v >> 16;
+		d[2] = v >> 8;
+		d[3] = v;
+	}
+}
+
+static int mse_sample_test_am824_decode_ref(
+	const struct mse_sample_am824 *am824, u8 *d, const u8 *s, int count)
+{
+	int bytes = am824->bytes_per_sample;
+	u32 v;
+	int i;
+
+	for (i = 0; i < count; i++, d += bytes, s += 4) {
+		if ((s[0] & 0x03) != (am824->label & 0x03))
+			break;
+
+		v = (s[1] << 16 | s[2] << 8 | s[3]) >> am824->shift;
+		mse_sample_test_am824_put(v, d, bytes, am824->is_big_endian);
+	}
+
+	return i;
+}
+
+static const int mse_sample_test_am824_depths[] = { 16, 18, 20, 24 };
+
+static void mse_sample_test_am824_encode(struct kunit *test)
+{
+	struct mse_sample_am824 am824;
+	size_t dest_size, src_size;
+	u8 *dest, *expect, *src;
+	int d, bytes, be, i, count;
+
+	dest_size = (MSE_SAMPLE_TEST_COUNT_MAX + 1) * 4;
+	src_size = MSE_SAMPLE_TEST_COUNT_MAX * 4;
+	dest = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	expect = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	src = kunit_kmalloc(test, src_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dest);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, expect);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+
+	for (d = 0; d < ARRAY_SIZE(mse_sample_test_am824_depths); d++)
+	for (bytes = 2; bytes <= 4; bytes++)
+	for (be = 0; be <= 1; be++) {
+		KUNIT_ASSERT_EQ(test, mse_sample_am824_init(
+				&am824, mse_sample_test_am824_depths[d],
+				bytes, be), 0);
+
+		for (i = 0; i < ARRAY_SIZE(mse_sample_test_counts); i++) {
+			count = mse_sample_test_counts[i];
+			get_random_bytes(src, src_size);
+
+			memset(expect, MSE_SAMPLE_TEST_GUARD, dest_size);
+			mse_sample_test_am824_encode_ref(&am824, expect, src,
+							 count);
+			memset(dest, MSE_SAMPLE_TEST_GUARD, dest_size);
+			mse_sample_am824_encode(&am824, dest, src, count);
+			KUNIT_EXPECT_EQ_MSG(test,
+					    memcmp(dest, expect, dest_size), 0,
+					    "depth=%d bytes=%d be=%d count=%d",
+					    mse_sample_test_am824_depths[d],
+					    bytes, be, count);
+		}
+	}
+}
+
+/*
+ * Decoding stops at the quadlet which has other VBL. Stops in the first
+ * NEON step leave the whole run to the generic tail, later ones hand it
+ * over at the step which has the stop, so both are tried with a random
+ * one.
+ */
+static const int mse_sample_test_am824_stops[] = { 0, 1, 15, 16, 17, 63 };
+
+static void mse_sample_test_am824_decode_one(
+	struct kunit *test, const struct mse_sample_am824 *am824,
+	u8 *dest, u8 *expect, u8 *src, size_t dest_size, int count, int stop)
+{
+	int i, ret;
+
+	/* quadlets of random data, one has other label */
+	get_random_bytes(src, count * 4);
+	for (i = 0; i < count; i++)
+		src[i * 4] = am824->label;
+	if (stop < count)
+		src[stop * 4] ^= 1 + get_random_u32() % 3;
+
+	memset(expect, MSE_SAMPLE_TEST_GUARD, dest_size);
+	KUNIT_EXPECT_EQ(test,
+			mse_sample_test_am824_decode_ref(am824, expect, src,
+							 count),
+			stop);
+	memset(dest, MSE_SAMPLE_TEST_GUARD, dest_size);
+	ret = mse_sample_am824_decode(am824, dest, src, count);
+	KUNIT_EXPECT_EQ_MSG(test, ret, stop,
+			    "label=0x%x bytes=%d be=%d count=%d",
+			    am824->label, am824->bytes_per_sample,
+			    am824->is_big_endian, count);
+	KUNIT_EXPECT_EQ_MSG(test, memcmp(dest, expect, dest_size), 0,
+			    "label=0x%x bytes=%d be=%d count=%d stop=%d",
+			    am824->label, am824->bytes_per_sample,
+			    am824->is_big_endian, count, stop);
+
+#ifdef CONFIG_MSE_SAMPLE_NEON
+	/* NEON body alone returns the start of the step with the stop */
+	if (count % MSE_SAMPLE_NEON_STEP)
+		return;
+
+	memset(dest, MSE_SAMPLE_TEST_GUARD, dest_size);
+	kernel_neon_begin();
+	ret = mse_sample_am824_decode_neon(am824, dest, src, count);
+	kernel_neon_end();
+	KUNIT_EXPECT_EQ_MSG(test, ret, round_down(stop, MSE_SAMPLE_NEON_STEP),
+			    "neon count=%d stop=%d", count, stop);
+
+	memset(expect, MSE_SAMPLE_TEST_GUARD, dest_size);
+	mse_sample_test_am824_decode_ref(am824, expect, src, ret);
+	KUNIT_EXPECT_EQ_MSG(test, memcmp(dest, expect, dest_size), 0,
+			    "neon label=0x%x bytes=%d be=%d count=%d stop=%d",
+			    am824->label, am824->bytes_per_sample,
+			    am824->is_big_endian, count, stop);
+#endif
+}
+
+static void mse_sample_test_am824_decode(struct kunit *test)
+{
+	struct mse_sample_am824 am824;
+	size_t dest_size, src_size;
+	u8 *dest, *expect, *src;
+	int d, bytes, be, i, j, count, stop;
+
+	dest_size = (MSE_SAMPLE_TEST_COUNT_MAX + 1) * 4;
+	src_size = MSE_SAMPLE_TEST_COUNT_MAX * 4;
+	dest = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	expect = kunit_kmalloc(test, dest_size, GFP_KERNEL);
+	src = kunit_kmalloc(test, src_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dest);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, expect);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+
+	for (d = 0; d < ARRAY_SIZE(mse_sample_test_am824_depths); d++)
+	for (bytes = 2; bytes <= 4; bytes++)
+	for (be = 0; be <= 1; be++) {
+		KUNIT_ASSERT_EQ(test, mse_sample_am824_init(
+				&am824, mse_sample_test_am824_depths[d],
+				bytes, be), 0);
+
+		for (i = 0; i < ARRAY_SIZE(mse_sample_test_counts); i++) {
+			count = mse_sample_test_counts[i];
+
+			stop = count ? get_random_u32() % (count + 1) : 0;
+			mse_sample_test_am824_decode_one(test, &am824, dest,
+							 expect, src,
+							 dest_size, count,
+							 stop);
+
+			for (j = 0; j < ARRAY_SIZE(mse_sample_test_am824_stops);
+			     j++) {
+				stop = mse_sample_test_am824_stops[j];
+				if (stop >= count)
+					break;
+
+				mse_sample_test_am824_decode_one(
+					test, &am824, dest, expect, src,
+					dest_size, count, stop);
+			}
+		}
+	}
+}
+
+/*
+ * Microbenchmark, it only reports time per sample of each conversion and
+ * never fails on speed. Compare runs with and without MSE_SAMPLE_NEON on
+ * the target.
+ */
+#define MSE_SAMPLE_TEST_BENCH_COUNT     (1024)
+#define MSE_SAMPLE_TEST_BENCH_LOOPS     (1000)
+
+static void mse_sample_test_bench_report(struct kunit *test,
+					 const char *name, u64 ns)
+{
+	u64 samples = (u64)MSE_SAMPLE_TEST_BENCH_COUNT *
+		MSE_SAMPLE_TEST_BENCH_LOOPS;
+
+	kunit_info(test, "%-16s %llu ps/sample\n", name,
+		   div64_u64(ns * 1000, samples));
+}
+
+static void mse_sample_test_bench(struct kunit *test)
+{
+	static const struct {
+		const char *name;
+		mse_sample_test_func func;
+	} funcs[] = {
+		{ "swap16", mse_sample_swap16 },
+		{ "swap24", mse_sample_swap24 },
+		{ "swap32", mse_sample_swap32 },
+		{ "pack24", mse_sample_pack24 },
+		{ "unpack24", mse_sample_unpack24 },
+	};
+	struct mse_sample_am824 am824;
+	u8 *dest, *src;
+	u64 start;
+	int i, n;
+
+	dest = kunit_kmalloc(test, MSE_SAMPLE_TEST_BENCH_COUNT * 4,
+			     GFP_KERNEL);
+	src = kunit_kmalloc(test, MSE_SAMPLE_TEST_BENCH_COUNT * 4,
+			    GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dest);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, src);
+	get_random_bytes(src, MSE_SAMPLE_TEST_BENCH_COUNT * 4);
+
+	for (i = 0; i < ARRAY_SIZE(funcs); i++) {
+		start = ktime_get_ns();
+		for (n = 0; n < MSE_SAMPLE_TEST_BENCH_LOOPS; n++)
+			funcs[i].func(dest, src, MSE_SAMPLE_TEST_BENCH_COUNT);
+		mse_sample_test_bench_report(test, funcs[i].name,
+					     ktime_get_ns() - start);
+	}
+
+	KUNIT_ASSERT_EQ(test, mse_sample_am824_init(&am824, 24, 4, false), 0);
+
+	start = ktime_get_ns();
+	for (n = 0; n < MSE_SAMPLE_TEST_BENCH_LOOPS; n++)
+		mse_sample_am824_encode(&am824, dest, src,
+					MSE_SAMPLE_TEST_BENCH_COUNT);
+	mse_sample_test_bench_report(test, "am824_encode",
+				     ktime_get_ns() - start);
+
+	start = ktime_get_ns();
+	for (n = 0; n < MSE_SAMPLE_TEST_BENCH_LOOPS; n++)
+		KUNIT_EXPECT_EQ(test,
+				mse_sample_am824_decode(
+					&am824, src, dest,
+					MSE_SAMPLE_TEST_BENCH_COUNT),
+				MSE_SAMPLE_TEST_BENCH_COUNT);
+	mse_sample_test_bench_report(test, "am824_decode",
+				     ktime_get_ns() - start);
+}
+
+static struct kunit_case mse_sample_test_cases[] = {
+	KUNIT_CASE(mse_sample_test_swap16),
+	KUNIT_CASE(mse_sample_test_swap24),
+	KUNIT_CASE(mse_sample_test_swap32),
+	KUNIT_CASE(mse_sample_test_pack24),
+	KUNIT_CASE(mse_sample_test_unpack24),
+	KUNIT_CASE(mse_sample_test_am824_encode),
+	KUNIT_CASE(mse_sample_test_am824_decode),
+	KUNIT_CASE(mse_sample_test_bench),
+	{}
+};
+
+static struct kunit_suite mse_sample_test_suite = {
+	.name = "mse_sample",
+	.test_cases = mse_sample_test_cases,
+};
+
+kunit_test_suite(mse_sample_test_suite);
@@ -129,6 +129,16 @@
 #define MSE_SYSFS_NAME_STR_MAX_TRANSIT_TIME_NS       "max_transit_time_ns"
 #define MSE_SYSFS_NAME_STR_TX_DELAY_TIME_NS          "tx_delay_time_ns"
 #define MSE_SYSFS_NAME_STR_RX_DELAY_TIME_NS          "rx_delay_time_ns"
+#define MSE_SYSFS_NAME_STR_ZERO_COPY                 "zero_copy"
+#define MSE_SYSFS_NAME_STR_TX_RING_SIZE              "tx_ring_size"
+#define MSE_SYSFS_NAME_STR_RX_RING_SIZE              "rx_ring_size"
+#define MSE_SYSFS_NAME_STR_TX_BURST                  "tx_burst"
+#define MSE_SYSFS_NAME_STR_RX_BURST                  "rx_burst"
+#define MSE_SYSFS_NAME_STR_TX_BATCH_PACKETS          "tx_batch_packets"
+#define MSE_SYSFS_NAME_STR_TX_BATCH_GUARD_NS         "tx_batch_guard_ns"
+#define MSE_SYSFS_NAME_STR_TX_BATCH_SENDS            "tx_batch_sends"
+#define MSE_SYSFS_NAME_STR_TX_BATCH_MAX              "tx_batch_max"
+#define MSE_SYSFS_NAME_STR_TX_BATCH_DEADLINE         "tx_batch_deadline"
 
 struct convert_table {
 	int id;
@@ -219,6 +229,17 @@ static struct convert_table transmit_mode_table[] = {
 	},
 };
 
+static struct convert_table packet_buffer_type_table[] = {
+	{
+		MSE_PACKET_BUFFER_TYPE_COHERENT,
+		"coherent",
+	},
+	{
+		MSE_PACKET_BUFFER_TYPE_STREAMING,
+		"streaming",
+	},
+};
+
 /* function */
 static int strtobin(unsigned char *dest, const char *in_str, int len)
 {
@@ -1733,6 +1754,277 @@ static ssize_t mse_delay_time_u32_store(struct device *dev,
 	return len;
 }
 
+static ssize_t mse_packet_buffer_type_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int i, ret;
+
+	mse_debug("START %s\n", attr->attr.name);
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < MSE_PACKET_BUFFER_TYPE_MAX; i++) {
+		if (data.type == packet_buffer_type_table[i].id)
+			break;
+	}
+	if (i == MSE_PACKET_BUFFER_TYPE_MAX)
+		return -EPERM;
+
+	ret = sprintf(buf, "%s\n", packet_buffer_type_table[i].str);
+
+	mse_debug("END value=%s(%d) ret=%d\n", buf, data.type, ret);
+
+	return ret;
+}
+
+static ssize_t mse_packet_buffer_type_store(struct device *dev,
+					    struct device_attribute *attr,
+					    const char *buf,
+					    size_t len)
+{
+	enum MSE_PACKET_BUFFER_TYPE type = -1;
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int i, ret;
+	char buf2[MSE_NAME_LEN_MAX + 1];
+
+	mse_debug("START %s(%zd) to %s\n", buf, len, attr->attr.name);
+
+	if (len > sizeof(buf2))
+		return -EINVAL;
+
+	ret = mse_sysfs_strncpy_from_user(buf2, buf, sizeof(buf2));
+	if (ret < 0 || ret > MSE_NAME_LEN_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < MSE_PACKET_BUFFER_TYPE_MAX; i++) {
+		if (!mse_compare_param_key(buf2,
+					   packet_buffer_type_table[i].str)) {
+			type = packet_buffer_type_table[i].id;
+			break;
+		}
+	}
+	if (i == MSE_PACKET_BUFFER_TYPE_MAX)
+		return -EINVAL;
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	data.type = type;
+
+	ret = mse_config_set_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	mse_debug("END value=%s(%d) ret=%zd\n", buf, data.type, len);
+
+	return len;
+}
+
+static ssize_t mse_packet_buffer_bool_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int ret;
+	u32 value;
+
+	mse_debug("START %s\n", attr->attr.name);
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_ZERO_COPY,
+		     strlen(attr->attr.name)))
+		value = data.zero_copy;
+	else
+		return -EPERM;
+
+	ret = sprintf(buf, "%u\n", value);
+
+	mse_debug("END value=%s(%u) ret=%d\n", buf, value, ret);
+
+	return ret;
+}
+
+static ssize_t mse_packet_buffer_bool_store(struct device *dev,
+					    struct device_attribute *attr,
+					    const char *buf,
+					    size_t len)
+{
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int ret;
+	bool value;
+
+	mse_debug("START %s(%zd) to %s\n", buf, len, attr->attr.name);
+
+	ret = kstrtobool(buf, &value);
+	if (ret)
+		return -EINVAL;
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_ZERO_COPY,
+		     strlen(attr->attr.name)))
+		data.zero_copy = value;
+	else
+		return -EPERM;
+
+	ret = mse_config_set_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	mse_debug("END value=%u ret=%zd\n", value, len);
+
+	return len;
+}
+
+static ssize_t mse_packet_buffer_u32_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int ret;
+	u32 value;
+
+	mse_debug("START %s\n", attr->attr.name);
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_RING_SIZE,
+		     strlen(attr->attr.name)))
+		value = data.tx_ring_size;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_RX_RING_SIZE,
+			  strlen(attr->attr.name)))
+		value = data.rx_ring_size;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BURST,
+			  strlen(attr->attr.name)))
+		value = data.tx_burst;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_RX_BURST,
+			  strlen(attr->attr.name)))
+		value = data.rx_burst;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_PACKETS,
+			  strlen(attr->attr.name)))
+		value = data.tx_batch_packets;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_GUARD_NS,
+			  strlen(attr->attr.name)))
+		value = data.tx_batch_guard_ns;
+	else
+		return -EPERM;
+
+	ret = sprintf(buf, "%u\n", value);
+
+	mse_debug("END value=%s(%u) ret=%d\n", buf, value, ret);
+
+	return ret;
+}
+
+static ssize_t mse_packet_buffer_u32_store(struct device *dev,
+					   struct device_attribute *attr,
+					   const char *buf,
+					   size_t len)
+{
+	struct mse_packet_buffer_config data;
+	int index = mse_dev_to_index(dev);
+	int ret;
+	u32 value;
+
+	mse_debug("START %s(%zd) to %s\n", buf, len, attr->attr.name);
+
+	ret = kstrtou32(buf, 0, &value);
+	if (ret)
+		return -EINVAL;
+
+	ret = mse_config_get_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_RING_SIZE,
+		     strlen(attr->attr.name)))
+		data.tx_ring_size = value;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_RX_RING_SIZE,
+			  strlen(attr->attr.name)))
+		data.rx_ring_size = value;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BURST,
+			  strlen(attr->attr.name)))
+		data.tx_burst = value;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_RX_BURST,
+			  strlen(attr->attr.name)))
+		data.rx_burst = value;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_PACKETS,
+			  strlen(attr->attr.name)))
+		data.tx_batch_packets = value;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_GUARD_NS,
+			  strlen(attr->attr.name)))
+		data.tx_batch_guard_ns = value;
+	else
+		return -EPERM;
+
+	/*
+	 * only the range of the field is checked here, so ring size, burst
+	 * and batch are written in any order. Their consistency is checked
+	 * when the stream is opened.
+	 */
+	ret = mse_config_set_packet_buffer_config(index, &data);
+	if (ret)
+		return ret;
+
+	mse_debug("END value=%u ret=%zd\n", value, len);
+
+	return len;
+}
+
+static ssize_t mse_packet_buffer_stats_show(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buf)
+{
+	struct mse_packet_buffer_stats data;
+	int index = mse_dev_to_index(dev);
+	int ret;
+	u64 value;
+
+	mse_debug("START %s\n", attr->attr.name);
+
+	ret = mse_config_get_packet_buffer_stats(index, &data);
+	if (ret)
+		return ret;
+
+	if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_SENDS,
+		     strlen(attr->attr.name)))
+		value = data.tx_batch_sends;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_PACKETS,
+			  strlen(attr->attr.name)))
+		value = data.tx_batch_packets;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_MAX,
+			  strlen(attr->attr.name)))
+		value = data.tx_batch_max;
+	else if (!strncmp(attr->attr.name, MSE_SYSFS_NAME_STR_TX_BATCH_DEADLINE,
+			  strlen(attr->attr.name)))
+		value = data.tx_batch_deadline;
+	else
+		return -EPERM;
+
+	ret = sprintf(buf, "%llu\n", value);
+
+	mse_debug("END value=%s(%llu) ret=%d\n", buf, value, ret);
+
+	return ret;
+}
+
 /* attribute variables */
 static MSE_DEVICE_ATTR_RO(device, info);
 static MSE_DEVICE_ATTR_RO(type, info);
@@ -2016,6 +2308,68 @@ static struct attribute_group mse_attr_group_delay_time = {
 	.attrs = mse_attr_delay_time,
 };
 
+static MSE_DEVICE_ATTR_RW(type, packet_buffer);
+static MSE_DEVICE_ATTR(zero_copy, packet_buffer, 0644,
+		       mse_packet_buffer_bool_show,
+		       mse_packet_buffer_bool_store);
+static MSE_DEVICE_ATTR(tx_ring_size, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+static MSE_DEVICE_ATTR(rx_ring_size, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+static MSE_DEVICE_ATTR(tx_burst, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+static MSE_DEVICE_ATTR(rx_burst, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+static MSE_DEVICE_ATTR(tx_batch_packets, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+static MSE_DEVICE_ATTR(tx_batch_guard_ns, packet_buffer, 0644,
+		       mse_packet_buffer_u32_show,
+		       mse_packet_buffer_u32_store);
+
+static struct attribute *mse_attr_packet_buffer[] = {
+	&mse_dev_attr_packet_buffer_type.attr,
+	&mse_dev_attr_packet_buffer_zero_copy.attr,
+	&mse_dev_attr_packet_buffer_tx_ring_size.attr,
+	&mse_dev_attr_packet_buffer_rx_ring_size.attr,
+	&mse_dev_attr_packet_buffer_tx_burst.attr,
+	&mse_dev_attr_packet_buffer_rx_burst.attr,
+	&mse_dev_attr_packet_buffer_tx_batch_packets.attr,
+	&mse_dev_attr_packet_buffer_tx_batch_guard_ns.attr,
+	NULL,
+};
+
+static struct attribute_group mse_attr_group_packet_buffer = {
+	.name = "packet_buffer",
+	.attrs = mse_attr_packet_buffer,
+};
+
+static MSE_DEVICE_ATTR(tx_batch_sends, packet_buffer_stats, 0444,
+		       mse_packet_buffer_stats_show, NULL);
+static MSE_DEVICE_ATTR(tx_batch_packets, packet_buffer_stats, 0444,
+		       mse_packet_buffer_stats_show, NULL);
+static MSE_DEVICE_ATTR(tx_batch_max, packet_buffer_stats, 0444,
+		       mse_packet_buffer_stats_show, NULL);
+static MSE_DEVICE_ATTR(tx_batch_deadline, packet_buffer_stats, 0444,
+		       mse_packet_buffer_stats_show, NULL);
+
+static struct attribute *mse_attr_packet_buffer_stats[] = {
+	&mse_dev_attr_packet_buffer_stats_tx_batch_sends.attr,
+	&mse_dev_attr_packet_buffer_stats_tx_batch_packets.attr,
+	&mse_dev_attr_packet_buffer_stats_tx_batch_max.attr,
+	&mse_dev_attr_packet_buffer_stats_tx_batch_deadline.attr,
+	NULL,
+};
+
+static struct attribute_group mse_attr_group_packet_buffer_stats = {
+	.name = "packet_buffer_stats",
+	.attrs = mse_attr_packet_buffer_stats,
+};
+
 /* external variable */
 const struct attribute_group *mse_attr_groups_audio[] = {
 	&mse_attr_group_info,
@@ -2029,6 +2383,8 @@ const struct attribute_group *mse_attr_groups_audio[] = {
 	&mse_attr_group_avtp_tx_crf,
 	&mse_attr_group_avtp_rx_crf,
 	&mse_attr_group_delay_time,
+	&mse_attr_group_packet_buffer,
+	&mse_attr_group_packet_buffer_stats,
 	NULL,
 };
 
@@ -2041,6 +2397,8 @@ const struct attribute_group *mse_attr_groups_video[] = {
 	&mse_attr_group_video_config,
 	&mse_attr_group_ptp_config_other,
 	&mse_attr_group_delay_time,
+	&mse_attr_group_packet_buffer,
+	&mse_attr_group_packet_buffer_stats,
 	NULL,
 };
 
@@ -2053,6 +2411,8 @@ const struct attribute_group *mse_attr_groups_mpeg2ts[] = {
 	&mse_attr_group_mpeg2ts_config,
 	&mse_attr_group_ptp_config_other,
 	&mse_attr_group_delay_time,
+	&mse_attr_group_packet_buffer,
+	&mse_attr_group_packet_buffer_stats,
 	NULL,
 };
 
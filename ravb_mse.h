@@ -226,6 +226,36 @@ struct mse_delay_time {
 	uint32_t rx_delay_time_ns;
 };
 
+enum MSE_PACKET_BUFFER_TYPE {
+	MSE_PACKET_BUFFER_TYPE_COHERENT,
+	MSE_PACKET_BUFFER_TYPE_STREAMING,
+	MSE_PACKET_BUFFER_TYPE_MAX,
+};
+
+#define MSE_CONFIG_RING_SIZE_MIN (4)
+#define MSE_CONFIG_RING_SIZE_MAX (4096)
+#define MSE_CONFIG_BURST_MIN     (1)
+#define MSE_CONFIG_BURST_MAX     (1024)
+
+struct mse_packet_buffer_config {
+	enum MSE_PACKET_BUFFER_TYPE type;
+	bool zero_copy;
+	uint32_t tx_ring_size;
+	uint32_t rx_ring_size;
+	uint32_t tx_burst;
+	uint32_t rx_burst;
+	uint32_t tx_batch_packets;
+	uint32_t tx_batch_guard_ns;
+};
+
+/* batches of packets sent by last TX stream, see tx_batch_packets */
+struct mse_packet_buffer_stats {
+	uint32_t tx_batch_sends;
+	uint32_t tx_batch_max;
+	uint64_t tx_batch_packets;
+	uint32_t tx_batch_deadline;
+};
+
 #define MSE_MAGIC               (0x21)
 
 #define MSE_G_INFO              _IOR(MSE_MAGIC, 1, struct mse_info)
@@ -259,5 +289,34 @@ struct mse_delay_time {
 #define MSE_G_AVTP_RX_PARAM_CRF _IOR(MSE_MAGIC, 23, struct mse_avtp_rx_param)
 #define MSE_S_DELAY_TIME        _IOW(MSE_MAGIC, 24, struct mse_delay_time)
 #define MSE_G_DELAY_TIME        _IOR(MSE_MAGIC, 25, struct mse_delay_time)
+#define MSE_S_PACKET_BUFFER_CONFIG \
+			_IOW(MSE_MAGIC, 26, struct mse_packet_buffer_config)
+#define MSE_G_PACKET_BUFFER_CONFIG \
+			_IOR(MSE_MAGIC, 27, struct mse_packet_buffer_config)
+#define MSE_G_PACKET_BUFFER_STATS \
+			_IOR(MSE_MAGIC, 28, struct mse_packet_buffer_stats)
+
+/*
+ * Controls of V4L2 adapter video device, the range of 16 controls from
+ * V4L2_CID_USER_MSE_BASE is reserved for this driver like the driver
+ * ranges V4L2_CID_USER_*_BASE of videodev2.h.
+ */
+#define V4L2_CID_USER_MSE_BASE          (V4L2_CID_USER_BASE + 0x1f00)
+
+/*
+ * NAL index of received H.264 frame, read only u32 array control of
+ * V4L2 adapter video device. The adapter takes the index when MSE
+ * completes a capture buffer, mse_get_nal_index() works only there, so the
+ * control holds the index of last completed capture buffer and not the one
+ * being received. Compare sequence with v4l2_buffer.sequence of DQBUF.
+ *   [0]         sequence of the capture buffer
+ *   [1]         number of NAL units, or'ed MSE_V4L2_NAL_INDEX_OVERFLOW
+ *               if the frame has more than MSE_NAL_INDEX_MAX
+ *   [2 + 3 * n] offset, size and nal_unit_type of n-th NAL unit
+ */
+#define MSE_NAL_INDEX_MAX               (64)
+#define MSE_V4L2_CID_NAL_INDEX          (V4L2_CID_USER_MSE_BASE + 0)
+#define MSE_V4L2_NAL_INDEX_OVERFLOW     (0x80000000)
+#define MSE_V4L2_NAL_INDEX_WORDS        (2 + 3 * MSE_NAL_INDEX_MAX)
 
 #endif /* __RAVB_MSE_H__ */
@@ -195,6 +195,37 @@ struct mse_video_config {
 	int max_interval_frames;
 };
 
+/**
+ * @brief NAL unit index of received H.264 frame
+ */
+struct mse_nal_entry {
+	/** @brief offset of start code or length field in frame */
+	u32 offset;
+	/** @brief size of NAL unit without start code or length field */
+	u32 size;
+	/** @brief nal_unit_type */
+	u8 type;
+};
+
+struct mse_nal_index {
+	/** @brief number of entries */
+	int num;
+	/** @brief frame has more NAL units than MSE_NAL_INDEX_MAX */
+	bool overflow;
+	/** @brief entries in order of frame */
+	struct mse_nal_entry entry[MSE_NAL_INDEX_MAX];
+};
+
+/**
+ * @brief marker offsets of JPEG frame found by media adapter
+ */
+struct mse_jpeg_markers {
+	/** @brief end of SOS header, 0 if unknown */
+	size_t header_len;
+	/** @brief offset just after EOI marker */
+	size_t eoi_offset;
+};
+
 /**
  * @brief mpeg2ts stream configuration
  */
@@ -222,6 +253,19 @@ struct mse_mpeg2ts_config {
 	int max_interval_frames;
 };
 
+/** @brief max number of payload vectors of a packet */
+#define MSE_PACKET_VEC_MAX (2)
+
+/**
+ * @brief payload vector mapped from media buffer
+ */
+struct mse_packet_vec {
+	/** @brief payload size */
+	unsigned int len;
+	/** @brief physical address for DMA */
+	dma_addr_t paddr;
+};
+
 /**
  * @brief DMA buffer for Adapter
  */
@@ -232,6 +276,10 @@ struct mse_packet {
 	dma_addr_t paddr;
 	/** @brief virtual address for driver */
 	void *vaddr;
+	/** @brief number of payload vectors following the packet */
+	int num_vec;
+	/** @brief payload vectors, transmitted after len bytes of packet */
+	struct mse_packet_vec vec[MSE_PACKET_VEC_MAX];
 };
 
 /**
@@ -271,6 +319,12 @@ struct mse_adapter_network_ops {
 	int (*send)(int index,
 		    struct mse_packet *packets,
 		    int num_packets);
+	/**
+	 * @brief reap function pointer, returns the number of sent packets
+	 * completed since last call. Without it, packets must be done with
+	 * when send returns.
+	 */
+	int (*reap)(int index);
 	/** @brief receive function pointer */
 	int (*receive_prepare)(int index,
 			       struct mse_packet *packets,
@@ -281,6 +335,22 @@ struct mse_adapter_network_ops {
 	int (*cancel)(int index);
 	/** @brief get link speed function pointer */
 	int (*get_link_speed)(int index);
+	/** @brief max number of packets in packet buffer, 0 is no limit */
+	int max_packets;
+	/** @brief max number of packets per send/receive, 0 is no limit */
+	int max_burst;
+	/**
+	 * @brief RX device delivers packets of any stream ID, so it can be
+	 * shared by RX instances. Otherwise set_streamid filters the device
+	 * for one stream.
+	 */
+	bool rx_shared;
+	/**
+	 * @brief packets are copied by CPU through vaddr instead of DMA,
+	 * so packet buffer is coherent and payload is not left in media
+	 * buffer.
+	 */
+	bool cpu_copy;
 };
 
 /**
@@ -493,6 +563,46 @@ int mse_start_transmission(int index,
 			   void *priv,
 			   int (*mse_completion)(void *priv, int size));
 
+/**
+ * @brief MSE start transmission of JPEG frame with its marker offsets
+ *
+ * Same as mse_start_transmission(), but the packetizer takes EOI from
+ * markers instead of scanning the frame again.
+ *
+ * @param[in] index MSE instance ID
+ * @param[in] buffer send data
+ * @param[in] buffer_size buffer size
+ * @param[in] markers marker offsets in buffer
+ * @param[out] priv private data
+ * @param[in] mse_completion callback function pointer
+ *
+ * @retval 0 Success
+ * @retval <0 Error
+ */
+int mse_start_transmission_jpeg(int index,
+				void *buffer,
+				size_t buffer_size,
+				const struct mse_jpeg_markers *markers,
+				void *priv,
+				int (*mse_completion)(void *priv, int size));
+
+/**
+ * @brief get NAL index of received H.264 frame
+ *
+ * Only valid in mse_completion callback, for the frame being completed.
+ * Outside of it, there is no frame and it fails instead of returning the
+ * index of a former frame.
+ *
+ * @param[in] index MSE instance ID
+ * @param[out] nal_index NAL index of the frame
+ *
+ * @retval 0 Success
+ * @retval -EBUSY Not called in mse_completion callback
+ * @retval -EPERM Instance does not index NAL units
+ * @retval <0 Error
+ */
+int mse_get_nal_index(int index, struct mse_nal_index *nal_index);
+
 /**
  * @brief register MCH to MSE
  *
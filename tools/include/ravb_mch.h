@@ -0,0 +1,2 @@
+/* user space build of packetizers, see tools/include/mse_shim.h */
+#include "mse_shim.h"
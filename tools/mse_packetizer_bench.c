@@ -0,0 +1,517 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2026 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+/*
+ * Throughput benchmark of packetizers in user space.
+ *
+ * Each case packetizes a synthetic media buffer over and over for a
+ * fixed time and reports ns/packet, packets/s and Gbit/s of media data
+ * consumed. Build and run with "make -C tools run".
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "ravb_mse_kernel.h"
+#include "mse_packetizer.h"
+#include "jpeg.h"
+
+#define BENCH_PACKET_SIZE	(2048)
+#define BENCH_BURST		(32)
+#define BENCH_TS_PACKETS	(7)
+#define BENCH_TS_SIZE		(188)
+#define BENCH_M2TS_SIZE		(4 + BENCH_TS_SIZE)
+#define BENCH_CRF_TIMES		(6)
+
+enum bench_mode {
+	BENCH_MODE_PACKETIZE,
+	BENCH_MODE_SG,
+	BENCH_MODE_BURST,
+};
+
+static const char * const bench_mode_name[] = {
+	[BENCH_MODE_PACKETIZE] = "packetize",
+	[BENCH_MODE_SG] = "sg",
+	[BENCH_MODE_BURST] = "burst",
+};
+
+enum bench_input {
+	BENCH_INPUT_PCM,
+	BENCH_INPUT_H264_BYTE_STREAM,
+	BENCH_INPUT_H264_AVC,
+	BENCH_INPUT_MJPEG,
+	BENCH_INPUT_TS,
+	BENCH_INPUT_M2TS,
+	BENCH_INPUT_CRF,
+};
+
+struct bench_case {
+	const char *name;
+	enum MSE_PACKETIZER id;
+	enum bench_input input;
+	/* PCM */
+	int channels;
+	enum MSE_AUDIO_BIT bit_depth;
+	int bytes_per_sample;
+	int sample_rate;
+};
+
+static const struct bench_case bench_cases[] = {
+	{ "aaf/s16/2ch/48k", MSE_PACKETIZER_AAF_PCM, BENCH_INPUT_PCM,
+	  2, MSE_AUDIO_BIT_16, 2, 48000 },
+	{ "aaf/s24/8ch/48k", MSE_PACKETIZER_AAF_PCM, BENCH_INPUT_PCM,
+	  8, MSE_AUDIO_BIT_24, 3, 48000 },
+	{ "aaf/s32/2ch/96k", MSE_PACKETIZER_AAF_PCM, BENCH_INPUT_PCM,
+	  2, MSE_AUDIO_BIT_32, 4, 96000 },
+	{ "iec61883-6/s16/2ch/48k", MSE_PACKETIZER_IEC61883_6, BENCH_INPUT_PCM,
+	  2, MSE_AUDIO_BIT_16, 2, 48000 },
+	{ "iec61883-6/s24/8ch/48k", MSE_PACKETIZER_IEC61883_6, BENCH_INPUT_PCM,
+	  8, MSE_AUDIO_BIT_24, 3, 48000 },
+	{ "cvf-h264/byte-stream", MSE_PACKETIZER_CVF_H264,
+	  BENCH_INPUT_H264_BYTE_STREAM },
+	{ "cvf-h264/avc", MSE_PACKETIZER_CVF_H264, BENCH_INPUT_H264_AVC },
+	{ "cvf-h264-d13/byte-stream", MSE_PACKETIZER_CVF_H264_D13,
+	  BENCH_INPUT_H264_BYTE_STREAM },
+	{ "cvf-mjpeg/420/640x480", MSE_PACKETIZER_CVF_MJPEG,
+	  BENCH_INPUT_MJPEG },
+	{ "iec61883-4/ts", MSE_PACKETIZER_IEC61883_4, BENCH_INPUT_TS },
+	{ "iec61883-4/m2ts", MSE_PACKETIZER_IEC61883_4, BENCH_INPUT_M2TS },
+	{ "crf/audio/48k", MSE_PACKETIZER_MAX, BENCH_INPUT_CRF,
+	  0, 0, 0, 48000 },
+};
+
+static u8 bench_buffer[1024 * 1024] __aligned(8);
+static u8 bench_packets[BENCH_BURST][BENCH_PACKET_SIZE];
+
+static u64 bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static size_t bench_make_pcm(const struct bench_case *c)
+{
+	/* 1024 frames, the same as a typical ALSA period */
+	size_t len = 1024 * c->channels * c->bytes_per_sample;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		bench_buffer[i] = rand();
+
+	return len;
+}
+
+static size_t bench_put_nal(size_t pos, bool avc, u8 type, size_t size)
+{
+	size_t i;
+
+	if (avc) {
+		put_unaligned_be32(size, &bench_buffer[pos]);
+		pos += 4;
+	} else {
+		put_unaligned_be32(1, &bench_buffer[pos]);
+		pos += 4;
+	}
+
+	bench_buffer[pos++] = 0x60 | type;
+	/* payload without start code emulation */
+	for (i = 1; i < size; i++)
+		bench_buffer[pos++] = 4 + rand() % 250;
+
+	return pos;
+}
+
+static size_t bench_make_h264(bool avc)
+{
+	size_t pos = 0;
+	int i;
+
+	/* AUD, SPS, PPS, a large IDR slice and a few small slices */
+	pos = bench_put_nal(pos, avc, 9, 2);
+	pos = bench_put_nal(pos, avc, 7, 16);
+	pos = bench_put_nal(pos, avc, 8, 4);
+	pos = bench_put_nal(pos, avc, 5, 64 * 1024);
+	for (i = 0; i < 8; i++)
+		pos = bench_put_nal(pos, avc, 1, 40 + rand() % 2000);
+
+	return pos;
+}
+
+static size_t bench_make_mjpeg(void)
+{
+	struct mjpeg_quant_header qheader = { 0, 0, htons(128) };
+	u8 qtable[128];
+	size_t pos, i;
+
+	for (i = 0; i < sizeof(qtable); i++)
+		qtable[i] = 1 + rand() % 200;
+
+	pos = jpeg_make_header(MJPEG_TYPE_420, 255, bench_buffer, 640, 480,
+			       qtable, &qheader, 0);
+
+	/* entropy coded segment with byte stuffing, then EOI */
+	for (i = 0; i < 64 * 1024; i++) {
+		bench_buffer[pos++] = rand();
+		if (bench_buffer[pos - 1] == 0xff)
+			bench_buffer[pos++] = 0x00;
+	}
+	bench_buffer[pos++] = 0xff;
+	bench_buffer[pos++] = 0xd9;
+
+	return pos;
+}
+
+static size_t bench_make_ts(size_t src_packet_size)
+{
+	size_t len = src_packet_size * BENCH_TS_PACKETS * 64;
+	size_t pos, i;
+	u32 m2ts = 0;
+
+	for (pos = 0; pos < len; pos += src_packet_size) {
+		u8 *p = &bench_buffer[pos];
+
+		if (src_packet_size == BENCH_M2TS_SIZE) {
+			put_unaligned_be32(m2ts, p);
+			m2ts += 1000;
+			p += 4;
+		}
+		p[0] = 0x47;
+		for (i = 1; i < BENCH_TS_SIZE; i++)
+			p[i] = rand();
+	}
+
+	return len;
+}
+
+static size_t bench_make_crf(void)
+{
+	u64 *times = (u64 *)bench_buffer;
+	int i;
+
+	/* PTP times of media clock edges, as many as a CRF packet holds */
+	for (i = 0; i < BENCH_CRF_TIMES; i++)
+		times[i] = NSEC_PER_SEC + i * 125000ULL;
+
+	return BENCH_CRF_TIMES * sizeof(*times);
+}
+
+static int bench_setup(const struct bench_case *c,
+		       struct mse_packetizer_ops *ops,
+		       int index)
+{
+	struct mse_network_config net = {
+		.dest_addr = { 0x91, 0xe0, 0xf0, 0x00, 0x0e, 0x80 },
+		.source_addr = { 0x76, 0x90, 0x50, 0x00, 0x00, 0x01 },
+		.priority = 3,
+		.vlanid = 2,
+		.port_transmit_rate = 1000000000,
+	};
+	struct mse_audio_config audio = {
+		.sample_rate = c->sample_rate,
+		.channels = c->channels,
+		.period_size = 1024,
+		.bytes_per_sample = c->bytes_per_sample,
+		.sample_bit_depth = c->bit_depth,
+		.samples_per_frame = c->sample_rate / 8000,
+	};
+	struct mse_video_config video = {
+		.fps = { 30, 1 },
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	struct mse_mpeg2ts_config mpeg2ts = {
+		.bitrate = 50000000,
+		.tspackets_per_frame = BENCH_TS_PACKETS,
+		.mpeg2ts_type = MSE_MPEG2TS_TYPE_TS,
+		.transmit_mode = MSE_TRANSMIT_MODE_BITRATE,
+		.class_interval_frames = 8000,
+		.max_interval_frames = 1,
+	};
+	int ret;
+
+	ret = ops->init(index);
+	if (ret < 0)
+		return ret;
+
+	ret = ops->set_network_config(index, &net);
+	if (ret < 0)
+		return ret;
+
+	switch (c->input) {
+	case BENCH_INPUT_PCM:
+	case BENCH_INPUT_CRF:
+		return ops->set_audio_config(index, &audio);
+	case BENCH_INPUT_H264_BYTE_STREAM:
+		video.format = MSE_VIDEO_FORMAT_H264_BYTE_STREAM;
+		return ops->set_video_config(index, &video);
+	case BENCH_INPUT_H264_AVC:
+		video.format = MSE_VIDEO_FORMAT_H264_AVC;
+		return ops->set_video_config(index, &video);
+	case BENCH_INPUT_MJPEG:
+		video.format = MSE_VIDEO_FORMAT_MJPEG;
+		return ops->set_video_config(index, &video);
+	case BENCH_INPUT_M2TS:
+		mpeg2ts.mpeg2ts_type = MSE_MPEG2TS_TYPE_M2TS;
+		fallthrough;
+	case BENCH_INPUT_TS:
+		return ops->set_mpeg2ts_config(index, &mpeg2ts);
+	}
+
+	return -EINVAL;
+}
+
+static size_t bench_make_input(const struct bench_case *c)
+{
+	switch (c->input) {
+	case BENCH_INPUT_PCM:
+		return bench_make_pcm(c);
+	case BENCH_INPUT_H264_BYTE_STREAM:
+		return bench_make_h264(false);
+	case BENCH_INPUT_H264_AVC:
+		return bench_make_h264(true);
+	case BENCH_INPUT_MJPEG:
+		return bench_make_mjpeg();
+	case BENCH_INPUT_TS:
+		return bench_make_ts(BENCH_TS_SIZE);
+	case BENCH_INPUT_M2TS:
+		return bench_make_ts(BENCH_M2TS_SIZE);
+	case BENCH_INPUT_CRF:
+		return bench_make_crf();
+	}
+
+	return 0;
+}
+
+/* packetize whole buffer once, returns number of packets or error */
+static int bench_buffer_once(struct mse_packetizer_ops *ops,
+			     int index,
+			     enum bench_mode mode,
+			     size_t len,
+			     unsigned int *timestamp)
+{
+	struct mse_packet packets[BENCH_BURST];
+	struct mse_packet *ptrs[BENCH_BURST];
+	unsigned int timestamps[BENCH_BURST];
+	size_t processed = 0, packet_size, offset, size;
+	int count = 0, ret, i;
+
+	for (i = 0; i < BENCH_BURST; i++) {
+		packets[i].vaddr = bench_packets[i];
+		ptrs[i] = &packets[i];
+	}
+
+	do {
+		switch (mode) {
+		case BENCH_MODE_BURST:
+			for (i = 0; i < BENCH_BURST; i++)
+				timestamps[i] = *timestamp + i * 125000;
+			i = ops->packetize_burst(index, ptrs, timestamps,
+						 BENCH_BURST, bench_buffer, len,
+						 &processed, &ret);
+			if (i < 0)
+				return i;
+			count += i;
+			*timestamp += i * 125000;
+			break;
+		case BENCH_MODE_SG:
+			ret = ops->packetize_sg(index, bench_packets[0],
+						&packet_size, bench_buffer,
+						len, &processed, timestamp,
+						&offset, &size);
+			if (ret == MSE_PACKETIZE_STATUS_CONTINUE ||
+			    ret == MSE_PACKETIZE_STATUS_COMPLETE)
+				count++;
+			*timestamp += 125000;
+			break;
+		default:
+			ret = ops->packetize(index, bench_packets[0],
+					     &packet_size, bench_buffer, len,
+					     &processed, timestamp);
+			if (ret == MSE_PACKETIZE_STATUS_CONTINUE ||
+			    ret == MSE_PACKETIZE_STATUS_COMPLETE)
+				count++;
+			*timestamp += 125000;
+			break;
+		}
+	} while (ret == MSE_PACKETIZE_STATUS_CONTINUE);
+
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+/* CRF is not a media packetizer, it has no MSE_PACKETIZER id */
+static struct mse_packetizer_ops *bench_get_ops(const struct bench_case *c)
+{
+	if (c->input == BENCH_INPUT_CRF)
+		return &mse_packetizer_crf_timestamp_audio_ops;
+
+	return mse_packetizer_get_ops(c->id);
+}
+
+static int bench_run(const struct bench_case *c,
+		     enum bench_mode mode,
+		     u64 duration)
+{
+	struct mse_packetizer_ops *ops = bench_get_ops(c);
+	u64 packets = 0, bytes = 0, start, elapsed;
+	unsigned int timestamp = 0;
+	size_t len;
+	int index, ret;
+
+	if (!ops)
+		return -EINVAL;
+
+	if ((mode == BENCH_MODE_SG && !ops->packetize_sg) ||
+	    (mode == BENCH_MODE_BURST && !ops->packetize_burst))
+		return 0;
+
+	index = ops->open();
+	if (index < 0)
+		return index;
+
+	ret = bench_setup(c, ops, index);
+	if (ret < 0)
+		goto out;
+
+	srand(1);
+	len = bench_make_input(c);
+
+	start = bench_now();
+	do {
+		ret = bench_buffer_once(ops, index, mode, len, &timestamp);
+		if (ret < 0)
+			goto out;
+		packets += ret;
+		bytes += len;
+		elapsed = bench_now() - start;
+	} while (elapsed < duration);
+
+	if (!packets) {
+		ret = -EPROTO;
+		goto out;
+	}
+
+	printf("%-26s %-9s %10.1f %12.0f %9.3f\n",
+	       c->name, bench_mode_name[mode],
+	       (double)elapsed / packets,
+	       (double)packets * NSEC_PER_SEC / elapsed,
+	       (double)bytes * 8 / elapsed);
+	ret = 0;
+
+out:
+	if (ret < 0)
+		fprintf(stderr, "%s %s: error %d\n",
+			c->name, bench_mode_name[mode], ret);
+	ops->release(index);
+
+	return ret;
+}
+
+static void bench_usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t msec] [case...]\n"
+		"  -t msec  run time of each case, default 1000\n"
+		"  case     run cases whose name starts with case\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	u64 duration = 1000 * 1000000ULL;
+	int opt, i, j, mode, err = 0;
+	bool match;
+
+	while ((opt = getopt(argc, argv, "t:h")) != -1) {
+		switch (opt) {
+		case 't':
+			duration = strtoull(optarg, NULL, 0) * 1000000ULL;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return 2;
+		}
+	}
+
+	printf("%-26s %-9s %10s %12s %9s\n",
+	       "case", "mode", "ns/packet", "packets/s", "Gbit/s");
+
+	for (i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+		match = optind >= argc;
+		for (j = optind; j < argc; j++)
+			if (!strncmp(bench_cases[i].name, argv[j],
+				     strlen(argv[j])))
+				match = true;
+		if (!match)
+			continue;
+
+		for (mode = 0; mode < ARRAY_SIZE(bench_mode_name); mode++)
+			if (bench_run(&bench_cases[i], mode, duration) < 0)
+				err = 1;
+	}
+
+	return err;
+}